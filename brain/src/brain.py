@@ -335,6 +335,18 @@ def wait_for_flag(flag):
         check_for_interrupt()
         rospy.sleep(WAITING_TIME)
 
+def wait_until_warm():
+    # every node announces on /checkpoint/ready once its state is restored
+    parts = set(rospy.get_param('/checkpoint/parts', []))
+    ready = set()
+    def ready_callback(msg):
+        ready.update(msg.data.split())
+    sub = rospy.Subscriber("/checkpoint/ready", String, ready_callback)
+    rospy.loginfo("Waiting for %s", " ".join(sorted(parts)))
+    while not rospy.is_shutdown() and not parts.issubset(ready):
+        rospy.sleep(WAITING_TIME)
+    sub.unregister()
+
 def follow_wall(should_follow):
     global following_wall
     if should_follow != following_wall:
@@ -497,6 +509,7 @@ def main(argv):
             'follow_graph' : 'FOLLOW_GRAPH'})
         smach.StateMachine.add("RECOVER_FROM_CRASH", RecoverFromCrash(), transitions={'explore':'EXPLORE'})
 
+    wait_until_warm()
     rospy.wait_for_service('/navigation/graph/place_node')
     rospy.wait_for_service('/navigation/graph/next_node_of_interest')
     place_node_service = rospy.ServiceProxy('/navigation/graph/place_node', navigation_msgs.srv.PlaceNode)
@@ -0,0 +1,109 @@
+#ifndef IMU_BIQUAD_H
+#define IMU_BIQUAD_H
+
+#include <cmath>
+#include <string>
+
+namespace imu {
+
+/**
+  * Second order IIR section with the coefficients of the RBJ audio EQ
+  * cookbook, evaluated in transposed direct form II. The cutoff is given in
+  * Hz relative to the sample rate of the signal.
+  */
+class Biquad {
+public:
+
+    enum Type { LOWPASS, HIGHPASS, BANDPASS };
+
+    Biquad()
+    {
+        configure(HIGHPASS, 1.0, 100.0, M_SQRT1_2);
+    }
+
+    /**
+      * Parses "lowpass", "highpass" or "bandpass". Returns false and leaves
+      * type unchanged for any other name.
+      */
+    static bool parse_type(const std::string& name, Type& type)
+    {
+        if (name == "lowpass")
+            type = LOWPASS;
+        else if (name == "highpass")
+            type = HIGHPASS;
+        else if (name == "bandpass")
+            type = BANDPASS;
+        else
+            return false;
+        return true;
+    }
+
+    void configure(Type type, double cutoff, double sample_rate, double q)
+    {
+        double w0 = 2.0*M_PI*cutoff/sample_rate;
+        double cw = std::cos(w0);
+        double alpha = std::sin(w0)/(2.0*q);
+
+        double b0, b1, b2;
+        switch(type) {
+        case LOWPASS:
+            b0 = (1.0 - cw)/2.0;
+            b1 = 1.0 - cw;
+            b2 = (1.0 - cw)/2.0;
+            break;
+        case HIGHPASS:
+            b0 = (1.0 + cw)/2.0;
+            b1 = -(1.0 + cw);
+            b2 = (1.0 + cw)/2.0;
+            break;
+        default:
+            b0 = alpha;
+            b1 = 0.0;
+            b2 = -alpha;
+            break;
+        }
+
+        double a0 = 1.0 + alpha;
+        _b0 = b0/a0;
+        _b1 = b1/a0;
+        _b2 = b2/a0;
+        _a1 = -2.0*cw/a0;
+        _a2 = (1.0 - alpha)/a0;
+
+        reset();
+    }
+
+    void reset()
+    {
+        _z1 = 0;
+        _z2 = 0;
+    }
+
+    /**
+      * Sets the state as if x had been the input forever, which avoids the
+      * step response on the first sample.
+      */
+    void reset(double x)
+    {
+        double y = x*(_b0 + _b1 + _b2)/(1.0 + _a1 + _a2);
+        _z1 = y - _b0*x;
+        _z2 = _b2*x - _a2*y;
+    }
+
+    inline double process(double x)
+    {
+        double y = _b0*x + _z1;
+        _z1 = _b1*x - _a1*y + _z2;
+        _z2 = _b2*x - _a2*y;
+        return y;
+    }
+
+protected:
+
+    double _b0, _b1, _b2, _a1, _a2;
+    double _z1, _z2;
+};
+
+}
+
+#endif // IMU_BIQUAD_H
@@ -0,0 +1,12 @@
+#ifndef IMU_IMU_H
+#define IMU_IMU_H
+
+#include <ros/ros.h>
+
+/**
+  * Subscribes and advertises all topics of the imu node on the given handle.
+  * Shared by the imu executable and the imu nodelet.
+  */
+void setup_imu(ros::NodeHandle& handle);
+
+#endif // IMU_IMU_H
@@ -0,0 +1,151 @@
+#ifndef IMU_PEAK_DETECTOR_H
+#define IMU_PEAK_DETECTOR_H
+
+#include <ros/ros.h>
+#include <cmath>
+#include <algorithm>
+
+namespace imu {
+
+struct PeakEvent {
+    ros::Time stamp;    //stamp of the strongest sample in the window
+    int axis;           //0 = x, 1 = y
+    double peak;        //filtered acceleration of that sample
+    double energy;      //mean squared acceleration over the window, horizontal axes
+};
+
+/**
+  * Windowed detector on the filtered horizontal acceleration (x and y). The
+  * z axis carries gravity, which passes any filter with a DC gain, so it is
+  * not looked at. The last window_size samples are kept in a fixed ring
+  * buffer together with a running sum of squares, so adding a sample is
+  * constant time. An event is raised when a single axis exceeds the peak
+  * threshold or the window energy exceeds the energy threshold, and then no
+  * further event is raised for the refractory period measured in sensor
+  * time.
+  */
+class PeakDetector {
+public:
+
+    static const int MAX_WINDOW = 64;
+    static const int AXES = 2;
+
+    PeakDetector()
+        :_window_size(16)
+        ,_peak_threshold(2.0)
+        ,_energy_threshold(INFINITY)
+        ,_refractory(0.5)
+    {
+        reset();
+    }
+
+    void configure(int window_size, double peak_threshold, double energy_threshold, double refractory)
+    {
+        window_size = std::max(1, std::min(window_size, (int)MAX_WINDOW));
+        if (window_size != _window_size) {
+            _window_size = window_size;
+            reset();
+        }
+        _peak_threshold = peak_threshold;
+        _energy_threshold = energy_threshold > 0 ? energy_threshold : INFINITY;
+        _refractory = refractory;
+    }
+
+    void reset()
+    {
+        _head = 0;
+        _count = 0;
+        _sum_sq = 0;
+        _last_event = ros::Time();
+    }
+
+    /**
+      * Adds one filtered three axis sample. Returns true and fills event if the sample
+      * triggers an event.
+      */
+    bool add(const ros::Time& stamp, const double* a, PeakEvent& event)
+    {
+        Sample& s = _samples[_head];
+        if (_count == _window_size)
+            _sum_sq -= s.sq;
+        else
+            ++_count;
+
+        s.stamp = stamp;
+        s.sq = 0;
+        for(int k = 0; k < AXES; ++k) {
+            s.a[k] = a[k];
+            s.sq += a[k]*a[k];
+        }
+        _sum_sq += s.sq;
+        _head = (_head+1) % _window_size;
+
+        //resum once per window so that rounding errors do not accumulate
+        if (_head == 0) {
+            _sum_sq = 0;
+            for(int i = 0; i < _count; ++i)
+                _sum_sq += _samples[i].sq;
+        }
+
+        double energy = std::max(0.0, _sum_sq) / _count;
+
+        bool peak = false;
+        for(int k = 0; k < AXES; ++k)
+            peak |= std::fabs(a[k]) > _peak_threshold;
+
+        if (!peak && !(energy > _energy_threshold))
+            return false;
+
+        if (!_last_event.isZero() && (stamp - _last_event).toSec() < _refractory)
+            return false;
+
+        strongest(event);
+        event.energy = energy;
+        _last_event = stamp;
+
+        return true;
+    }
+
+    double energy() const { return _count > 0 ? std::max(0.0, _sum_sq)/_count : 0.0; }
+
+protected:
+
+    struct Sample {
+        ros::Time stamp;
+        double a[AXES];
+        double sq;
+    };
+
+    void strongest(PeakEvent& event) const
+    {
+        event.peak = 0;
+        event.axis = 0;
+        double best = -1;
+        for(int i = 0; i < _count; ++i) {
+            const Sample& s = _samples[i];
+            for(int k = 0; k < AXES; ++k) {
+                if (std::fabs(s.a[k]) > best) {
+                    best = std::fabs(s.a[k]);
+                    event.stamp = s.stamp;
+                    event.axis = k;
+                    event.peak = s.a[k];
+                }
+            }
+        }
+    }
+
+    Sample _samples[MAX_WINDOW];
+    int _window_size;
+    int _head;
+    int _count;
+    double _sum_sq;
+
+    double _peak_threshold;
+    double _energy_threshold;
+    double _refractory;
+    ros::Time _last_event;
+};
+
+}
+
+#endif // IMU_PEAK_DETECTOR_H
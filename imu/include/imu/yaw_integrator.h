@@ -0,0 +1,131 @@
+#ifndef IMU_YAW_INTEGRATOR_H
+#define IMU_YAW_INTEGRATOR_H
+
+#include <ros/ros.h>
+#include <cmath>
+#include <algorithm>
+
+namespace imu {
+
+/**
+  * Integrates the z gyro rate into an unwrapped yaw angle with the
+  * trapezoidal rule, using the sensor stamps of consecutive samples.
+  *
+  * The robot is expected to stand still for the first still_time seconds,
+  * and the bias is seeded with the average raw rate over them, so that a
+  * large bias does not keep the corrected rate above still_rate forever.
+  * Nothing is integrated before. Afterwards the bias is tracked while the
+  * corrected rate has stayed below still_rate for still_time, as a plain
+  * average at first and as a first order filter with time constant
+  * bias_tau once that much still data has been seen. Driving straight counts as still, which is fine since the
+  * true yaw rate is zero then as well. Gaps longer than max_gap are not
+  * integrated. Every call is constant time and touches no heap memory.
+  */
+class YawIntegrator {
+public:
+
+    YawIntegrator()
+        :_bias_tau(10.0)
+        ,_still_rate(0.02)
+        ,_still_time(0.5)
+        ,_max_gap(0.1)
+        ,_bias(0)
+        ,_still_total(0)
+        ,_seeded(false)
+        ,_seed_sum(0)
+    {
+        reset();
+    }
+
+    void configure(double bias_tau, double still_rate, double still_time, double max_gap)
+    {
+        _bias_tau = bias_tau;
+        _still_rate = still_rate;
+        _still_time = still_time;
+        _max_gap = max_gap;
+    }
+
+    /**
+      * Restarts the yaw at zero. The bias estimate is kept, and so is the
+      * seed if it is complete.
+      */
+    void reset()
+    {
+        _yaw = 0;
+        _rate = 0;
+        _still_since = ros::Time();
+        _last = ros::Time();
+    }
+
+    void add(const ros::Time& stamp, double raw_rate)
+    {
+        double rate = raw_rate - _bias;
+
+        if (_last.isZero()) {
+            _last = stamp;
+            _rate = rate;
+            return;
+        }
+
+        double dt = (stamp - _last).toSec();
+        if (dt <= 0)
+            return;
+
+        if (!_seeded) {
+            if (dt <= _max_gap) {
+                _seed_sum += raw_rate*dt;
+                _still_total += dt;
+            }
+            if (_still_total > 0 && _still_total >= _still_time) {
+                _bias = _seed_sum/_still_total;
+                _seeded = true;
+            }
+            _last = stamp;
+            _rate = raw_rate - _bias;
+            return;
+        }
+
+        if (dt <= _max_gap)
+            _yaw += 0.5*(_rate + rate)*dt;
+
+        if (std::fabs(rate) < _still_rate) {
+            if (_still_since.isZero())
+                _still_since = stamp;
+            else if ((stamp - _still_since).toSec() >= _still_time) {
+                //plain average until bias_tau seconds of still data are in
+                _still_total = std::min(_still_total + dt, _bias_tau);
+                _bias += (dt/_still_total) * rate;
+            }
+        }
+        else
+            _still_since = ros::Time();
+
+        _last = stamp;
+        _rate = rate;
+    }
+
+    double yaw() const { return _yaw; }
+    double rate() const { return _rate; }
+    double bias() const { return _bias; }
+    const ros::Time& stamp() const { return _last; }
+
+protected:
+
+    double _bias_tau;
+    double _still_rate;
+    double _still_time;
+    double _max_gap;
+
+    double _bias;
+    double _still_total;
+    bool _seeded;
+    double _seed_sum;
+    double _yaw;
+    double _rate;
+    ros::Time _still_since;
+    ros::Time _last;
+};
+
+}
+
+#endif // IMU_YAW_INTEGRATOR_H
@@ -1,46 +1,110 @@
-//#include <imu.h>
+#include <imu/imu.h>
+#include <imu/biquad.h>
+#include <imu/peak_detector.h>
+#include <imu/yaw_integrator.h>
 #include <ros/ros.h>
 #include <sensor_msgs/Imu.h>
 #include <geometry_msgs/Vector3.h>
-#include <common/parameter.h>
+#include <geometry_msgs/Vector3Stamped.h>
+#include <node_utils/cached_parameter.h>
+#include <node_utils/diagnostics.h>
+#include <node_utils/message_pool.h>
+#include <node_utils/realtime.h>
 #include <std_msgs/Time.h>
 #include <std_msgs/Bool.h>
 #include <std_msgs/Float64.h>
-
-const int SIZE = 5;
+#include <string>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
 
 void callback_activate(const std_msgs::BoolConstPtr& val);
-void callback_imu(const sensor_msgs::Imu::ConstPtr& imu_reading);
-float hipass(float input, float cutoff);
+void callback_imu(const ros::MessageEvent<sensor_msgs::Imu const>& event);
+void configure_filters();
 
-//sensor_msgs::Imu _imu;
 bool _active;
-float _accel;
-float _temp_acc;
+bool _primed;
+imu::Biquad _filters[3];
+imu::PeakDetector _detector;
+imu::YawIntegrator _yaw;
 
 //Parameter
-Parameter<double> _accel_th("/perception/imu/accel_th",2.0);
-Parameter<double> _cutoff("/perception/imu/cutoff",0.5);
+CachedParameter<double> _accel_th("/perception/imu/accel_th",2.0);
+CachedParameter<double> _energy_th("/perception/imu/energy_th",0.0);
+CachedParameter<std::string> _filter_type("/perception/imu/filter/type",std::string("highpass"));
+CachedParameter<double> _cutoff("/perception/imu/filter/cutoff",2.0);
+CachedParameter<double> _q("/perception/imu/filter/q",0.707);
+CachedParameter<double> _sample_rate("/perception/imu/sample_rate",125.0);
+CachedParameter<int> _window("/perception/imu/window",16);
+CachedParameter<double> _refractory("/perception/imu/refractory",0.5);
+CachedParameter<double> _bias_tau("/perception/imu/gyro/bias_tau",10.0);
+CachedParameter<double> _still_rate("/perception/imu/gyro/still_rate",0.02);
+CachedParameter<double> _still_time("/perception/imu/gyro/still_time",0.5);
+CachedParameter<double> _max_gap("/perception/imu/gyro/max_gap",0.1);
+
+//configuration the filters were last built with
+std::string _cfg_type;
+double _cfg_cutoff, _cfg_q, _cfg_sample_rate;
 
 ros::Publisher _pub_imu;
-std_msgs::Time _peak;
+//the yaw goes out at the full imu rate, so its messages are recycled
+node_utils::PooledPublisher<geometry_msgs::Vector3Stamped> _pub_yaw(8, 64);
+ros::Subscriber _sub_active;
+ros::Subscriber _sub_imu;
 
-int main(int argc, char **argv)
+node_utils::CallbackStats _imu_stats("imu/data_raw");
+
+void setup_imu(ros::NodeHandle& handle)
 {
-	ros::init(argc, argv, "imu");
+	node_utils::start_parameter_updates();
+	node_utils::start_diagnostics();
+
 	_active = true;
-	//_peak.data = ros::Time::now();
-	_accel = 0;
-	_temp_acc = 0;
-	ros::NodeHandle handle = ros::NodeHandle("");
+	_primed = false;
+
+	//the old one pole coefficient cannot be read as a cutoff frequency
+	if (ros::param::has("/perception/imu/cutoff"))
+		ROS_WARN("[imu] /perception/imu/cutoff is no longer used, set /perception/imu/filter/cutoff in Hz instead");
+
+	configure_filters();
 	_pub_imu = handle.advertise<std_msgs::Time>("/perception/imu/peak",10);
-	ros::Subscriber sub_active = handle.subscribe("/perception/imu/active",10,
+	_pub_yaw.advertise(handle, "/perception/imu/yaw", 50);
+	_sub_active = handle.subscribe("/perception/imu/active",10,
 						&callback_activate);
-	ros::Subscriber sub_imu = handle.subscribe("/imu/data_raw",10,
+	_sub_imu = handle.subscribe("/imu/data_raw",10,
 						&callback_imu);
+}
+
+/**
+  * (Re)builds the axis filters if their parameters changed. Rebuilding
+  * resets the filter state, so this is a no-op otherwise.
+  */
+void configure_filters()
+{
+	std::string type_name = _filter_type();
+	double cutoff = _cutoff();
+	double q = _q();
+	double sample_rate = _sample_rate();
+
+	if (type_name == _cfg_type && cutoff == _cfg_cutoff && q == _cfg_q && sample_rate == _cfg_sample_rate)
+		return;
+
+	_cfg_type = type_name;
+	_cfg_cutoff = cutoff;
+	_cfg_q = q;
+	_cfg_sample_rate = sample_rate;
+
+	imu::Biquad::Type type = imu::Biquad::HIGHPASS;
+	if (!imu::Biquad::parse_type(type_name, type))
+		ROS_ERROR("[imu] Unknown filter type %s, using highpass", type_name.c_str());
 
-	ros::spin();
-	return 0;
+	if (sample_rate <= 0 || cutoff <= 0 || cutoff >= sample_rate/2.0 || q <= 0) {
+		ROS_ERROR("[imu] Invalid filter cutoff %.2lf Hz, q %.2lf at %.1lf Hz, filters not changed", cutoff, q, sample_rate);
+		return;
+	}
+
+	for(int k = 0; k < 3; ++k)
+		_filters[k].configure(type, cutoff, sample_rate, q);
+	_primed = false;
 }
 
 void callback_activate(const std_msgs::BoolConstPtr& val) 
@@ -48,20 +112,88 @@ void callback_activate(const std_msgs::BoolConstPtr& val)
     _active = val->data;
 }
 
-void callback_imu(const sensor_msgs::Imu::ConstPtr& imu_reading) 
+void callback_imu(const ros::MessageEvent<sensor_msgs::Imu const>& event)
 {
-	_accel = imu_reading->linear_acceleration.y;
-	float h_filter_out = hipass(_accel,_cutoff());
-	if((h_filter_out >_accel_th()) && _active)
+	const sensor_msgs::Imu::ConstPtr& imu_reading = event.getMessage();
+	node_utils::CallbackTimer timer(_imu_stats, event.getReceiptTime());
+
+	configure_filters();
+	_detector.configure(_window(), _accel_th(), _energy_th(), _refractory());
+
+	//the driver stamps the sample; fall back to arrival time if it does not
+	ros::Time stamp = imu_reading->header.stamp;
+	if (stamp.isZero())
+		stamp = ros::Time::now();
+
+	double raw[3];
+	raw[0] = imu_reading->linear_acceleration.x;
+	raw[1] = imu_reading->linear_acceleration.y;
+	raw[2] = imu_reading->linear_acceleration.z;
+
+	if (!_primed) {
+		for(int k = 0; k < 3; ++k)
+			_filters[k].reset(raw[k]);
+		_primed = true;
+	}
+
+	double a[3];
+	for(int k = 0; k < 3; ++k)
+		a[k] = _filters[k].process(raw[k]);
+
+	//heading increments at the full imu rate
+	_yaw.configure(_bias_tau(), _still_rate(), _still_time(), _max_gap());
+	_yaw.add(stamp, imu_reading->angular_velocity.z);
+
+	if (_pub_yaw.getNumSubscribers() > 0) {
+		geometry_msgs::Vector3StampedPtr yaw = _pub_yaw.next();
+		yaw->header.stamp = stamp;
+		yaw->vector.x = _yaw.yaw();
+		yaw->vector.y = _yaw.rate();
+		yaw->vector.z = _yaw.bias();
+		_pub_yaw.publish(yaw);
+	}
+
+	imu::PeakEvent event;
+	if (_detector.add(stamp, a, event) && _active)
 	{
-		_peak.data = ros::Time::now();
-		_pub_imu.publish(_peak);
+		std_msgs::TimePtr peak(new std_msgs::Time);
+		peak->data = event.stamp;
+		_pub_imu.publish(peak);
 
-	}	
+		ROS_DEBUG("[imu] Peak on axis %d: %.2lf m/s^2, window energy %.2lf", event.axis, event.peak, event.energy);
+	}
 }
 
-float hipass(float input, float cutoff) {
-	float hi_pass_output=input-(_temp_acc + cutoff*(input-_temp_acc));
-	_temp_acc=hi_pass_output;
-	return(hi_pass_output);
+//------------------------------------------------------------------------------
+// Nodelet
+
+namespace imu {
+
+class ImuNodelet : public nodelet::Nodelet
+{
+public:
+	virtual void onInit()
+	{
+		node_utils::RealtimeProfile profile;
+		profile.load(getPrivateNodeHandle());
+
+		//with a real-time profile the callbacks leave the manager's thread pool
+		ros::NodeHandle handle = getNodeHandle();
+		if (profile.enabled) {
+			_spinner.reset(new node_utils::RealtimeSpinner(profile, getName()));
+			handle.setCallbackQueue(_spinner->queue());
+		}
+
+		setup_imu(handle);
+
+		if (_spinner)
+			_spinner->start();
+	}
+
+private:
+	boost::shared_ptr<node_utils::RealtimeSpinner> _spinner;
+};
+
 }
+
+PLUGINLIB_EXPORT_CLASS(imu::ImuNodelet, nodelet::Nodelet)
@@ -0,0 +1,13 @@
+#include <imu/imu.h>
+#include <node_utils/realtime.h>
+
+int main(int argc, char **argv)
+{
+	ros::init(argc, argv, "imu");
+	ros::NodeHandle handle = ros::NodeHandle("");
+	setup_imu(handle);
+	node_utils::setup_realtime_main("imu");
+
+	ros::spin();
+	return 0;
+}
@@ -0,0 +1,105 @@
+#ifndef IR_CONVERTER_AGE_STATISTICS_H
+#define IR_CONVERTER_AGE_STATISTICS_H
+
+#include <ros/ros.h>
+#include <string>
+#include <algorithm>
+
+namespace ir_converter {
+
+/**
+  * Collects the age of sensor readings at one hop of the pipeline, i.e. the
+  * time between the sensor timestamp and the moment the reading is used.
+  * Ages are counted in a fixed histogram of 1 ms bins, so adding a sample is
+  * constant time and memory. Every report_period seconds count, mean, p50,
+  * p99 and max are logged and the statistics restart.
+  */
+class AgeStatistics {
+public:
+
+    static const int NUM_BINS = 500;
+
+    AgeStatistics(const std::string& name, double report_period = 5.0)
+        :_name(name)
+        ,_report_period(report_period)
+    {
+        reset();
+    }
+
+    inline void add(const ros::Time& stamp, const ros::Time& now)
+    {
+        add((now - stamp).toSec());
+    }
+
+    void add(double age)
+    {
+        int bin = (int)(age*1000.0);
+        bin = std::max(0, std::min(bin, NUM_BINS-1));
+
+        ++_histogram[bin];
+        ++_count;
+        _sum += age;
+        _max = std::max(_max, age);
+
+        ros::Time now = ros::Time::now();
+        if (_last_report.isZero())
+            _last_report = now;
+        else if ((now - _last_report).toSec() >= _report_period) {
+            report();
+            reset();
+            _last_report = now;
+        }
+    }
+
+    /**
+      * Age in seconds below which the given fraction of samples lies.
+      */
+    double percentile(double fraction) const
+    {
+        long target = (long)(fraction*_count);
+        long accum = 0;
+        for(int i = 0; i < NUM_BINS; ++i) {
+            accum += _histogram[i];
+            if (accum > target)
+                return (i+1)/1000.0;
+        }
+        return NUM_BINS/1000.0;
+    }
+
+    long count() const { return _count; }
+    double mean() const { return _count > 0 ? _sum/_count : 0.0; }
+    double max() const { return _max; }
+
+    void report() const
+    {
+        if (_count == 0)
+            return;
+
+        ROS_INFO("[AgeStatistics] %s: n=%ld mean=%.1fms p50=%.0fms p99=%.0fms max=%.1fms",
+                 _name.c_str(), _count, mean()*1000.0,
+                 percentile(0.5)*1000.0, percentile(0.99)*1000.0, _max*1000.0);
+    }
+
+    void reset()
+    {
+        std::fill(_histogram, _histogram+NUM_BINS, 0);
+        _count = 0;
+        _sum = 0;
+        _max = 0;
+    }
+
+protected:
+
+    std::string _name;
+    double _report_period;
+    ros::Time _last_report;
+
+    long _histogram[NUM_BINS];
+    long _count;
+    double _sum;
+    double _max;
+};
+
+}
+
+#endif // IR_CONVERTER_AGE_STATISTICS_H
@@ -0,0 +1,59 @@
+#ifndef IR_CONVERTER_H
+#define IR_CONVERTER_H
+
+#include <ros/ros.h>
+#include <common/robot.h>
+#include <node_utils/cached_parameter.h>
+#include <node_utils/trace.h>
+#include <node_utils/diagnostics.h>
+#include <node_utils/message_pool.h>
+#include <ras_arduino_msgs/ADConverter.h>
+#include <ir_converter/Distance.h>
+#include <std_srvs/Empty.h>
+#include <ir_converter/age_statistics.h>
+#include <ir_converter/ir_lookup_table.h>
+#include <ir_converter/ir_filter_bank.h>
+
+class IRConverter
+{
+public:
+    enum Channel {
+        FL_SIDE = 0,
+        FR_SIDE,
+        BL_SIDE,
+        BR_SIDE,
+        L_FRONT,
+        R_FRONT,
+        NUM_CHANNELS
+    };
+
+    IRConverter(const ros::NodeHandle& n = ros::NodeHandle(""));
+    void IRCallback(const ros::MessageEvent<ras_arduino_msgs::ADConverter const>& event);
+    void publishDistance(const ros::Time& stamp);
+    void buildTables();
+    bool serviceRebuildTables(std_srvs::EmptyRequest& request,
+                              std_srvs::EmptyResponse& response);
+private:
+    ros::NodeHandle handle;
+    ros::Subscriber ir_subscriber;
+    node_utils::PooledPublisher<ir_converter::Distance> distance_publisher;
+    ros::ServiceServer srv_rebuild;
+
+    int _adc[NUM_CHANNELS];
+
+    IRLookupTable _table;
+
+    IRFilterBank _filter;
+
+    ir_converter::AgeStatistics _age_stats;
+    node_utils::CallbackStats _adc_stats;
+
+    CachedParameter<double> _lowpass_inertia;
+    CachedParameter<double> _lowpass_inertia_front;
+    CachedParameter<double> _outlier_k;
+    CachedParameter<double> _outlier_min_deviation;
+    CachedParameter<int> _queue_size;
+
+};
+
+#endif // IR_CONVERTER_H
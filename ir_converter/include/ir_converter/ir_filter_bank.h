@@ -0,0 +1,168 @@
+#ifndef IR_FILTER_BANK_H
+#define IR_FILTER_BANK_H
+
+#include <cmath>
+#include <algorithm>
+
+/**
+  * Filters all IR channels at once. Every channel occupies one lane of
+  * fixed size float arrays, and every stage is a branch free loop over the
+  * lanes that the compiler maps onto SIMD registers.
+  *
+  * Stages per sample:
+  *  1. Hampel identifier over a sliding window of WINDOW samples. The median
+  *     and the median absolute deviation (MAD) are computed with a min/max
+  *     network, so the cost does not depend on the data. A sample further
+  *     than k*1.4826*MAD (but at least min_deviation) from the median is
+  *     flagged invalid.
+  *  2. Range check against the valid distance interval of the sensor.
+  *  3. First order low pass, out = inertia*out + (1-inertia)*in. Invalid
+  *     samples are not fed in, the output holds the last valid state. The
+  *     first valid sample of a channel initializes its state.
+  *
+  * filter() returns a bit mask with bit i set if channel i was valid.
+  */
+class IRFilterBank
+{
+public:
+    static const int LANES = 8;
+    static const int WINDOW = 5;
+
+    IRFilterBank()
+        :_head(0)
+        ,_initialized(false)
+        ,_k(3.0f)
+        ,_min_deviation(0.02f)
+    {
+        for(int i = 0; i < LANES; ++i) {
+            _inertia[i] = 0.0f;
+            _state[i] = 0.0f;
+            _has_state[i] = 0.0f;
+            _min[i] = -INFINITY;
+            _max[i] = INFINITY;
+        }
+    }
+
+    void set_inertia(int channel, float inertia) { _inertia[channel] = inertia; }
+
+    void set_range(int channel, float min, float max)
+    {
+        _min[channel] = min;
+        _max[channel] = max;
+    }
+
+    void set_outlier_threshold(float k, float min_deviation)
+    {
+        _k = k;
+        _min_deviation = min_deviation;
+    }
+
+    unsigned int filter(const double* in, int num_channels, double* out)
+    {
+        float x[LANES];
+        for(int i = 0; i < LANES; ++i)
+            x[i] = (i < num_channels) ? (float)in[i] : 0.0f;
+
+        if (!_initialized) {
+            for(int w = 0; w < WINDOW; ++w)
+                std::copy(x, x+LANES, _window[w]);
+            _initialized = true;
+        }
+
+        std::copy(x, x+LANES, _window[_head]);
+        _head = (_head+1) % WINDOW;
+
+        //Hampel identifier
+        float med[LANES];
+        median5(_window[0], _window[1], _window[2], _window[3], _window[4], med);
+
+        float dev[WINDOW][LANES];
+        for(int w = 0; w < WINDOW; ++w)
+            for(int i = 0; i < LANES; ++i)
+                dev[w][i] = std::fabs(_window[w][i] - med[i]);
+
+        float mad[LANES];
+        median5(dev[0], dev[1], dev[2], dev[3], dev[4], mad);
+
+        unsigned int valid_mask = 0;
+        float valid[LANES];
+        for(int i = 0; i < LANES; ++i)
+        {
+            float thresh = _k*1.4826f*mad[i];
+            thresh = thresh > _min_deviation ? thresh : _min_deviation;
+
+            int outlier = std::fabs(x[i] - med[i]) > thresh;
+            int in_range = (x[i] >= _min[i]) & (x[i] <= _max[i]);
+            int ok = (!outlier) & in_range;
+
+            valid[i] = ok ? 1.0f : 0.0f;
+            valid_mask |= (unsigned int)ok << i;
+        }
+
+        //low pass over the valid samples; the state of a channel without one
+        //yet is weighted with zero, and invalid samples keep the state as is
+        for(int i = 0; i < LANES; ++i) {
+            float inertia = _has_state[i]*_inertia[i];
+            float x_ok = valid[i] ? x[i] : 0.0f;
+            float updated = inertia*_state[i] + (1.0f-inertia)*x_ok;
+            _state[i] = valid[i] ? updated : _state[i];
+            _has_state[i] = _has_state[i] > valid[i] ? _has_state[i] : valid[i];
+        }
+
+        for(int i = 0; i < num_channels; ++i)
+            out[i] = _state[i];
+
+        return valid_mask & ((1u << num_channels) - 1u);
+    }
+
+private:
+
+    static inline void lane_min(const float* a, const float* b, float* r)
+    {
+        for(int i = 0; i < LANES; ++i)
+            r[i] = a[i] < b[i] ? a[i] : b[i];
+    }
+
+    static inline void lane_max(const float* a, const float* b, float* r)
+    {
+        for(int i = 0; i < LANES; ++i)
+            r[i] = a[i] > b[i] ? a[i] : b[i];
+    }
+
+    /**
+      * median5(a,b,c,d,e) = median3(e, max(min(a,b),min(c,d)), min(max(a,b),max(c,d)))
+      * median3(x,y,z)     = max(min(x,y), min(max(x,y),z))
+      */
+    static inline void median5(const float* a, const float* b, const float* c,
+                               const float* d, const float* e, float* r)
+    {
+        float t0[LANES], t1[LANES], lo[LANES], hi[LANES];
+
+        lane_min(a, b, t0);
+        lane_min(c, d, t1);
+        lane_max(t0, t1, lo);
+
+        lane_max(a, b, t0);
+        lane_max(c, d, t1);
+        lane_min(t0, t1, hi);
+
+        lane_min(e, lo, t0);
+        lane_max(e, lo, t1);
+        lane_min(t1, hi, t1);
+        lane_max(t0, t1, r);
+    }
+
+    float _window[WINDOW][LANES];
+    int _head;
+    bool _initialized;
+
+    float _inertia[LANES];
+    float _state[LANES];
+    float _has_state[LANES];
+    float _min[LANES], _max[LANES];
+
+    float _k;
+    float _min_deviation;
+};
+
+#endif // IR_FILTER_BANK_H
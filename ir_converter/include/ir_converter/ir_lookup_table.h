@@ -0,0 +1,88 @@
+#ifndef IR_LOOKUP_TABLE_H
+#define IR_LOOKUP_TABLE_H
+
+#include <common/robot.h>
+#include <algorithm>
+#include <cmath>
+
+/**
+  * Per channel ADC to distance conversion table. The robot::ir calibration
+  * curve is sampled every 2^STRIDE_BITS codes of the 10 bit ADC range and
+  * linearly interpolated in between, which keeps all six tables within a
+  * few kilobytes. Sensor offsets are folded into the table.
+  */
+class IRLookupTable
+{
+public:
+    static const int NUM_CHANNELS = 6;
+    static const int ADC_MAX = 1023;
+    static const int STRIDE_BITS = 2;
+    static const int STRIDE = 1 << STRIDE_BITS;
+    static const int NUM_KNOTS = (ADC_MAX+1)/STRIDE + 1;
+
+    /**
+      * (Re)generates the table of one channel from the current calibration.
+      */
+    void build(int channel, int sensor_id, double offset)
+    {
+        for(int k = 0; k < NUM_KNOTS-1; ++k)
+            _knots[channel][k] = (float)(robot::ir::distance(sensor_id, k*STRIDE) + offset);
+
+        //the last knot lies past ADC_MAX, where the curve is not calibrated. It
+        //continues the last codes in a straight line, so that the last segment
+        //is as fine as the others and ADC_MAX converts exactly.
+        const int last_adc = (NUM_KNOTS-2)*STRIDE;
+        double before = _knots[channel][NUM_KNOTS-2];
+        double last = robot::ir::distance(sensor_id, ADC_MAX) + offset;
+        _knots[channel][NUM_KNOTS-1] = (float)(before + (last - before)*STRIDE/(ADC_MAX - last_adc));
+
+        //the valid span runs from ADC_MAX down the codes as long as the curve
+        //keeps rising in distance; below that the fit folds over or diverges
+        float min = interpolate(channel, ADC_MAX);
+        float max = min;
+        for(int k = NUM_KNOTS-2; k >= 0; --k) {
+            float d = _knots[channel][k];
+            if (!(d >= max) || std::isinf(d))
+                break;
+            max = d;
+        }
+        _min_distance[channel] = min;
+        _max_distance[channel] = max;
+    }
+
+    /**
+      * Interval of distances the calibration of a channel can report. Readings
+      * outside of it are conversion failures.
+      */
+    float min_distance(int channel) const { return _min_distance[channel]; }
+    float max_distance(int channel) const { return _max_distance[channel]; }
+
+    /**
+      * Converts one reading of all channels. Out of range codes are clamped.
+      */
+    inline void convert(const int* adc, double* distances) const
+    {
+        for(int i = 0; i < NUM_CHANNELS; ++i) {
+            //the cast keeps std::min from binding a reference to ADC_MAX, which has no definition
+            int a = std::min(std::max(adc[i], 0), (int)ADC_MAX);
+            distances[i] = interpolate(i, a);
+        }
+    }
+
+private:
+
+    inline float interpolate(int channel, int a) const
+    {
+        int k = a >> STRIDE_BITS;
+        float t = (float)(a & (STRIDE-1)) * (1.0f/STRIDE);
+
+        float d0 = _knots[channel][k];
+        float d1 = _knots[channel][k+1];
+        return d0 + t*(d1-d0);
+    }
+    float _knots[NUM_CHANNELS][NUM_KNOTS];
+    float _min_distance[NUM_CHANNELS];
+    float _max_distance[NUM_CHANNELS];
+};
+
+#endif // IR_LOOKUP_TABLE_H
@@ -1,67 +1,161 @@
-#include "ir_converter.h"
+#include <ir_converter/ir_converter.h>
 #include <common/util.h>
+#include <node_utils/realtime.h>
+#include <node_utils/allocation.h>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
 
-IRConverter::IRConverter()
-    :_filter_fl(0.0)
-    ,_filter_fr(0.0)
-    ,_filter_bl(0.0)
-    ,_filter_br(0.0)
-    ,_filter_l(0.0)
-    ,_filter_r(0.0)
-    ,_lowpass_inertia("/perception/ir/filter_inertia",0.05)
+IRConverter::IRConverter(const ros::NodeHandle& n)
+    :_lowpass_inertia("/perception/ir/filter_inertia",0.05)
     ,_lowpass_inertia_front("/perception/ir/filter_inertia_front",0.5)
+    ,_outlier_k("/perception/ir/outlier_k",3.0)
+    ,_outlier_min_deviation("/perception/ir/outlier_min_deviation",0.02)
+    ,_queue_size("/perception/ir/queue_size",1)
+    ,_age_stats("adc -> ir_converter")
+    ,_adc_stats("ir_converter/adc")
 {
-    handle = ros::NodeHandle("");
-    ir_subscriber = handle.subscribe("/arduino/adc", 1000, &IRConverter::IRCallback, this);
-    distance_publisher = handle.advertise<ir_converter::Distance>("/perception/ir/distance", 1000);
+    node_utils::start_parameter_updates();
+    node_utils::start_trace_export();
+    node_utils::start_diagnostics();
+
+    buildTables();
+
+    //short queues drop the oldest readings first, so the freshest one is used
+    handle = n;
+    ir_subscriber = handle.subscribe("/arduino/adc", _queue_size(), &IRConverter::IRCallback, this,
+                                     ros::TransportHints().tcpNoDelay());
+    distance_publisher.advertise(handle, "/perception/ir/distance", _queue_size());
+    srv_rebuild = handle.advertiseService("/perception/ir/rebuild_tables", &IRConverter::serviceRebuildTables, this);
 }
 
-void IRConverter::IRCallback(const ras_arduino_msgs::ADConverter::ConstPtr &adc)
+/**
+  * Samples the robot::ir calibration into the conversion tables. Has to be
+  * called again whenever the calibration changes.
+  */
+void IRConverter::buildTables()
 {
-    ir_fl_side = adc->ch1;
-    ir_fr_side = adc->ch2;
-    ir_bl_side = adc->ch3;
-    ir_br_side = adc->ch4;
-    ir_l_front = adc->ch7;
-    ir_r_front = adc->ch8;
-
-    publishDistance();
+    using namespace robot::ir;
+
+    _table.build(FL_SIDE, id_front_left,       offset_front_left);
+    _table.build(FR_SIDE, id_front_right,      offset_front_right);
+    _table.build(BL_SIDE, id_front_left,       offset_rear_left);
+    _table.build(BR_SIDE, id_front_right,      offset_rear_right);
+    _table.build(L_FRONT, id_front_long_left,  0.0);
+    _table.build(R_FRONT, id_front_long_right, 0.0);
+
+    //readings outside of the calibrated span are conversion failures
+    for(int i = 0; i < NUM_CHANNELS; ++i)
+        _filter.set_range(i, _table.min_distance(i), _table.max_distance(i));
 }
 
-void IRConverter::publishDistance()
+bool IRConverter::serviceRebuildTables(std_srvs::EmptyRequest& request,
+                                       std_srvs::EmptyResponse& response)
 {
-    using namespace robot::ir;
+    buildTables();
+    return true;
+}
+
+/**
+  * The adc message carries no timestamp, so the time it was received by the
+  * transport (before waiting in the queue) is used as sensor time. Every
+  * reading starts a trace, identified by this stamp.
+  */
+void IRConverter::IRCallback(const ros::MessageEvent<ras_arduino_msgs::ADConverter const>& event)
+{
+    const ras_arduino_msgs::ADConverter::ConstPtr& adc = event.getMessage();
+    const ros::Time& stamp = event.getReceiptTime();
+    node_utils::CallbackTimer timer(_adc_stats, stamp);
+
+    uint32_t trace_id = node_utils::trace_id(stamp);
+    node_utils::TraceSpan span("ir_converter/convert", trace_id);
+    node_utils::trace_span("ir_converter/queue", trace_id, stamp, span.begin());
+
+    _age_stats.add(stamp, ros::Time::now());
+
+    _adc[FL_SIDE] = adc->ch1;
+    _adc[FR_SIDE] = adc->ch2;
+    _adc[BL_SIDE] = adc->ch3;
+    _adc[BR_SIDE] = adc->ch4;
+    _adc[L_FRONT] = adc->ch7;
+    _adc[R_FRONT] = adc->ch8;
+
+    publishDistance(stamp);
+}
+
+void IRConverter::publishDistance(const ros::Time& stamp)
+{
+    NO_ALLOCATION_REGION("ir_converter/publish_distance");
 
     //set params
-    _filter_fl.set_inertia(_lowpass_inertia());
-    _filter_fr.set_inertia(_lowpass_inertia());
-    _filter_bl.set_inertia(_lowpass_inertia());
-    _filter_br.set_inertia(_lowpass_inertia());
-    _filter_l.set_inertia(_lowpass_inertia_front());
-    _filter_r.set_inertia(_lowpass_inertia_front());
+    float inertia = _lowpass_inertia();
+    float inertia_front = _lowpass_inertia_front();
+
+    _filter.set_inertia(FL_SIDE, inertia);
+    _filter.set_inertia(FR_SIDE, inertia);
+    _filter.set_inertia(BL_SIDE, inertia);
+    _filter.set_inertia(BR_SIDE, inertia);
+    _filter.set_inertia(L_FRONT, inertia_front);
+    _filter.set_inertia(R_FRONT, inertia_front);
+    _filter.set_outlier_threshold(_outlier_k(), _outlier_min_deviation());
 
     //convert to distance in meter
-    double fl_side = distance(id_front_left,        ir_fl_side) + offset_front_left;
-    double fr_side = distance(id_front_right,       ir_fr_side) + offset_front_right;
-    double bl_side = distance(id_front_left,         ir_bl_side) + offset_rear_left;
-    double br_side = distance(id_front_right,        ir_br_side) + offset_rear_right;
-    double l_front = distance(id_front_long_left,   ir_l_front);
-    double r_front = distance(id_front_long_right,  ir_r_front);
-
-    //filter and publish message
-    ir_converter::Distance msg;
-    msg.fl_side = _filter_fl.filter(fl_side);
-    msg.fr_side = _filter_fr.filter(fr_side);
-    msg.bl_side = _filter_bl.filter(bl_side);
-    msg.br_side = _filter_br.filter(br_side);
-    msg.l_front = _filter_l.filter(l_front);
-    msg.r_front = _filter_r.filter(r_front);
+    double distances[NUM_CHANNELS];
+    _table.convert(_adc, distances);
+
+    //filter all channels at once
+    double filtered[NUM_CHANNELS];
+    unsigned int valid = _filter.filter(distances, NUM_CHANNELS, filtered);
+
+    //publish message; as shared pointer it is passed on without copy within a nodelet manager,
+    //and it is recycled once every subscriber is done with it
+    ir_converter::DistancePtr msg = distance_publisher.next();
+    msg->header.stamp = stamp;
+    msg->header.frame_id = "robot";
+    msg->fl_side = filtered[FL_SIDE];
+    msg->fr_side = filtered[FR_SIDE];
+    msg->bl_side = filtered[BL_SIDE];
+    msg->br_side = filtered[BR_SIDE];
+    msg->l_front = filtered[L_FRONT];
+    msg->r_front = filtered[R_FRONT];
+    msg->valid = valid;
+
+    //roscpp allocates its own bookkeeping
+    node_utils::AllowAllocations allow;
     distance_publisher.publish(msg);
 }
 
-int main(int argc, char **argv)
-{   
-    ros::init(argc, argv, "ir_converter");
-    IRConverter ir;
-    ros::spin();
+//------------------------------------------------------------------------------
+// Nodelet
+
+namespace ir_converter {
+
+class IRConverterNodelet : public nodelet::Nodelet
+{
+public:
+    virtual void onInit()
+    {
+        node_utils::RealtimeProfile profile;
+        profile.load(getPrivateNodeHandle());
+
+        //with a real-time profile the callbacks leave the manager's thread pool
+        ros::NodeHandle handle = getNodeHandle();
+        if (profile.enabled) {
+            _spinner.reset(new node_utils::RealtimeSpinner(profile, getName()));
+            handle.setCallbackQueue(_spinner->queue());
+        }
+
+        _converter.reset(new IRConverter(handle));
+
+        if (_spinner)
+            _spinner->start();
+    }
+
+private:
+    boost::shared_ptr<IRConverter> _converter;
+    //declared last so that it is stopped before the converter goes away
+    boost::shared_ptr<node_utils::RealtimeSpinner> _spinner;
+};
+
 }
+
+PLUGINLIB_EXPORT_CLASS(ir_converter::IRConverterNodelet, nodelet::Nodelet)
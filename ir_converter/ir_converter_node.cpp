@@ -0,0 +1,10 @@
+#include <ir_converter/ir_converter.h>
+#include <node_utils/realtime.h>
+
+int main(int argc, char **argv)
+{   
+    ros::init(argc, argv, "ir_converter");
+    IRConverter ir;
+    node_utils::setup_realtime_main("ir_converter");
+    ros::spin();
+}
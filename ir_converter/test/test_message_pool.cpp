@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+#include <node_utils/message_pool.h>
+#include <node_utils/allocation.h>
+#include <ir_converter/Distance.h>
+#include <nav_msgs/Odometry.h>
+#include <visualization_msgs/Marker.h>
+
+/**
+  * The messages of the per reading publishers (the distances of
+  * ir_converter, the pose and marker of pose_generator) are filled like
+  * there. Once the pools are warm the fills must not allocate, counted by
+  * the operator new hooks of node_utils. Publishing is left out, it needs a
+  * master and roscpp allocates its own bookkeeping anyway.
+  *
+  * The test lives here and not in node_utils, as ir_converter depends on
+  * node_utils and Distance would close the cycle.
+  */
+
+namespace {
+
+const int WARM_UP = 16;
+const int PASSES = 1000;
+
+void fill(ir_converter::Distance& msg, int i)
+{
+    msg.header.stamp = ros::Time(1000, i);
+    msg.header.frame_id = "robot";
+    msg.fl_side = 0.1;
+    msg.fr_side = 0.2;
+    msg.bl_side = 0.3;
+    msg.br_side = 0.4;
+    msg.l_front = 0.5;
+    msg.r_front = 0.6;
+    msg.valid = ir_converter::Distance::FL_SIDE | ir_converter::Distance::BR_SIDE;
+}
+
+/**
+  * pose_generator packs the pose into one message and copies it into the
+  * pooled one.
+  */
+void fill(nav_msgs::Odometry& msg, int i)
+{
+    static nav_msgs::Odometry odom;
+    odom.header.stamp = ros::Time(1000, i);
+    odom.header.frame_id = "map";
+    odom.pose.pose.position.x = 0.01*i;
+    odom.pose.pose.position.y = 0.02*i;
+    odom.pose.pose.orientation.w = 1.0;
+    odom.twist.twist.linear.x = 0.2;
+    msg = odom;
+}
+
+void fill(visualization_msgs::Marker& msg, int i)
+{
+    msg.header.frame_id = "robot";
+    msg.header.stamp = ros::Time(1000, i);
+    msg.ns = "robot";
+    msg.id = 0;
+    msg.type = visualization_msgs::Marker::CUBE;
+    msg.action = visualization_msgs::Marker::ADD;
+    msg.pose.position.z = 0.1;
+    msg.pose.orientation.w = 1;
+    msg.scale.x = 0.2;
+    msg.scale.y = 0.2;
+    msg.scale.z = 0.2;
+    msg.color.a = 0.5;
+    msg.color.g = 141.0 / 255.0;
+    msg.color.b = 240.0 / 255.0;
+}
+
+template<class M>
+boost::shared_ptr<M> next(node_utils::MessagePool<M>& pool) { return pool.acquire(); }
+
+template<class M>
+boost::shared_ptr<M> next(node_utils::PooledPublisher<M>& publisher) { return publisher.next(); }
+
+/**
+  * Allocations of passes fills, while the previous message is still held
+  * as by the queue of a subscriber.
+  */
+template<class M, class Source>
+node_utils::AllocationCounts fill_passes(Source& source, int passes)
+{
+    boost::shared_ptr<M> held;
+    node_utils::AllocationScope scope;
+    for(int i = 0; i < passes; ++i) {
+        boost::shared_ptr<M> msg = next(source);
+        fill(*msg, i);
+        held = msg;
+    }
+    return scope.counts();
+}
+
+}
+
+TEST(MessagePool, HooksActive)
+{
+    EXPECT_TRUE(node_utils::allocation_hooks_active());
+}
+
+TEST(MessagePool, DistanceDoesNotAllocate)
+{
+    node_utils::PooledPublisher<ir_converter::Distance> publisher;
+    fill_passes<ir_converter::Distance>(publisher, WARM_UP);
+
+    node_utils::AllocationCounts counts = fill_passes<ir_converter::Distance>(publisher, PASSES);
+    EXPECT_EQ(0, counts.count);
+    EXPECT_EQ(0, counts.bytes);
+}
+
+TEST(MessagePool, OdometryDoesNotAllocate)
+{
+    node_utils::MessagePool<nav_msgs::Odometry> pool;
+    fill_passes<nav_msgs::Odometry>(pool, WARM_UP);
+
+    node_utils::AllocationCounts counts = fill_passes<nav_msgs::Odometry>(pool, PASSES);
+    EXPECT_EQ(0, counts.count);
+    EXPECT_EQ(0, counts.bytes);
+}
+
+TEST(MessagePool, MarkerDoesNotAllocate)
+{
+    node_utils::MessagePool<visualization_msgs::Marker> pool;
+    fill_passes<visualization_msgs::Marker>(pool, WARM_UP);
+
+    node_utils::AllocationCounts counts = fill_passes<visualization_msgs::Marker>(pool, PASSES);
+    EXPECT_EQ(0, counts.count);
+    EXPECT_EQ(0, counts.bytes);
+}
+
+/**
+  * The counting works: a pool that has to grow allocates.
+  */
+TEST(MessagePool, GrowingPoolAllocates)
+{
+    node_utils::MessagePool<nav_msgs::Odometry> pool(1, 8);
+    std::vector<nav_msgs::OdometryPtr> held;
+    held.reserve(4);
+
+    node_utils::AllocationScope scope;
+    for(int i = 0; i < 4; ++i)
+        held.push_back(pool.acquire());
+    EXPECT_GT(scope.counts().count, 0);
+    EXPECT_EQ(4u, pool.size());
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
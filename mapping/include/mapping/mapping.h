@@ -4,16 +4,28 @@
 #include <ros/ros.h>
 #include <nav_msgs/Odometry.h>
 #include <ir_converter/Distance.h>
+#include <ir_converter/age_statistics.h>
 #include <nav_msgs/Odometry.h>
 #include <nav_msgs/OccupancyGrid.h>
 #include <nav_msgs/MapMetaData.h>
 #include <std_msgs/Header.h>
 #include <common/robot.h>
-#include <common/parameter.h>
+#include <node_utils/cached_parameter.h>
+#include <node_utils/trace.h>
+#include <node_utils/diagnostics.h>
+#include <node_utils/periodic_executor.h>
+#include <node_utils/log_limit.h>
+#include <node_utils/checkpoint.h>
+#include <navigation_msgs/MapCheckpoint.h>
+#include <robot_core/grid.h>
+#include <robot_core/cloud.h>
+#include <robot_core/height_grid.h>
+#include <robot_core/region.h>
 #include <math.h>
 #include <tf/transform_listener.h>
 #include <tf/transform_broadcaster.h>
 #include <pcl_ros/point_cloud.h>
+#include <sensor_msgs/PointCloud2.h>
 #include <pcl/point_types.h>
 #include <pcl/pcl_base.h>
 #include <std_msgs/Float64.h>
@@ -24,6 +36,7 @@
 #include <navigation_msgs/UnexploredRegion.h>
 #include <common/marker_delegate.h>
 #include <navigation_msgs/TransformPoint.h>
+#include <boost/thread/mutex.hpp>
 #include <fstream>
 
 using std::vector;
@@ -41,10 +54,11 @@ struct Point
 class Mapping
 {
 public:
-    Mapping();
-    void distanceCallback(const ir_converter::Distance::ConstPtr&);
+    Mapping(const ros::NodeHandle& n = ros::NodeHandle(""), bool tf_thread = true);
+    void distanceCallback(const ros::MessageEvent<ir_converter::Distance const>&);
     void odometryCallback(const nav_msgs::Odometry::ConstPtr&);
     void wallDetectedCallback(const vision_msgs::Planes::ConstPtr&);
+    void cloudCallback(const sensor_msgs::PointCloud2::ConstPtr&);
     void activateUpdateCallback(const std_msgs::Bool::ConstPtr&);
     void saveMapCallback(const std_msgs::Empty::ConstPtr&);
     bool performRaycast(navigation_msgs::RaycastRequest &request,
@@ -53,6 +67,8 @@ public:
                            navigation_msgs::FitBlobResponse& response);
     bool serviceHasUnexploredRegion(navigation_msgs::UnexploredRegionRequest& request,
                                     navigation_msgs::UnexploredRegionResponse& response);
+    void integrate();
+    void integrateCloud();
     void updateGrid();
     void publishMap();
     void updateTransform();
@@ -63,50 +79,66 @@ public:
     void saveToFile(const std::string& file_name);
     void recoverFromFile(const std::string& file_name);
     void recoverAndRefreshOccGrid(const std::string& file_name);
+    bool saveCheckpoint(const std::string& file_name);
+    bool restoreCheckpoint(const std::string& file_name);
+    void warmStart(bool p2);
 
     static const std::string MAP_NAME;
 
 private:
 
-    void markPointsBetween(Point<int> p0, Point<int> p1, double val, bool markInSeen = false);
+    void markPointsBetween(robot_core::Cell p0, robot_core::Cell p1, double val, bool markInSeen = false);
     void updateIR(double ir_reading, double ir_x_offset);
     void updateHaveSeen();
-    void markCellOccupied(Point<int> cell, int neighborhood = 1);
-    void markPoint(Point<double> p, double val);
-    Point<int> robotPointToCell(Point<double> p);
-    Point<double> robotToMapTransform(Point<double> p);
-    Point<int> mapPointToCell(Point<double> p);
+    void markCellOccupied(robot_core::Cell cell, int neighborhood = 1);
+    robot_core::Cell robotPointToCell(Point<double> p);
     Point<double> transformPointToRobotSystem(std::string& frame_id, double x, double y);
     Point<double> transformPointToMapSystem(std::string& frame_id, double x, double y);
-    Point<int> transformPointToGridSystem(const std::string &frame_id, double x, double y);
-    Point<double> transformCellToMap(Point<int>& cell);
-    void markProbabilityGrid(Point<int> cell, double log_prob);
-    void markSeenGrid(Point<int> cell, int flag);
-    void updateOccupancyGrid(Point<int>);
-    void updateSeenVizGrid(Point<int>);
+    robot_core::Cell transformPointToGridSystem(const std::string &frame_id, double x, double y);
+    Point<double> transformCellToMap(robot_core::Cell cell);
     bool isIRValid(double reading);
-    void initProbabilityGrid();
-    void initOccupancyGrid();
-    void updateWalls(bool markOnHaveSeen);
-    bool isObstacle(int x, int y, bool inHaveSeen = false);
-    bool isUnexplored(int x, int y);
+    void queueWalls(const std::vector<common::vision::SegmentedPlane>& planes, const tf::Transform& pose);
+    void integrateWalls();
+    void updateGround(const std::vector<common::vision::SegmentedPlane>& planes, const tf::Transform& pose);
+    robot_core::RegionCount countDisc(robot_core::Cell center, int radius);
+    static bool xyzOffset(const sensor_msgs::PointCloud2& cloud, size_t& offset);
+    bool transformAvailable(const std::string& frame_id, const ros::Time& stamp, const ros::Duration& timeout);
+    bool cloudTransform(const sensor_msgs::PointCloud2& cloud, robot_core::Transform& sensor_to_map);
+
+    //the grids and readings are shared by the periodic tasks and the callbacks
+    boost::mutex mutex;
 
     ros::NodeHandle handle;
     ros::Subscriber distance_sub;
     ros::Subscriber odometry_sub;
     ros::Subscriber wall_sub;
+    ros::Subscriber cloud_sub;
     ros::Subscriber object_sub;
     ros::Subscriber active_sub;
     ros::Subscriber map_save;
 
     ros::Publisher map_pub;
     ros::Publisher seen_pub;
-
-    Parameter<double> frustum_fov;
-    Parameter<double> frustum_dist;
-    Parameter<bool> use_planes;
-
-    tf::TransformListener tf_listener;
+    ros::Publisher height_pub;
+
+    CachedParameter<double> frustum_fov;
+    CachedParameter<double> frustum_dist;
+    CachedParameter<bool> use_planes;
+    CachedParameter<double> ir_max_age;
+    CachedParameter<bool> use_cloud;
+    CachedParameter<double> cloud_voxel_size;
+    CachedParameter<double> cloud_min_z;
+    CachedParameter<double> cloud_max_z;
+    CachedParameter<double> cloud_min_range;
+    CachedParameter<double> cloud_max_range;
+    CachedParameter<int> cloud_threads;
+    CachedParameter<bool> use_heights;
+    CachedParameter<double> height_floor_tolerance;
+    CachedParameter<double> height_max_step;
+    CachedParameter<int> height_min_hits;
+
+    boost::shared_ptr<tf::TransformListener> tf_listener;
+    bool tf_thread;
     tf::StampedTransform transform;
 
     ros::Publisher pub_viz;
@@ -119,30 +151,59 @@ private:
     ros::ServiceServer srv_to_map;
     ros::ServiceServer srv_isunexplored;
 
-    common::vision::SegmentedPlane::ArrayPtr wall_planes;
+    struct WallSegment {
+        robot_core::Cell p0;
+        robot_core::Cell p1;
+    };
 
-    vector<vector<double> > prob_grid;
-    vector<vector<uint8_t> > seen_grid;
-    nav_msgs::OccupancyGrid occupancy_grid;
+    //walls of the plane messages that are not integrated yet
+    std::vector<WallSegment> wall_queue;
+
+    //the latest cloud of the depth camera that is not inserted yet
+    sensor_msgs::PointCloud2::ConstPtr cloud;
+    robot_core::CloudInserter cloud_inserter;
+
+    //the grid algorithms, this class only feeds them and publishes the result
+    robot_core::Grid grid;
+    robot_core::HeightGrid heights;
 
+    //header and meta data of the published grids
+    nav_msgs::OccupancyGrid occupancy_grid;
     nav_msgs::OccupancyGrid seen_viz_grid;
 
     Point<double> pos;
     double fl_ir_reading, fr_ir_reading, bl_ir_reading, br_ir_reading;
+    uint8_t ir_valid;
+    ros::Time ir_stamp;
+    ros::Time ir_received;
+    uint32_t ir_trace_id;
+    ir_converter::AgeStatistics ir_age_received;
+    ir_converter::AgeStatistics ir_age_integrated;
     bool active;
 
+    node_utils::CallbackStats distance_stats;
+    node_utils::CallbackStats odometry_stats;
+    node_utils::CallbackStats planes_stats;
+    node_utils::CallbackStats cloud_stats;
+    node_utils::CallbackStats raycast_stats;
+    node_utils::CallbackStats unexplored_stats;
+
+    //rays that leave the grid hit every cell outside, shared by all grid writes
+    node_utils::LogSite out_of_bounds_log;
+    node_utils::LogSite cloud_log;
+
+    node_utils::CheckpointPart checkpoint;
+
     static const double INVALID_READING;
     static const double MAP_HEIGHT, MAP_WIDTH;
     static const int GRID_HEIGHT, GRID_WIDTH;
     static const double MAP_X_OFFSET, MAP_Y_OFFSET;
-    static const double P_PRIOR, P_OCC, P_FREE;
-    static const double FREE_OCCUPIED_THRESHOLD;
-
     static const double MAX_IR_DIST, MIN_IR_DIST;
 
-    static const int UNKNOWN, FREE, OCCUPIED;
     static const int BLUE_CUBE;
     static const int RED_SPHERE;
   };
 
+void add_mapping_tasks(node_utils::PeriodicExecutor& executor, Mapping& mapping);
+
 #endif // MAPPING_H
@@ -1,4 +1,11 @@
 #include "mapping/mapping.h"
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <node_utils/allocation.h>
+#include <robot_core/raycast.h>
+#include <robot_core/grid_io.h>
 
 const int Mapping::GRID_HEIGHT = 1000;
 const int Mapping::GRID_WIDTH = 1000;
@@ -8,48 +15,76 @@ const double Mapping::MAP_WIDTH = 10.0;
 const double Mapping::MAP_X_OFFSET = MAP_WIDTH/2.0;
 const double Mapping::MAP_Y_OFFSET = MAP_HEIGHT/2.0;
 
-const double Mapping::P_PRIOR = log(0.5/(1.0-0.5));
-const double Mapping::P_OCC = log(0.7/(1.0-0.7)); 
-const double Mapping::P_FREE  = log(0.35/(1.0 - 0.35));
-
-const double Mapping::FREE_OCCUPIED_THRESHOLD = log(0.5);
-
 const std::string Mapping::MAP_NAME = "contestMap.map";
 
 const double Mapping::MAX_IR_DIST = 0.5;
 const double Mapping::MIN_IR_DIST = 0.04;
 
 const double Mapping::INVALID_READING = -1.0;
-const int Mapping::UNKNOWN = 50;
-const int Mapping::FREE = 0;
-const int Mapping::OCCUPIED = 100;
 const int Mapping::BLUE_CUBE = 2;
 const int Mapping::RED_SPHERE = 3;
 
 typedef pcl::PointCloud<pcl::PointXYZI> PointCloud;
 typedef pcl::PointXYZI PCPoint;
 
-Mapping::Mapping() :
+Mapping::Mapping(const ros::NodeHandle& n, bool tf_thread) :
     fl_ir_reading(INVALID_READING), fr_ir_reading(INVALID_READING),
     bl_ir_reading(INVALID_READING), br_ir_reading(INVALID_READING),
+    ir_valid(0),
+    grid(GRID_WIDTH, GRID_HEIGHT, 0.01, -MAP_X_OFFSET, -MAP_Y_OFFSET),
+    heights(GRID_WIDTH, GRID_HEIGHT, 0.01, -MAP_X_OFFSET, -MAP_Y_OFFSET),
     pos(Point<double>(0.0,0.0)),
-    wall_planes(new std::vector<common::vision::SegmentedPlane>()),
     active(true),
     markers_map("map","raycasts"),
     markers_robot("robot","planes"),
     frustum_fov("/mapping/frustum/fov",45.0),
     frustum_dist("/mapping/frustum/dist",0.4),
-    use_planes("/mapping/use_planes",false)
-
-{
-    handle = ros::NodeHandle("");
-    distance_sub = handle.subscribe("/perception/ir/distance", 1, &Mapping::distanceCallback, this);
+    use_planes("/mapping/use_planes",false),
+    ir_max_age("/mapping/ir_max_age",0.2),
+    use_cloud("/mapping/cloud/use",false),
+    cloud_voxel_size("/mapping/cloud/voxel_size",0.02),
+    cloud_min_z("/mapping/cloud/min_z",0.03),
+    cloud_max_z("/mapping/cloud/max_z",0.3),
+    cloud_min_range("/mapping/cloud/min_range",0.3),
+    cloud_max_range("/mapping/cloud/max_range",2.0),
+    cloud_threads("/mapping/cloud/threads",0),
+    use_heights("/mapping/heights/use",false),
+    height_floor_tolerance("/mapping/heights/floor_tolerance",0.015),
+    height_max_step("/mapping/heights/max_step",0.03),
+    height_min_hits("/mapping/heights/min_hits",3),
+    ir_age_received("ir_converter -> mapping"),
+    ir_age_integrated("ir_converter -> mapping grid"),
+    distance_stats("mapping/distance"),
+    odometry_stats("mapping/odometry"),
+    planes_stats("mapping/planes"),
+    cloud_stats("mapping/cloud"),
+    raycast_stats("mapping/raycast"),
+    unexplored_stats("mapping/unexplored_region"),
+    out_of_bounds_log("mapping/out_of_bounds"),
+    cloud_log("mapping/cloud"),
+    checkpoint("map", boost::bind(&Mapping::saveCheckpoint, this, _1),
+               boost::bind(&Mapping::restoreCheckpoint, this, _1))
+
+{
+    node_utils::start_parameter_updates();
+    node_utils::start_trace_export();
+    node_utils::start_diagnostics();
+
+    handle = n;
+    ir_trace_id = 0;
+    this->tf_thread = tf_thread;
+
+    //without its own thread the listener is served by the callbacks of handle
+    tf_listener.reset(new tf::TransformListener(handle, ros::Duration(tf::Transformer::DEFAULT_CACHE_TIME), tf_thread));
+    distance_sub = handle.subscribe("/perception/ir/distance", 1, &Mapping::distanceCallback, this, ros::TransportHints().tcpNoDelay());
     odometry_sub = handle.subscribe("/pose/odometry/", 1, &Mapping::odometryCallback, this);
     wall_sub = handle.subscribe("/vision/obstacles/planes", 1, &Mapping::wallDetectedCallback, this);
+    cloud_sub = handle.subscribe("/camera/depth_registered/points", 1, &Mapping::cloudCallback, this);
     active_sub = handle.subscribe("/mapping/active", 1, &Mapping::activateUpdateCallback, this);
     map_save = handle.subscribe("/save", 5, &Mapping::saveMapCallback, this);
     map_pub = handle.advertise<nav_msgs::OccupancyGrid>("/mapping/occupancy_grid", 1);
     seen_pub = handle.advertise<nav_msgs::OccupancyGrid>("/mapping/seen_grid",1);
+    height_pub = handle.advertise<nav_msgs::OccupancyGrid>("/mapping/height_grid",1);
     pub_viz = handle.advertise<visualization_msgs::MarkerArray>("visualization_marker_array",10);
     
     srv_raycast = handle.advertiseService("/mapping/raycast", &Mapping::performRaycast, this);
@@ -71,8 +106,7 @@ Mapping::Mapping() :
     occupancy_grid.info = metaData;
     seen_viz_grid.info = metaData;
 
-    initProbabilityGrid();
-    initOccupancyGrid();
+    checkpoint.start(handle);
 }
 
 bool Mapping::transformToRobot(navigation_msgs::TransformPointRequest &request, navigation_msgs::TransformPointResponse &response)
@@ -93,168 +127,315 @@ bool Mapping::transformToMap(navigation_msgs::TransformPointRequest &request, na
 
 void Mapping::saveToFile(const std::string& file_name)
 {
-	std::ofstream out;
-	out.open(file_name.c_str());
-	int i,j;
-	for (i=0; i<GRID_HEIGHT; i++)
-	{
-		for (j=0; j<GRID_WIDTH; j++)
-		{
-			out << prob_grid[i][j] << "\n";
-		}
-	}
-	out.close();
+    std::ofstream out(file_name.c_str());
+    if (!robot_core::write_log_odds(grid, out))
+        ROS_ERROR("[Mapping::saveToFile] Could not write %s", file_name.c_str());
 }
 
+/**
+  * The text file only holds the occupancy grid, the seen grid is kept.
+  */
 void Mapping::recoverFromFile(const std::string& file_name)
 {
-	std::ifstream in;
-	in.open(file_name.c_str());
-	int i,j;
-	for (i=0; i<GRID_HEIGHT; i++)
-	{
-		for (j=0; j<GRID_WIDTH; j++)
-		{
-			in >> prob_grid[i][j];
-		}
-	}
-	in.close();
+    std::ifstream in(file_name.c_str());
+    if (!robot_core::read_log_odds(grid, in))
+        ROS_ERROR("[Mapping::recoverFromFile] Could not read %s, the grid is unchanged", file_name.c_str());
 }
 
 void Mapping::recoverAndRefreshOccGrid(const std::string& file_name)
 {
+    boost::mutex::scoped_lock lock(mutex);
     recoverFromFile(file_name);
-    int i,j;
-    Point<int> point;
-    for (i=0; i<GRID_HEIGHT; i++) {
-        for (j=0; j<GRID_WIDTH; j++) {
-            point.x = i;
-            point.y = j;
-            if(prob_grid[j][i] != -0.693147)
-                updateOccupancyGrid(point);
-        }
+}
+
+/**
+  * Copies the grids under the lock and writes them without it, so the
+  * integration only waits for the copy.
+  */
+bool Mapping::saveCheckpoint(const std::string& file_name)
+{
+    navigation_msgs::MapCheckpoint msg;
+    msg.width = grid.width();
+    msg.height = grid.height();
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        msg.log_odds = grid.log_odds();
+        msg.seen = grid.seen();
     }
+    return node_utils::write_message(file_name, msg);
 }
 
-void Mapping::updateGrid()
+bool Mapping::restoreCheckpoint(const std::string& file_name)
 {
-    if(active) {
-        updateIR(fl_ir_reading, robot::ir::offset_front_left_forward);
-        updateIR(-fr_ir_reading, robot::ir::offset_front_right_forward);
-        updateIR(-br_ir_reading, -robot::ir::offset_rear_right_forward);
-        updateIR(bl_ir_reading, -robot::ir::offset_rear_left_forward);
+    navigation_msgs::MapCheckpoint msg;
+    if (!node_utils::read_message(file_name, msg))
+        return false;
 
-        if (use_planes())
-            updateWalls(false);
+    boost::mutex::scoped_lock lock(mutex);
+    if (msg.width != grid.width() || msg.height != grid.height() || !grid.assign(msg.log_odds, msg.seen))
+    {
+        ROS_ERROR("[Mapping::restoreCheckpoint] %s has a %ux%u grid, expected %dx%d",
+                  file_name.c_str(), msg.width, msg.height, grid.width(), grid.height());
+        return false;
     }
+    return true;
+}
 
-    updateHaveSeen();
+/**
+  * Restores the grids from the latest checkpoint if /checkpoint/restore is
+  * set. Phase 2 without a checkpoint falls back to the map file of phase 1.
+  * Announces mapping as ready either way.
+  */
+void Mapping::warmStart(bool p2)
+{
+    if (!checkpoint.restore() && p2)
+        recoverAndRefreshOccGrid(MAP_NAME);
+    checkpoint.ready();
+}
 
+/**
+  * Integrates the latest readings at the latest pose. The grids are
+  * published separately with publishMap.
+  */
+void Mapping::integrate()
+{
+    updateTransform();
+
+    boost::mutex::scoped_lock lock(mutex);
+    updateGrid();
 }
 
 /**
-  * Adapted from
-  * https://github.com/clearpathrobotics/occupancy_grid_utils/blob/hydro-devel/include/occupancy_grid_utils/impl/ray_trace_iterator.h
+  * Inserts the latest cloud of the depth camera at the pose of its stamp
+  * into the occupancy grid if /mapping/cloud/use is set, and into the height
+  * layer if /mapping/heights/use is set. Needs the frame of the camera in
+  * tf.
   */
-void Mapping::markPointsBetween(Point<int> p0, Point<int> p1, double val, bool markInSeen)
-{
-    const int dx = p1.x-p0.x;
-    const int dy = p1.y-p0.y;
-    const int abs_dx = abs(dx);
-    const int abs_dy = abs(dy);
-    const int8_t offset_dx = (dx>0) ? 1 : -1;;
-    const int8_t offset_dy = (dy>0) ? 1 : -1;;
-
-    int x_inc, y_inc;
-    int x_correction, y_correction;
-    int error, error_inc, error_threshold;
-
-    if (abs_dx > abs_dy) {
-        x_inc = offset_dx;
-        y_inc = 0;
-        x_correction = 0;
-        y_correction = offset_dy;
-        error = abs_dx/2;
-        error_inc = abs_dy;
-        error_threshold = abs_dx;
+void Mapping::integrateCloud()
+{
+    sensor_msgs::PointCloud2::ConstPtr latest;
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        latest.swap(cloud);
+        if (!active)
+            return;
+    }
+    bool into_grid = use_cloud();
+    bool into_heights = use_heights();
+    if (!latest || (!into_grid && !into_heights) || latest->data.empty())
+        return;
+
+    size_t offset;
+    if (!xyzOffset(*latest, offset)) {
+        LOG_ERROR_LIMITED(cloud_log, "[Mapping::integrateCloud] The cloud needs x, y and z as consecutive floats in dense rows");
+        return;
     }
-    else {
-        x_inc = 0;
-        y_inc = offset_dy;
-        x_correction = offset_dx;
-        y_correction = 0;
-        error = abs_dy/2;
-        error_inc = abs_dx;
-        error_threshold = abs_dy;
+
+    //without the tf thread the camera may just be ahead of tf, the cloud is tried again in the next cycle
+    if (!transformAvailable(latest->header.frame_id, latest->header.stamp, ros::Duration(0.1))
+            && !tf_thread && ros::Time::now() - latest->header.stamp < ros::Duration(0.5)) {
+        boost::mutex::scoped_lock lock(mutex);
+        if (!cloud)
+            cloud = latest;
+        return;
     }
 
-    Point<int> cell(p0.x,p0.y);
+    robot_core::Transform sensor_to_map;
+    if (!cloudTransform(*latest, sensor_to_map))
+        return;
 
-    if (markInSeen) {
-        markSeenGrid(cell, (int)val);
-        updateSeenVizGrid(cell);
-    }
-    else {
-        markProbabilityGrid(cell, val);
-        updateOccupancyGrid(cell);
-    }
+    robot_core::CloudInserter::Config config;
+    config.voxel_size = cloud_voxel_size();
+    config.min_z = cloud_min_z();
+    config.max_z = cloud_max_z();
+    config.min_range = cloud_min_range();
+    config.max_range = cloud_max_range();
+    config.threads = cloud_threads();
+    cloud_inserter.set_config(config);
+
+    robot_core::HeightGrid::Config height_config;
+    height_config.floor_tolerance = height_floor_tolerance();
+    height_config.max_step = height_max_step();
+    height_config.min_hits = height_min_hits();
+    height_config.max_height = cloud_max_z();
+    height_config.min_range = cloud_min_range();
+    height_config.max_range = cloud_max_range();
+
+    const uint8_t* xyz = &latest->data[offset];
+    size_t count = (size_t)latest->width*latest->height;
+
+    //the rays only need the size of the grid, which is fixed, so they are traced without the lock
+    int outside = 0;
+    if (into_grid)
+        outside += cloud_inserter.trace(grid, xyz, count, latest->point_step, sensor_to_map).outside;
 
-    while (cell.x != p1.x || cell.y != p1.y)
     {
-        cell.x += x_inc;
-        cell.y += y_inc;
-        error += error_inc;
-        if (error >= error_threshold) {
-            cell.x += x_correction;
-            cell.y += y_correction;
-            error -= error_threshold;
+        boost::mutex::scoped_lock lock(mutex);
+        if (into_grid)
+            cloud_inserter.apply(grid);
+        if (into_heights) {
+            heights.set_config(height_config);
+            outside += heights.insert(xyz, count, latest->point_step, sensor_to_map);
         }
+    }
+
+    if (outside > 0)
+        LOG_ERROR_LIMITED(out_of_bounds_log, "[Mapping::integrateCloud] %d points and cells of the cloud out of bounds",
+                          outside);
+}
 
-        if (markInSeen) {
-            if (isObstacle(cell.x,cell.y,false) || isObstacle(cell.x,cell.y,true))
-                break;
-            else {
-                markSeenGrid(cell, (int)val);
-                updateSeenVizGrid(cell);
-            }
+/**
+  * The offset of x in the points, if x, y and z follow each other as floats
+  * and the rows have no padding.
+  */
+bool Mapping::xyzOffset(const sensor_msgs::PointCloud2& cloud, size_t& offset)
+{
+    const char* names[] = {"x", "y", "z"};
+    int offsets[3] = {-1, -1, -1};
+    for(size_t i = 0; i < cloud.fields.size(); ++i) {
+        const sensor_msgs::PointField& field = cloud.fields[i];
+        for(int c = 0; c < 3; ++c) {
+            if (field.name == names[c] && field.datatype == sensor_msgs::PointField::FLOAT32)
+                offsets[c] = field.offset;
         }
-        else {
-            markProbabilityGrid(cell, val);
-            updateOccupancyGrid(cell);
+    }
+
+    if (offsets[0] < 0 || offsets[1] != offsets[0] + 4 || offsets[2] != offsets[0] + 8)
+        return false;
+    if (cloud.is_bigendian || cloud.row_step != cloud.width*cloud.point_step)
+        return false;
+    if (cloud.data.size() < (size_t)cloud.height*cloud.row_step)
+        return false;
+
+    offset = offsets[0];
+    return true;
+}
+
+/**
+  * Whether tf has frame_id in the map at stamp. With the tf thread it waits
+  * up to timeout. Without it the listener is fed by the callbacks of this
+  * thread, which cannot run meanwhile, so it only checks.
+  */
+bool Mapping::transformAvailable(const std::string& frame_id, const ros::Time& stamp, const ros::Duration& timeout)
+{
+    if (tf_thread)
+        return tf_listener->waitForTransform("map", frame_id, stamp, timeout);
+    return tf_listener->canTransform("map", frame_id, stamp);
+}
+
+/**
+  * The clouds lag behind the odometry, so the camera is looked up at the
+  * stamp of the cloud and not at the latest transform.
+  */
+bool Mapping::cloudTransform(const sensor_msgs::PointCloud2& cloud, robot_core::Transform& sensor_to_map)
+{
+    tf::StampedTransform stamped;
+    try {
+        tf_listener->lookupTransform("map", cloud.header.frame_id, cloud.header.stamp, stamped);
+    } catch (tf::TransformException ex) {
+        LOG_ERROR_LIMITED(cloud_log, "[Mapping::cloudTransform] %s", ex.what());
+        return false;
+    }
+
+    const tf::Matrix3x3& basis = stamped.getBasis();
+    for(int r = 0; r < 3; ++r) {
+        for(int c = 0; c < 3; ++c)
+            sensor_to_map.rotation[r*3 + c] = basis[r][c];
+        sensor_to_map.translation[r] = stamped.getOrigin()[r];
+    }
+    return true;
+}
+
+void Mapping::updateGrid()
+{
+    //stale readings would be integrated at the wrong pose
+    bool ir_fresh = false;
+    ros::Time now = ros::Time::now();
+    if (!ir_stamp.isZero()) {
+        ir_fresh = (now - ir_stamp).toSec() < ir_max_age();
+        if (ir_fresh && active)
+            ir_age_integrated.add(ir_stamp, now);
+    }
+
+    NO_ALLOCATION_REGION("mapping/update_grid");
+
+    if(active && ir_fresh) {
+        //skip readings that were flagged as outliers by the ir converter
+        if (ir_valid & ir_converter::Distance::FL_SIDE)
+            updateIR(fl_ir_reading, robot::ir::offset_front_left_forward);
+        if (ir_valid & ir_converter::Distance::FR_SIDE)
+            updateIR(-fr_ir_reading, robot::ir::offset_front_right_forward);
+        if (ir_valid & ir_converter::Distance::BR_SIDE)
+            updateIR(-br_ir_reading, -robot::ir::offset_rear_right_forward);
+        if (ir_valid & ir_converter::Distance::BL_SIDE)
+            updateIR(bl_ir_reading, -robot::ir::offset_rear_left_forward);
+
+        //each reading is integrated by every cycle while it is fresh, the first one ends its trace
+        if (ir_trace_id != 0) {
+            ros::Time end = ros::Time::now();
+            node_utils::trace_span("mapping/wait_cycle", ir_trace_id, ir_received, now);
+            node_utils::trace_span("mapping/update_ir", ir_trace_id, now, end);
+            node_utils::trace_span("ir/end_to_end", ir_trace_id, ir_stamp, end);
+            ir_trace_id = 0;
         }
     }
+
+    integrateWalls();
+
+    updateHaveSeen();
+
+}
+
+/**
+  * Marks the ray in the occupancy grid, or in the seen grid up to the first
+  * obstacle.
+  */
+void Mapping::markPointsBetween(robot_core::Cell p0, robot_core::Cell p1, double val, bool markInSeen)
+{
+    int outside;
+    if (markInSeen)
+        outside = robot_core::mark_seen_ray(grid, p0, p1, (uint8_t)val);
+    else
+        outside = robot_core::mark_ray(grid, p0, p1, val);
+
+    if (outside > 0)
+        LOG_ERROR_LIMITED(out_of_bounds_log, "[Mapping::markPointsBetween] %d cells of (%d, %d) -> (%d, %d) out of bounds",
+                          outside, p0.x, p0.y, p1.x, p1.y);
 }
 
 
 void Mapping::updateIR(double ir_reading, double ir_x_offset)
 {
     Point<double> ir_pos = Point<double>(ir_x_offset, 0);
-    Point<int> p0 = robotPointToCell(ir_pos);
+    robot_core::Cell p0 = robotPointToCell(ir_pos);
 
     if(isIRValid(ir_reading))
     {
         Point<double> obstacle(ir_x_offset, ir_reading);
-        Point<int> p1 = robotPointToCell(obstacle);
+        robot_core::Cell p1 = robotPointToCell(obstacle);
 
         markCellOccupied(p1);
-        markPointsBetween(p0, p1, P_FREE);
+        markPointsBetween(p0, p1, robot_core::Grid::P_FREE);
     } else {
         double mult = ir_reading > 0 ? 1.0 : -1.0;
         Point<double> max_point = Point<double>(ir_pos.x, MAX_IR_DIST*0.75*mult);
-        Point<int> p1 = robotPointToCell(max_point);
-        markPointsBetween(p0, p1, P_FREE);
+        robot_core::Cell p1 = robotPointToCell(max_point);
+        markPointsBetween(p0, p1, robot_core::Grid::P_FREE);
     }
 }
 
-void Mapping::updateWalls(bool markOnHaveSeen)
+/**
+  * Takes the walls of the planes into the map frame at pose and queues
+  * them for integrateWalls.
+  */
+void Mapping::queueWalls(const std::vector<common::vision::SegmentedPlane>& planes, const tf::Transform& pose)
 {
-    for(int i = 0; i < wall_planes->size(); ++i)
+    for(int i = 0; i < planes.size(); ++i)
     {
-        if(wall_planes->at(i).is_ground_plane())
+        const common::vision::SegmentedPlane& plane = planes[i];
+        if(plane.is_ground_plane())
             continue;
 
-        common::vision::SegmentedPlane& plane = wall_planes->at(i);
-
         double width = std::max(plane.get_obb().get_width(), plane.get_obb().get_depth());
 
         //only consider walls that have a minimum width
@@ -277,183 +458,80 @@ void Mapping::updateWalls(bool markOnHaveSeen)
         Eigen::Vector2f p0 = center + ortho*width;
         Eigen::Vector2f p1 = center - ortho*width;
 
-        Point<int> cell_p0 = robotPointToCell(Point<double>(p0(0),p0(1)));
-        Point<int> cell_p1 = robotPointToCell(Point<double>(p1(0),p1(1)));
+        tf::Vector3 map_p0 = pose*tf::Vector3(p0(0), p0(1), 0.0);
+        tf::Vector3 map_p1 = pose*tf::Vector3(p1(0), p1(1), 0.0);
 
-        if (markOnHaveSeen)
-            markPointsBetween(cell_p0,cell_p1,2,true);
-        else
-            markPointsBetween(cell_p0,cell_p1,P_OCC,false);
+        WallSegment wall;
+        wall.p0 = grid.to_cell(map_p0.getX(), map_p0.getY());
+        wall.p1 = grid.to_cell(map_p1.getX(), map_p1.getY());
+        wall_queue.push_back(wall);
     }
-
-}
-
-void rotatePoint(Point<int> p, Point<int> origin, double angle_rad, Point<int>& target)
-{
-    double c = std::cos(angle_rad);
-    double s = std::sin(angle_rad);
-
-    double o_x = origin.x;
-    double o_y = origin.y;
-
-    double p_x = p.x;
-    double p_y = p.y;
-
-    double x = o_x + c*(p_x-o_x) - s*(p_y-o_y);
-    double y = o_y + s*(p_x-o_x) + c*(p_y-o_y);
-
-    target.x = round(x);
-    target.y = round(y);
 }
 
-void Mapping::updateHaveSeen()
+/**
+  * Integrates the queued walls once each, a plane message is one
+  * observation. They are obstacles in the seen grid, and in the occupancy
+  * grid with /mapping/use_planes.
+  */
+void Mapping::integrateWalls()
 {
-    updateWalls(true);
-
-    Point<int> origin = robotPointToCell(Point<double>(0,0));
-    Point<int> end = robotPointToCell(Point<double>(frustum_dist(),0));
-    Point<int> p1;
-
-    double angle0 = -DEG2RAD(frustum_fov())/2.0;
-    double angle1 = -angle0;
-
-    double dangle = DEG2RAD(1.0);
-
-    for(double angle = angle0; angle < angle1; angle += dangle)
+    bool occupied = active && use_planes();
+    for(size_t i = 0; i < wall_queue.size(); ++i)
     {
-        rotatePoint(end, origin, angle, p1);
-        markPointsBetween(origin, p1, 1, true);
+        const WallSegment& wall = wall_queue[i];
+        if (occupied)
+            markPointsBetween(wall.p0, wall.p1, robot_core::Grid::P_OCC, false);
+        markPointsBetween(wall.p0, wall.p1, robot_core::Grid::SEEN_OBSTACLE, true);
     }
+    wall_queue.clear();
 }
 
-/*void Mapping::markPointOccupied(Point<double> point)
-{
-    Point<int> cell = robotPointToCell(point);
-    int x = cell.x;
-    int y = cell.y;
-    for(int i = x-1; i < x+1; ++i)
-    {
-        for(int j = y-1; j < y+1; ++j)
-        {
-            Point<int> c(i, j);
-            markProbabilityGrid(c, P_OCC);
-            updateOccupancyGrid(c);
-        }
-    }
-}*/
-
-void Mapping::markCellOccupied(Point<int> cell, int neighborhood)
+/**
+  * The heights of the height layer are measured from the ground plane of
+  * the planes, taken into the map frame at pose.
+  */
+void Mapping::updateGround(const std::vector<common::vision::SegmentedPlane>& planes, const tf::Transform& pose)
 {
-    int x = cell.x;
-    int y = cell.y;
-    Point<int> c;
-    for(int i = x-neighborhood; i < x+neighborhood; ++i)
+    for(int i = 0; i < planes.size(); ++i)
     {
-        for(int j = y-neighborhood; j < y+neighborhood; ++j)
-        {
-            c.x = i;
-            c.y = j;
-            markProbabilityGrid(c, P_OCC);
-            updateOccupancyGrid(c);
-        }
-    }
-}
-
-void Mapping::markPoint(Point<double> point, double val)
-{
-    Point<int> cell = robotPointToCell(point);
-    markProbabilityGrid(cell, val);
-    updateOccupancyGrid(cell);
-}
-
-Point<int> Mapping::robotPointToCell(Point<double> point)
-{
-    Point<double> map_point = robotToMapTransform(point);
-    return mapPointToCell(map_point);
-}
-
-Point<double> Mapping::robotToMapTransform(Point<double> point)
-{
-    geometry_msgs::PointStamped robot_point_msg;
-    robot_point_msg.header.frame_id = "robot";
-    robot_point_msg.header.stamp = ros::Time::now();
-    robot_point_msg.point.x = point.x;
-    robot_point_msg.point.y = point.y;
-    robot_point_msg.point.z = 0.0;
-    tf::Stamped<tf::Point> robot_point;
-    tf::pointStampedMsgToTF(robot_point_msg, robot_point);
-    tf::Vector3 map_point = transform*robot_point;
-
-    Point<double> res = Point<double>(map_point.getX() + MAP_X_OFFSET, map_point.getY() + MAP_Y_OFFSET);
-    return res;
-}
+        if (!planes[i].is_ground_plane())
+            continue;
 
-Point<int> Mapping::mapPointToCell(Point<double> point)
-{
-    int x = round(point.x*100.0);
-    int y = round(point.y*100.0);
-    return Point<int>(x,y);
-}
+        const std::vector<float>& coeff = planes[i].get_coefficients()->values;
+        tf::Vector3 normal = pose.getBasis()*tf::Vector3(coeff[0], coeff[1], coeff[2]);
+        double d = coeff[3] - normal.dot(pose.getOrigin());
 
-void Mapping::markSeenGrid(Point<int> cell, int flag)
-{
-    if (cell.y < 0 || cell.y >= seen_grid.size() ||
-        cell.x < 0 || cell.x >= seen_grid[cell.y].size())
-    {
-        ROS_ERROR("[Mapping::markSeenGrid] Array out of bounds");
+        heights.set_ground(normal.x(), normal.y(), normal.z(), d);
         return;
     }
-
-    seen_grid[cell.y][cell.x] = flag;
 }
 
-void Mapping::markProbabilityGrid(Point<int> cell, double log_prob)
+void Mapping::updateHaveSeen()
 {
-    if (cell.y < 0 || cell.y >= prob_grid.size() ||
-        cell.x < 0 || cell.x >= prob_grid[cell.y].size())
-    {
-        ROS_ERROR("[Mapping::markProbabilityGrid] Array out of bounds");
-        return;
-    }
+    robot_core::Cell origin = robotPointToCell(Point<double>(0,0));
+    robot_core::Cell end = robotPointToCell(Point<double>(frustum_dist(),0));
 
-    prob_grid[cell.y][cell.x] += log_prob - P_PRIOR;
+    int outside = robot_core::mark_seen_fan(grid, origin, end, DEG2RAD(frustum_fov()), DEG2RAD(1.0),
+                                            robot_core::Grid::SEEN);
+    if (outside > 0)
+        LOG_ERROR_LIMITED(out_of_bounds_log, "[Mapping::updateHaveSeen] %d cells of the frustum out of bounds", outside);
 }
 
-void Mapping::updateOccupancyGrid(Point<int> cell)
+void Mapping::markCellOccupied(robot_core::Cell cell, int neighborhood)
 {
-    if (cell.y < 0 || cell.y >= prob_grid.size() ||
-        cell.x < 0 || cell.x >= prob_grid[cell.y].size())
-    {
-        ROS_ERROR("[Mapping::markProbabilityGrid] Array out of bounds");
-        return;
-    }
-
-    int pos = cell.x*GRID_WIDTH + cell.y;
-    if(prob_grid[cell.y][cell.x] > FREE_OCCUPIED_THRESHOLD)
-        occupancy_grid.data[pos] = OCCUPIED;
-    else if(prob_grid[cell.y][cell.x] < FREE_OCCUPIED_THRESHOLD)
-        occupancy_grid.data[pos] = FREE;
-    else
-        occupancy_grid.data[pos] = UNKNOWN;
+    int outside = robot_core::mark_block(grid, cell, neighborhood, robot_core::Grid::P_OCC);
+    if (outside > 0)
+        LOG_ERROR_LIMITED(out_of_bounds_log, "[Mapping::markCellOccupied] %d cells around (%d, %d) out of bounds",
+                          outside, cell.x, cell.y);
 }
 
-void Mapping::updateSeenVizGrid(Point<int> cell)
+/**
+  * Called for every ray, so no stamped message with its frame id string.
+  */
+robot_core::Cell Mapping::robotPointToCell(Point<double> point)
 {
-    if (cell.y < 0 || cell.y >= seen_grid.size() ||
-        cell.x < 0 || cell.x >= seen_grid[cell.y].size())
-    {
-        ROS_ERROR("[Mapping::markProbabilityGrid] Array out of bounds");
-        return;
-    }
-
-    int pos = cell.x*GRID_WIDTH + cell.y;
-    int8_t flag = seen_grid[cell.y][cell.x];
-    if(flag == 1)
-        seen_viz_grid.data[pos] = FREE;
-    else if (flag == 2)
-        seen_viz_grid.data[pos] = OCCUPIED;
-    else
-        seen_viz_grid.data[pos] = UNKNOWN;
+    tf::Vector3 map_point = transform*tf::Vector3(point.x, point.y, 0.0);
+    return grid.to_cell(map_point.getX(), map_point.getY());
 }
 
 bool Mapping::isIRValid(double value)
@@ -461,143 +539,151 @@ bool Mapping::isIRValid(double value)
     return std::abs(value) < MAX_IR_DIST && std::abs(value) > MIN_IR_DIST;
 }
 
-void Mapping::initProbabilityGrid()
-{
-    prob_grid.resize(GRID_HEIGHT);
-    for(int i = 0; i < GRID_HEIGHT; ++i)
-        prob_grid[i].resize(GRID_WIDTH, P_PRIOR);
-
-//    for(int i = 0; i < GRID_HEIGHT; ++i)
-//        for(int j = 0; j < GRID_WIDTH; ++j)
-//            prob_grid[i][j] = P_PRIOR;
-
-
-    seen_grid.resize(GRID_HEIGHT);
-    for(int i = 0; i < GRID_HEIGHT; ++i)
-        seen_grid[i].resize(GRID_WIDTH, 0);
-}
-
-void Mapping::initOccupancyGrid()
+void Mapping::distanceCallback(const ros::MessageEvent<ir_converter::Distance const>& event)
 {
-    occupancy_grid.data.resize(GRID_WIDTH*GRID_HEIGHT);
-    for(int i = 0; i < GRID_HEIGHT*GRID_WIDTH; ++i)
-            occupancy_grid.data[i] = UNKNOWN;
+    const ir_converter::Distance::ConstPtr& distance = event.getMessage();
+    node_utils::CallbackTimer timer(distance_stats, event.getReceiptTime());
+    boost::mutex::scoped_lock lock(mutex);
 
-    seen_viz_grid.data.resize(GRID_WIDTH*GRID_HEIGHT);
-    for(int i = 0; i < GRID_HEIGHT*GRID_WIDTH; ++i)
-        seen_viz_grid.data[i] = UNKNOWN;
-}
-
-void Mapping::distanceCallback(const ir_converter::Distance::ConstPtr& distance)
-{   
     fl_ir_reading = distance->fl_side;
     bl_ir_reading = distance->bl_side;
     fr_ir_reading = distance->fr_side;
     br_ir_reading = distance->br_side;
+    ir_valid = distance->valid;
+    ir_stamp = distance->header.stamp;
+    ir_received = ros::Time::now();
+    ir_trace_id = node_utils::trace_id(ir_stamp);
+
+    ir_age_received.add(ir_stamp, ir_received);
+    node_utils::trace_span("mapping/receive", ir_trace_id, ir_stamp, ir_received);
 }
 
 void Mapping::odometryCallback(const nav_msgs::Odometry::ConstPtr& odom)
 {
+    node_utils::CallbackTimer timer(odometry_stats);
+    node_utils::TraceSpan span("mapping/odometry", node_utils::trace_id(odom->header.stamp));
+    boost::mutex::scoped_lock lock(mutex);
+
     double x = odom->pose.pose.position.x;
     double y = odom->pose.pose.position.y;
     pos = Point<double>(x,y);
 }
 
+/**
+  * Waits for the transform without holding the lock, so the callbacks are
+  * not blocked meanwhile. Until tf has one the last transform is kept.
+  */
 void Mapping::updateTransform()
 {
+    if (!transformAvailable("robot", ros::Time(0), ros::Duration(10.0))) {
+        ROS_WARN_THROTTLE(1.0, "[Mapping::updateTransform] No transform from robot to map");
+        return;
+    }
+
+    tf::StampedTransform latest;
     try {
-        tf_listener.waitForTransform("map", "robot", ros::Time(0), ros::Duration(10.0) );
-        tf_listener.lookupTransform("map", "robot", ros::Time(0), transform);
+        tf_listener->lookupTransform("map", "robot", ros::Time(0), latest);
     } catch (tf::TransformException ex) {
         ROS_ERROR("%s",ex.what());
+        return;
     }
-}
-
-void Mapping::wallDetectedCallback(const vision_msgs::Planes::ConstPtr & msg)
-{
-    wall_planes->clear();
-    common::vision::msgToPlanes(msg, wall_planes);
-
-    markers_robot.add(msg);
-    pub_viz.publish(markers_robot.get());
-    markers_robot.clear();
 
+    boost::mutex::scoped_lock lock(mutex);
+    transform = latest;
 }
 
-void Mapping::publishMap()
+/**
+  * Only keeps the cloud, it is inserted by integrateCloud. A cloud that was
+  * not inserted in time is replaced.
+  */
+void Mapping::cloudCallback(const sensor_msgs::PointCloud2::ConstPtr& msg)
 {
-    map_pub.publish(occupancy_grid);
-    seen_pub.publish(seen_viz_grid);
+    node_utils::CallbackTimer timer(cloud_stats);
+    boost::mutex::scoped_lock lock(mutex);
+    cloud = msg;
 }
 
-int main(int argc, char **argv)
+/**
+  * The walls are converted at the pose of the message and queued, so every
+  * message is integrated once, however many cycles run until the next one.
+  * The latest transform of tf is closer to the message than the pose of the
+  * last cycle, which is the fallback.
+  */
+void Mapping::wallDetectedCallback(const vision_msgs::Planes::ConstPtr & msg)
 {
-    ros::init(argc, argv, "mapping");
-    Mapping mapping;
-    //int size = argv.size();
-    int i;
-    for(i=0; i<argc; i++) {
-    	if(strcmp(argv[i],"p2") == 0)
-    		mapping.recoverAndRefreshOccGrid(mapping.MAP_NAME);
-    }
+    node_utils::CallbackTimer timer(planes_stats);
 
-    ros::Rate loop_rate(20);
+    common::vision::SegmentedPlane::ArrayPtr planes(new std::vector<common::vision::SegmentedPlane>());
+    common::vision::msgToPlanes(msg, planes);
 
-    int counter = 0;
-    while(ros::ok())
-    {
-        mapping.updateTransform();
-        ++counter;
-        mapping.updateGrid();
-        if(counter % 10 == 0) {
-            mapping.publishMap();
-        }
-        ros::spinOnce();
-        loop_rate.sleep();
+    tf::StampedTransform pose;
+    bool has_pose = true;
+    try {
+        tf_listener->lookupTransform("map", "robot", ros::Time(0), pose);
+    } catch (tf::TransformException ex) {
+        has_pose = false;
     }
-}
 
-bool Mapping::isObstacle(int x, int y, bool inHaveSeen)
-{
-    if (y < 0 || y >= prob_grid.size())
-        return false;
-    if (x < 0 || x >= prob_grid[y].size())
-        return false;
-
-    if (inHaveSeen) {
-        if(seen_grid[y][x] == 2)
-            return true;
-    }
-    else {
-        if(prob_grid[y][x] > FREE_OCCUPIED_THRESHOLD)
-            return true;
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        if (!has_pose)
+            pose = transform;
+        queueWalls(*planes, pose);
+        updateGround(*planes, pose);
     }
-    return false;
-}
-
-bool Mapping::isUnexplored(int x, int y)
-{
-    if (y < 0 || y >= seen_grid.size())
-        return false;
-    if (x < 0 || x >= seen_grid[y].size())
-        return false;
 
-    if (seen_grid[y][x] == 0)
-        return true;
+    markers_robot.add(msg);
+    pub_viz.publish(markers_robot.get());
+    markers_robot.clear();
 
-    return false;
 }
 
-void addPointToList(std::vector<Point<int> >& list, int x, int y)
+/**
+  * The grids keep being updated after publishing, so subscribers get a copy.
+  * Within a nodelet manager this copy is all that is passed on; there is no
+  * serialization. A grid nobody subscribes to is not copied, which keeps
+  * the lock short, as the copies are taken under it.
+  */
+void Mapping::publishMap()
 {
-    if (!list.empty()) {
-        Point<int> p(x,y);
-        Point<int>& last = list[list.size()-1];
+    bool want_map = map_pub.getNumSubscribers() > 0;
+    bool want_seen = seen_pub.getNumSubscribers() > 0;
+    bool want_height = use_heights() && height_pub.getNumSubscribers() > 0;
+    if (!want_map && !want_seen && !want_height)
+        return;
 
-        if (p.x != last.x || p.y != last.y)
-            list.push_back(p);
+    //allocated before locking, under the lock the views are only copied
+    size_t cells = (size_t)occupancy_grid.info.width*occupancy_grid.info.height;
+    nav_msgs::OccupancyGridPtr map, seen, height;
+    if (want_map) {
+        map.reset(new nav_msgs::OccupancyGrid(occupancy_grid));
+        map->data.reserve(cells);
+    }
+    if (want_seen) {
+        seen.reset(new nav_msgs::OccupancyGrid(seen_viz_grid));
+        seen->data.reserve(cells);
     }
-    else list.push_back(Point<int>(x,y));
+    if (want_height) {
+        height.reset(new nav_msgs::OccupancyGrid(occupancy_grid));
+        height->data.reserve(cells);
+    }
+
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        if (map)
+            map->data = grid.occupancy_view();
+        if (seen)
+            seen->data = grid.seen_view();
+        if (height)
+            height->data = heights.view();
+    }
+
+    if (map)
+        map_pub.publish(map);
+    if (seen)
+        seen_pub.publish(seen);
+    if (height)
+        height_pub.publish(height);
 }
 
 Point<double> Mapping::transformPointToRobotSystem(std::string& frame_id, double x, double y)
@@ -612,12 +698,12 @@ Point<double> Mapping::transformPointToRobotSystem(std::string& frame_id, double
     stamped_in.point.z = 0;
 
     geometry_msgs::PointStamped stamped_out;
-    tf_listener.transformPoint("robot",stamped_in,stamped_out);
+    tf_listener->transformPoint("robot",stamped_in,stamped_out);
 
     return Point<double>(stamped_out.point.x, stamped_out.point.y);
 }
 
-Point<int> Mapping::transformPointToGridSystem(const std::string& frame_id, double x, double y)
+robot_core::Cell Mapping::transformPointToGridSystem(const std::string& frame_id, double x, double y)
 {
     geometry_msgs::PointStamped stamped_in;
     stamped_in.header.frame_id = frame_id;
@@ -628,9 +714,9 @@ Point<int> Mapping::transformPointToGridSystem(const std::string& frame_id, doub
     stamped_in.point.z = 0;
 
     geometry_msgs::PointStamped stamped_out;
-    tf_listener.transformPoint("map",stamped_in,stamped_out);
+    tf_listener->transformPoint("map",stamped_in,stamped_out);
 
-    return mapPointToCell(Point<double>(stamped_out.point.x + MAP_X_OFFSET, stamped_out.point.y + MAP_Y_OFFSET));
+    return grid.to_cell(stamped_out.point.x, stamped_out.point.y);
 }
 
 Point<double> Mapping::transformPointToMapSystem(std::string& frame_id, double x, double y)
@@ -644,88 +730,37 @@ Point<double> Mapping::transformPointToMapSystem(std::string& frame_id, double x
     stamped_in.point.z = 0;
 
     geometry_msgs::PointStamped stamped_out;
-    tf_listener.transformPoint("map",stamped_in,stamped_out);
+    tf_listener->transformPoint("map",stamped_in,stamped_out);
 
     return Point<double>(stamped_out.point.x, stamped_out.point.y);
 }
 
-Point<double> Mapping::transformCellToMap(Point<int>& cell)
+Point<double> Mapping::transformCellToMap(robot_core::Cell cell)
 {
-    double x = cell.x;
-    double y = cell.y;
-    return Point<double>(x/100.0 - MAP_X_OFFSET, y/100.0 - MAP_Y_OFFSET);
+    Point<double> point;
+    grid.to_point(cell, point.x, point.y);
+    return point;
 }
 
 bool Mapping::performRaycast(navigation_msgs::RaycastRequest &request, navigation_msgs::RaycastResponse &response)
 {
+    node_utils::CallbackTimer timer(raycast_stats);
+    boost::mutex::scoped_lock lock(mutex);
+
     Eigen::Vector2d dir(request.dir_x, request.dir_y);
     dir.normalize();
     dir *= request.max_length;
 
     //transform points to robot coordinate system (better would be map system though.)
-    Point<int> p0 = transformPointToGridSystem(request.frame_id, request.origin_x, request.origin_y);
-    Point<int> p1 = transformPointToGridSystem(request.frame_id, request.origin_x + dir(0), request.origin_y + dir(1));
+    robot_core::Cell p0 = transformPointToGridSystem(request.frame_id, request.origin_x, request.origin_y);
+    robot_core::Cell p1 = transformPointToGridSystem(request.frame_id, request.origin_x + dir(0), request.origin_y + dir(1));
 
-    std::vector<Point<double> > obstacle_points;
-
-    //raycast algorithm, adapted from markPointsBetween
-    const int dx = p1.x-p0.x;
-    const int dy = p1.y-p0.y;
-    const int abs_dx = abs(dx);
-    const int abs_dy = abs(dy);
-    const int8_t offset_dx = (dx>0) ? 1 : -1;;
-    const int8_t offset_dy = (dy>0) ? 1 : -1;;
-
-    int x_inc, y_inc;
-    int x_correction, y_correction;
-    int error, error_inc, error_threshold;
-
-    if (abs_dx > abs_dy) {
-        x_inc = offset_dx;
-        y_inc = 0;
-        x_correction = 0;
-        y_correction = offset_dy;
-        error = abs_dx/2;
-        error_inc = abs_dy;
-        error_threshold = abs_dx;
-    }
-    else {
-        x_inc = 0;
-        y_inc = offset_dy;
-        x_correction = offset_dx;
-        y_correction = 0;
-        error = abs_dy/2;
-        error_inc = abs_dx;
-        error_threshold = abs_dy;
-    }
-
-    Point<int> cell(p0.x,p0.y);
-
-    if (isObstacle(cell.x,cell.y)) {
-        obstacle_points.push_back(transformCellToMap(cell));
-    }
+    std::vector<robot_core::Cell> hits;
+    robot_core::find_obstacles(grid, p0, p1, 2, hits);
 
-    while (cell.x != p1.x || cell.y != p1.y)
-    {
-        cell.x += x_inc;
-        cell.y += y_inc;
-        error += error_inc;
-        if (error >= error_threshold) {
-            cell.x += x_correction;
-            cell.y += y_correction;
-            error -= error_threshold;
-        }
-
-//        markProbabilityGrid(cell,P_OCC);
-//        updateOccupancyGrid(cell);
-
-        if (isObstacle(cell.x,cell.y)) {
-            obstacle_points.push_back(transformCellToMap(cell));
-
-            if(obstacle_points.size() >= 2)
-                break;
-        }
-    }
+    std::vector<Point<double> > obstacle_points;
+    for(size_t i = 0; i < hits.size(); ++i)
+        obstacle_points.push_back(transformCellToMap(hits[i]));
 
     //TODO: distance between 3 hits cannot be greater than x
 
@@ -772,99 +807,128 @@ bool Mapping::performRaycast(navigation_msgs::RaycastRequest &request, navigatio
 
 }
 
+/**
+  * With the height layer the low obstacles count as occupied as well, it
+  * costs one more read per cell.
+  */
+robot_core::RegionCount Mapping::countDisc(robot_core::Cell center, int radius)
+{
+    if (use_heights())
+        return robot_core::count_disc(grid, heights, center, radius);
+    return robot_core::count_disc(grid, center, radius);
+}
+
 bool Mapping::serviceFitRequest(navigation_msgs::FitBlobRequest &request, navigation_msgs::FitBlobResponse &response)
 {
+    boost::mutex::scoped_lock lock(mutex);
+
     double radius_map = request.radius;
     int radius = round(radius_map*100.0);
-    Point<int> center = transformPointToGridSystem(request.frame_id, request.x, request.y);
-    Point<int> top_left(center.x - radius, center.y - radius);
-    int width = radius*2;
-
-    int num_cells = 0;
-    int num_occluded = 0;
-
-    //count occluded cells
-    for(int y = top_left.y; y < top_left.y+width; ++y) {
-        for(int x = top_left.x; x < top_left.x+width; ++x) {
+    robot_core::Cell center = transformPointToGridSystem(request.frame_id, request.x, request.y);
+    robot_core::RegionCount count = countDisc(center, radius);
 
-            int dx = center.x - x; // horizontal offset
-            int dy = center.y - y; // vertical offset
-            if ( (dx*dx + dy*dy) <= (radius*radius) )
-            {
-                if (isObstacle(x,y))
-                    num_occluded++;
-
-                num_cells++;
-            }
-
-        }
-    }
-
-    if (num_cells == 0) {
+    if (count.cells == 0) {
         response.fits = false;
         return true;
     }
 
-    response.fits = ((double)num_occluded/(double)num_cells) < request.max_occlusion_ratio;
+    response.fits = ((double)count.occupied/(double)count.cells) < request.max_occlusion_ratio;
 
     return true;
 }
 
 void Mapping::activateUpdateCallback(const std_msgs::Bool::ConstPtr& active)
 {
+    boost::mutex::scoped_lock lock(mutex);
     this->active = active;   
 }
 
 void Mapping::saveMapCallback(const std_msgs::Empty::ConstPtr& empty)
 {
+    boost::mutex::scoped_lock lock(mutex);
 	saveToFile(MAP_NAME);
 }
 
 bool Mapping::serviceHasUnexploredRegion(navigation_msgs::UnexploredRegionRequest& request,
                                          navigation_msgs::UnexploredRegionResponse& response)
 {
+    node_utils::CallbackTimer timer(unexplored_stats);
+    boost::mutex::scoped_lock lock(mutex);
+
     double radius_map = request.radius;
     int radius = round(radius_map*100.0);
-    Point<int> center = transformPointToGridSystem(request.frame_id, request.x, request.y);
-    Point<int> top_left(center.x - radius, center.y - radius);
-    int width = radius*2;
+    robot_core::Cell center = transformPointToGridSystem(request.frame_id, request.x, request.y);
+    robot_core::RegionCount count = countDisc(center, radius);
 
-    int num_cells = 0;
-    int num_occluded = 0;
-    int num_unexplored = 0;
+    response.has_unexplored = false;
 
-    //count occluded cells
-    for(int y = top_left.y; y < top_left.y+width; ++y) {
-        for(int x = top_left.x; x < top_left.x+width; ++x) {
+    if (count.cells == 0)
+        return true;
 
-            int dx = center.x - x; // horizontal offset
-            int dy = center.y - y; // vertical offset
-            if ( (dx*dx + dy*dy) <= (radius*radius) )
-            {
-                if (isObstacle(x,y))
-                    num_occluded++;
+    double occlusion_ratio = ((double)count.occupied/(double)count.cells);
+    if (occlusion_ratio < request.max_occlusion_ratio)
+    {
+        double unexplored_ratio = ((double)count.unexplored/(double)count.cells);
 
-                if (isUnexplored(x,y))
-                    num_unexplored++;
+        response.has_unexplored = unexplored_ratio > request.min_notseen_ratio;
+    }
 
-                num_cells++;
-            }
+    return true;
+}
 
-        }
-    }
+//------------------------------------------------------------------------------
+// Tasks
 
-    response.has_unexplored = false;
+/**
+  * Integration runs at 20 Hz and drops the cycles it fell behind on, a late
+  * cycle integrates the latest readings anyway. The clouds of the depth
+  * camera are inserted at its rate of 30 Hz by a task of their own, so a
+  * slow cloud does not delay the ir readings. The grids are published at
+  * 2 Hz with a lower priority.
+  */
+void add_mapping_tasks(node_utils::PeriodicExecutor& executor, Mapping& mapping)
+{
+    executor.add("mapping/integrate", 20.0, boost::bind(&Mapping::integrate, &mapping));
+    executor.add("mapping/cloud", 30.0, boost::bind(&Mapping::integrateCloud, &mapping));
+    executor.add("mapping/publish", 2.0, boost::bind(&Mapping::publishMap, &mapping),
+                 node_utils::PeriodicExecutor::SKIP, -5);
+}
 
-    if (num_cells == 0)
-        return true;
+//------------------------------------------------------------------------------
+// Nodelet
 
-    double occlusion_ratio = ((double)num_occluded/(double)num_cells);
-    if (occlusion_ratio < request.max_occlusion_ratio)
+namespace mapping {
+
+class MappingNodelet : public nodelet::Nodelet
+{
+public:
+    virtual void onInit()
     {
-        double unexplored_ratio = ((double)num_unexplored/(double)num_cells);
+        ros::NodeHandle& n = getNodeHandle();
+        _mapping.reset(new Mapping(n));
+
+        bool p2 = false;
+        const std::vector<std::string>& argv = getMyArgv();
+        for(size_t i = 0; i < argv.size(); ++i) {
+            if(argv[i] == "p2")
+                p2 = true;
+        }
+        _mapping->warmStart(p2);
 
-        response.has_unexplored = unexplored_ratio > request.min_notseen_ratio;
+        add_mapping_tasks(_executor, *_mapping);
+        _executor.start();
     }
 
-    return true;
+    virtual ~MappingNodelet()
+    {
+        _executor.stop();
+    }
+
+private:
+    boost::shared_ptr<Mapping> _mapping;
+    node_utils::PeriodicExecutor _executor;
+};
+
 }
+
+PLUGINLIB_EXPORT_CLASS(mapping::MappingNodelet, nodelet::Nodelet)
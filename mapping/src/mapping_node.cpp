@@ -0,0 +1,18 @@
+#include "mapping/mapping.h"
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "mapping");
+    Mapping mapping;
+    bool p2 = false;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i],"p2") == 0)
+            p2 = true;
+    }
+    mapping.warmStart(p2);
+
+    //integration and publishing on their own threads, callbacks on the spinner
+    node_utils::PeriodicExecutor executor;
+    add_mapping_tasks(executor, mapping);
+    executor.spin();
+}
@@ -0,0 +1,59 @@
+#ifndef MAZE_SIMULATOR_IR_MODEL_H
+#define MAZE_SIMULATOR_IR_MODEL_H
+
+#include <common/robot.h>
+#include <cmath>
+#include <vector>
+
+namespace maze_simulator {
+
+/**
+  * Inverse of the robot::ir calibration curve of one sensor: the adc code
+  * the sensor reports for a given distance from its surface. The curve is
+  * inverted once into a table of 1 mm steps up to max_dist; distances
+  * beyond that report the code of max_dist.
+  */
+class IRModel {
+public:
+
+    static const int ADC_MAX = 1023;
+
+    void build(int sensor_id, double max_dist)
+    {
+        const double step = 0.001;
+        int n = (int)(max_dist/step) + 1;
+
+        double curve[ADC_MAX+1];
+        for(int adc = 0; adc <= ADC_MAX; ++adc)
+            curve[adc] = robot::ir::distance(sensor_id, adc);
+
+        _step = step;
+        _table.resize(n);
+        for(int i = 0; i < n; ++i) {
+            double d = i*step;
+            int best = 0;
+            for(int adc = 1; adc <= ADC_MAX; ++adc) {
+                if (std::fabs(curve[adc] - d) < std::fabs(curve[best] - d))
+                    best = adc;
+            }
+            _table[i] = best;
+        }
+    }
+
+    inline int adc(double distance) const
+    {
+        int i = (int)(distance/_step + 0.5);
+        if (i < 0) i = 0;
+        if (i >= (int)_table.size()) i = _table.size()-1;
+        return _table[i];
+    }
+
+protected:
+
+    double _step;
+    std::vector<int> _table;
+};
+
+}
+
+#endif // MAZE_SIMULATOR_IR_MODEL_H
@@ -0,0 +1,209 @@
+#ifndef MAZE_SIMULATOR_MAZE_H
+#define MAZE_SIMULATOR_MAZE_H
+
+#include <robot_core/grid.h>
+#include <stdint.h>
+#include <cmath>
+#include <fstream>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace maze_simulator {
+
+/**
+  * Ground truth maze as a grid of occupied cells. Cell (0,0) covers the
+  * square [origin_x, origin_x+resolution) x [origin_y, origin_y+resolution).
+  */
+class Maze {
+public:
+
+    Maze()
+        :_width(0)
+        ,_height(0)
+        ,_resolution(0.01)
+        ,_origin_x(0)
+        ,_origin_y(0)
+    {}
+
+    /**
+      * Loads a PGM (P2 or P5) as written by map_server: the first row is the
+      * top of the map, pixels darker than occupied_threshold*maxval are walls.
+      */
+    bool load_pgm(const std::string& file_name, double resolution,
+                  double origin_x, double origin_y, double occupied_threshold = 0.35)
+    {
+        std::ifstream in(file_name.c_str(), std::ios::in | std::ios::binary);
+        if (!in.is_open())
+            return false;
+
+        std::string magic;
+        in >> magic;
+        if (magic != "P2" && magic != "P5")
+            return false;
+
+        int header[3];
+        for(int i = 0; i < 3; ++i) {
+            skip_comments(in);
+            in >> header[i];
+        }
+        in.get();
+
+        int width = header[0], height = header[1], maxval = header[2];
+        if (!in.good() || width <= 0 || height <= 0 || maxval <= 0 || maxval > 255)
+            return false;
+
+        resize(width, height, resolution, origin_x, origin_y);
+
+        for(int row = 0; row < height; ++row) {
+            for(int col = 0; col < width; ++col) {
+                int value;
+                if (magic == "P5")
+                    value = (unsigned char)in.get();
+                else
+                    in >> value;
+
+                _occupied[(height-1-row)*width + col] = value < occupied_threshold*maxval;
+            }
+        }
+
+        return !in.fail();
+    }
+
+    /**
+      * Loads a map saved by the mapping node (one log odds value per cell,
+      * row by row, 1 cm cells, centered on the origin). The walls are the
+      * cells that mapping itself treats as obstacles.
+      */
+    bool load_mapping(const std::string& file_name, int width, int height, double resolution)
+    {
+        std::ifstream in(file_name.c_str());
+        if (!in.is_open())
+            return false;
+
+        resize(width, height, resolution, -width*resolution/2.0, -height*resolution/2.0);
+
+        for(int i = 0; i < width*height; ++i) {
+            double log_odds;
+            if (!(in >> log_odds))
+                return false;
+            _occupied[i] = log_odds > robot_core::Grid::FREE_OCCUPIED_THRESHOLD;
+        }
+
+        return true;
+    }
+
+    inline bool occupied(int x, int y) const
+    {
+        //outside of the map is solid, so rays and the robot cannot leave it
+        if (x < 0 || y < 0 || x >= _width || y >= _height)
+            return true;
+        return _occupied[y*_width + x] != 0;
+    }
+
+    inline bool occupied_at(double x, double y) const
+    {
+        return occupied(cell_x(x), cell_y(y));
+    }
+
+    /**
+      * True if any cell within radius of (x,y) is occupied.
+      */
+    bool collides(double x, double y, double radius) const
+    {
+        int x0 = cell_x(x - radius), x1 = cell_x(x + radius);
+        int y0 = cell_y(y - radius), y1 = cell_y(y + radius);
+        double sq = radius*radius;
+
+        for(int cy = y0; cy <= y1; ++cy) {
+            for(int cx = x0; cx <= x1; ++cx) {
+                double dx = _origin_x + (cx+0.5)*_resolution - x;
+                double dy = _origin_y + (cy+0.5)*_resolution - y;
+                if (dx*dx + dy*dy <= sq && occupied(cx, cy))
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+      * Distance from (x,y) along the unit direction (dx,dy) to the first
+      * occupied cell, or max_dist if there is none. Cells are traversed in
+      * the order the ray enters them (Amanatides & Woo).
+      */
+    double raycast(double x, double y, double dx, double dy, double max_dist) const
+    {
+        int cx = cell_x(x), cy = cell_y(y);
+        if (occupied(cx, cy))
+            return 0.0;
+
+        int step_x = dx > 0 ? 1 : -1;
+        int step_y = dy > 0 ? 1 : -1;
+
+        double next_x = _origin_x + (cx + (step_x > 0 ? 1 : 0))*_resolution;
+        double next_y = _origin_y + (cy + (step_y > 0 ? 1 : 0))*_resolution;
+
+        double t_max_x = dx != 0 ? (next_x - x)/dx : INFINITY;
+        double t_max_y = dy != 0 ? (next_y - y)/dy : INFINITY;
+        double t_delta_x = dx != 0 ? _resolution/std::fabs(dx) : INFINITY;
+        double t_delta_y = dy != 0 ? _resolution/std::fabs(dy) : INFINITY;
+
+        double t = 0;
+        while (t < max_dist)
+        {
+            if (t_max_x < t_max_y) {
+                t = t_max_x;
+                t_max_x += t_delta_x;
+                cx += step_x;
+            }
+            else {
+                t = t_max_y;
+                t_max_y += t_delta_y;
+                cy += step_y;
+            }
+
+            if (occupied(cx, cy))
+                return std::min(t, max_dist);
+        }
+
+        return max_dist;
+    }
+
+    int width() const { return _width; }
+    int height() const { return _height; }
+    double resolution() const { return _resolution; }
+
+protected:
+
+    void resize(int width, int height, double resolution, double origin_x, double origin_y)
+    {
+        _width = width;
+        _height = height;
+        _resolution = resolution;
+        _origin_x = origin_x;
+        _origin_y = origin_y;
+        _occupied.assign(width*height, 0);
+    }
+
+    static void skip_comments(std::istream& in)
+    {
+        in >> std::ws;
+        while (in.peek() == '#') {
+            std::string line;
+            std::getline(in, line);
+            in >> std::ws;
+        }
+    }
+
+    inline int cell_x(double x) const { return (int)std::floor((x - _origin_x)/_resolution); }
+    inline int cell_y(double y) const { return (int)std::floor((y - _origin_y)/_resolution); }
+
+    int _width, _height;
+    double _resolution;
+    double _origin_x, _origin_y;
+    std::vector<uint8_t> _occupied;
+};
+
+}
+
+#endif // MAZE_SIMULATOR_MAZE_H
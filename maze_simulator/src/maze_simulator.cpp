@@ -0,0 +1,423 @@
+#include <ros/ros.h>
+#include <maze_simulator/maze.h>
+#include <maze_simulator/ir_model.h>
+#include <ras_arduino_msgs/Encoders.h>
+#include <ras_arduino_msgs/ADConverter.h>
+#include <ras_arduino_msgs/PWM.h>
+#include <geometry_msgs/Twist.h>
+#include <sensor_msgs/Imu.h>
+#include <nav_msgs/Odometry.h>
+#include <rosgraph_msgs/Clock.h>
+#include <tf/transform_datatypes.h>
+#include <common/robot.h>
+#include <node_utils/cached_parameter.h>
+#include <node_utils/diagnostics.h>
+#include <boost/random.hpp>
+#include <boost/random/normal_distribution.hpp>
+#include <cmath>
+#include <string>
+
+/**
+  * Stands in for the arduino and the imu on top of a ground truth maze.
+  *
+  * The wheels follow the commanded speeds with a first order lag, either
+  * from /arduino/pwm (the motor controller output) or from
+  * /motor_controller/twist. The robot moves with exact differential drive
+  * kinematics and stops at walls, which also puts an acceleration spike on
+  * the imu. Published at the configured rates:
+  *
+  *   /arduino/encoders   wheel ticks and a millisecond device timestamp
+  *   /arduino/adc        ir readings, raycast in the maze and converted with
+  *                       the inverse of the robot::ir calibration
+  *   /imu/data_raw       gyro z and acceleration with noise and bias
+  *   /simulator/pose     ground truth
+  *
+  * With /use_sim_time the simulator drives /clock and runs speedup times
+  * faster than real time (0 means as fast as possible).
+  *
+  * Usage: maze_simulator maze.pgm | contestMap.map
+  */
+
+//------------------------------------------------------------------------------
+// Members
+
+CachedParameter<double> _speedup("/simulator/speedup",1.0);
+CachedParameter<double> _physics_rate("/simulator/physics_rate",500.0);
+CachedParameter<double> _encoder_rate("/simulator/encoder_rate",50.0);
+CachedParameter<double> _adc_rate("/simulator/adc_rate",50.0);
+CachedParameter<double> _imu_rate("/simulator/imu_rate",125.0);
+CachedParameter<double> _motor_time_constant("/simulator/motor_time_constant",0.1);
+CachedParameter<double> _pwm_gain("/simulator/pwm_gain",0.5/255.0);
+CachedParameter<double> _command_timeout("/simulator/command_timeout",0.5);
+CachedParameter<double> _robot_radius("/simulator/robot_radius",0.11);
+CachedParameter<double> _wheel_noise("/simulator/noise/wheel",0.02);
+CachedParameter<double> _ir_noise("/simulator/noise/ir",0.005);
+CachedParameter<double> _gyro_noise("/simulator/noise/gyro",0.01);
+CachedParameter<double> _gyro_bias("/simulator/noise/gyro_bias",0.005);
+CachedParameter<double> _accel_noise("/simulator/noise/accel",0.05);
+CachedParameter<double> _front_x("/simulator/ir/front_x",0.1);
+CachedParameter<double> _front_y("/simulator/ir/front_y",0.05);
+
+enum Channel { FL_SIDE, FR_SIDE, BL_SIDE, BR_SIDE, L_FRONT, R_FRONT, NUM_CHANNELS };
+
+struct Sensor {
+    double x, y;        //position in the robot frame
+    double dx, dy;      //viewing direction in the robot frame
+    double offset;      //distance from the sensor surface to where it is measured from
+    double max_dist;
+    maze_simulator::IRModel model;
+};
+
+maze_simulator::Maze _maze;
+Sensor _sensors[NUM_CHANNELS];
+
+//ground truth
+double _x, _y, _theta;
+double _v_l, _v_r;          //wheel speeds in m/s
+double _prev_v;
+bool _crashed;
+bool _in_contact;
+
+//simulated time, also when /use_sim_time is off
+ros::Time _now;
+
+//commands
+double _cmd_l, _cmd_r;
+ros::Time _cmd_stamp;
+
+//encoders
+double _ticks_l, _ticks_r;  //fractional ticks since the last message
+int _encoder_l, _encoder_r;
+
+boost::mt19937 _rng;
+boost::normal_distribution<> _normal(0.0, 1.0);
+boost::variate_generator<boost::mt19937&, boost::normal_distribution<> > _noise(_rng, _normal);
+
+ros::Publisher _pub_encoders;
+ros::Publisher _pub_adc;
+ros::Publisher _pub_imu;
+ros::Publisher _pub_pose;
+ros::Publisher _pub_clock;
+
+node_utils::CallbackStats _stats_pwm("maze_simulator/pwm");
+node_utils::CallbackStats _stats_twist("maze_simulator/twist");
+
+//------------------------------------------------------------------------------
+// Callbacks
+
+void callback_pwm(const ras_arduino_msgs::PWMConstPtr& pwm)
+{
+    node_utils::CallbackTimer timer(_stats_pwm);
+    _cmd_l = _pwm_gain()*pwm->PWM1;
+    _cmd_r = _pwm_gain()*pwm->PWM2;
+    _cmd_stamp = _now;
+}
+
+void callback_twist(const geometry_msgs::TwistConstPtr& twist)
+{
+    node_utils::CallbackTimer timer(_stats_twist);
+    double b = robot::dim::wheel_distance;
+    _cmd_l = twist->linear.x - twist->angular.z*b/2.0;
+    _cmd_r = twist->linear.x + twist->angular.z*b/2.0;
+    _cmd_stamp = _now;
+}
+
+//------------------------------------------------------------------------------
+// Methods
+
+void setup_sensors()
+{
+    using namespace robot::ir;
+
+    const double side = 0.3, front = 0.8;
+
+    Sensor* s = _sensors;
+    s[FL_SIDE].x = offset_front_left_forward;   s[FL_SIDE].dy = 1;  s[FL_SIDE].offset = offset_front_left;
+    s[FR_SIDE].x = offset_front_right_forward;  s[FR_SIDE].dy = -1; s[FR_SIDE].offset = offset_front_right;
+    s[BL_SIDE].x = -offset_rear_left_forward;   s[BL_SIDE].dy = 1;  s[BL_SIDE].offset = offset_rear_left;
+    s[BR_SIDE].x = -offset_rear_right_forward;  s[BR_SIDE].dy = -1; s[BR_SIDE].offset = offset_rear_right;
+    for(int i = FL_SIDE; i <= BR_SIDE; ++i) {
+        s[i].y = 0;
+        s[i].dx = 0;
+        s[i].max_dist = side;
+    }
+
+    s[L_FRONT].x = _front_x(); s[L_FRONT].y = _front_y();
+    s[R_FRONT].x = _front_x(); s[R_FRONT].y = -_front_y();
+    for(int i = L_FRONT; i <= R_FRONT; ++i) {
+        s[i].dx = 1;
+        s[i].dy = 0;
+        s[i].offset = 0;
+        s[i].max_dist = front;
+    }
+
+    //same sensor ids as in IRConverter::buildTables
+    s[FL_SIDE].model.build(id_front_left, side);
+    s[FR_SIDE].model.build(id_front_right, side);
+    s[BL_SIDE].model.build(id_front_left, side);
+    s[BR_SIDE].model.build(id_front_right, side);
+    s[L_FRONT].model.build(id_front_long_left, front);
+    s[R_FRONT].model.build(id_front_long_right, front);
+}
+
+/**
+  * Advances the ground truth by dt. Returns true on a collision.
+  */
+bool step(double dt, const ros::Time& now)
+{
+    //commands time out like on the arduino
+    if ((now - _cmd_stamp).toSec() > _command_timeout())
+        _cmd_l = _cmd_r = 0;
+
+    double alpha = dt / (_motor_time_constant() + dt);
+    _v_l += alpha*(_cmd_l - _v_l);
+    _v_r += alpha*(_cmd_r - _v_r);
+
+    //slip and uneven floor show up as noise on the true wheel travel
+    double dl = _v_l*dt*(1.0 + _wheel_noise()*_noise());
+    double dr = _v_r*dt*(1.0 + _wheel_noise()*_noise());
+
+    double b = robot::dim::wheel_distance;
+    double dTheta = (dr - dl)/b;
+    double dist = (dr + dl)/2.0;
+    double half = dTheta/2.0;
+    double chord = std::fabs(half) < 1e-6 ? dist : dist*std::sin(half)/half;
+
+    double x = _x + chord*std::cos(_theta + half);
+    double y = _y + chord*std::sin(_theta + half);
+
+    if (_maze.collides(x, y, _robot_radius())) {
+        _v_l = _v_r = 0;
+        return true;
+    }
+
+    _x = x;
+    _y = y;
+    _theta += dTheta;
+
+    double meter_per_tick = (2.0*M_PI*robot::dim::wheel_radius) / robot::prop::ticks_per_rev;
+    _ticks_l += dl/meter_per_tick;
+    _ticks_r += dr/meter_per_tick;
+
+    return false;
+}
+
+void publish_encoders(const ros::Time& now)
+{
+    int delta_l = (int)_ticks_l;
+    int delta_r = (int)_ticks_r;
+    _ticks_l -= delta_l;
+    _ticks_r -= delta_r;
+    _encoder_l += delta_l;
+    _encoder_r += delta_r;
+
+    //the encoders count against the driving direction, see pose_generator
+    ras_arduino_msgs::EncodersPtr msg(new ras_arduino_msgs::Encoders);
+    msg->encoder1 = -_encoder_l;
+    msg->encoder2 = -_encoder_r;
+    msg->delta_encoder1 = -delta_l;
+    msg->delta_encoder2 = -delta_r;
+    msg->timestamp = (int)(uint32_t)(now.toNSec()/1000000ULL);
+    _pub_encoders.publish(msg);
+}
+
+void publish_adc()
+{
+    int adc[NUM_CHANNELS];
+    double c = std::cos(_theta), s = std::sin(_theta);
+
+    for(int i = 0; i < NUM_CHANNELS; ++i)
+    {
+        const Sensor& sensor = _sensors[i];
+        double x = _x + c*sensor.x - s*sensor.y;
+        double y = _y + s*sensor.x + c*sensor.y;
+        double dx = c*sensor.dx - s*sensor.dy;
+        double dy = s*sensor.dx + c*sensor.dy;
+
+        double dist = _maze.raycast(x, y, dx, dy, sensor.max_dist + sensor.offset) - sensor.offset;
+        dist += _ir_noise()*_noise();
+        adc[i] = sensor.model.adc(dist);
+    }
+
+    ras_arduino_msgs::ADConverterPtr msg(new ras_arduino_msgs::ADConverter);
+    msg->ch1 = adc[FL_SIDE];
+    msg->ch2 = adc[FR_SIDE];
+    msg->ch3 = adc[BL_SIDE];
+    msg->ch4 = adc[BR_SIDE];
+    msg->ch7 = adc[L_FRONT];
+    msg->ch8 = adc[R_FRONT];
+    _pub_adc.publish(msg);
+}
+
+void publish_imu(const ros::Time& now, double dt)
+{
+    double v = (_v_l + _v_r)/2.0;
+    double omega = (_v_r - _v_l)/robot::dim::wheel_distance;
+
+    sensor_msgs::ImuPtr msg(new sensor_msgs::Imu);
+    msg->header.stamp = now;
+    msg->header.frame_id = "imu";
+    msg->angular_velocity.z = omega + _gyro_bias() + _gyro_noise()*_noise();
+    msg->linear_acceleration.x = (v - _prev_v)/dt + _accel_noise()*_noise();
+    msg->linear_acceleration.y = v*omega + _accel_noise()*_noise();
+    msg->linear_acceleration.z = 9.81 + _accel_noise()*_noise();
+    msg->orientation_covariance[0] = -1;
+
+    //an impact shows as a short spike on all axes
+    if (_crashed) {
+        msg->linear_acceleration.x -= 8.0*(_prev_v > 0 ? 1 : -1);
+        msg->linear_acceleration.y += 4.0;
+        msg->linear_acceleration.z += 4.0;
+        _crashed = false;
+    }
+
+    _prev_v = v;
+    _pub_imu.publish(msg);
+}
+
+void publish_pose(const ros::Time& now)
+{
+    nav_msgs::OdometryPtr msg(new nav_msgs::Odometry);
+    msg->header.stamp = now;
+    msg->header.frame_id = "map";
+    msg->child_frame_id = "robot";
+    msg->pose.pose.position.x = _x;
+    msg->pose.pose.position.y = _y;
+    msg->pose.pose.orientation = tf::createQuaternionMsgFromYaw(_theta);
+    msg->twist.twist.linear.x = (_v_l + _v_r)/2.0;
+    msg->twist.twist.angular.z = (_v_r - _v_l)/robot::dim::wheel_distance;
+    _pub_pose.publish(msg);
+}
+
+bool load_maze(const std::string& file_name)
+{
+    bool pgm = file_name.size() > 4 && file_name.compare(file_name.size()-4, 4, ".pgm") == 0;
+
+    double resolution = 0.01, origin_x = 0, origin_y = 0;
+    ros::param::get("/simulator/map/resolution", resolution);
+    ros::param::get("/simulator/map/origin_x", origin_x);
+    ros::param::get("/simulator/map/origin_y", origin_y);
+
+    //the format of mapping's saveToFile, 10x10 m in 1 cm cells
+    if (!pgm)
+        return _maze.load_mapping(file_name, 1000, 1000, 0.01);
+
+    return _maze.load_pgm(file_name, resolution, origin_x, origin_y);
+}
+
+//------------------------------------------------------------------------------
+// Entry point
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "maze_simulator");
+
+    if (argc < 2) {
+        ROS_ERROR("Usage: maze_simulator maze.pgm | contestMap.map");
+        return 1;
+    }
+
+    ros::NodeHandle n;
+    node_utils::start_parameter_updates();
+    node_utils::start_diagnostics();
+
+    if (!load_maze(argv[1])) {
+        ROS_ERROR("[maze_simulator] Could not load maze %s", argv[1]);
+        return 1;
+    }
+
+    int seed = 0;
+    ros::param::get("/simulator/seed", seed);
+    _rng.seed((uint32_t)seed);
+
+    _x = _y = _theta = 0;
+    ros::param::get("/simulator/start_x", _x);
+    ros::param::get("/simulator/start_y", _y);
+    ros::param::get("/simulator/start_theta", _theta);
+
+    if (_maze.collides(_x, _y, _robot_radius()))
+        ROS_ERROR("[maze_simulator] Start pose (%.2lf, %.2lf) is inside a wall", _x, _y);
+
+    _v_l = _v_r = _cmd_l = _cmd_r = 0;
+    _prev_v = 0;
+    _ticks_l = _ticks_r = 0;
+    _encoder_l = _encoder_r = 0;
+    _crashed = false;
+    _in_contact = false;
+
+    setup_sensors();
+
+    bool sim_time = false;
+    ros::param::get("/use_sim_time", sim_time);
+
+    _pub_encoders = n.advertise<ras_arduino_msgs::Encoders>("/arduino/encoders", 10);
+    _pub_adc = n.advertise<ras_arduino_msgs::ADConverter>("/arduino/adc", 10);
+    _pub_imu = n.advertise<sensor_msgs::Imu>("/imu/data_raw", 50);
+    _pub_pose = n.advertise<nav_msgs::Odometry>("/simulator/pose", 10);
+    if (sim_time)
+        _pub_clock = n.advertise<rosgraph_msgs::Clock>("/clock", 10);
+
+    ros::Subscriber sub_pwm = n.subscribe("/arduino/pwm", 10, callback_pwm);
+    ros::Subscriber sub_twist = n.subscribe("/motor_controller/twist", 10, callback_twist);
+
+    //simulated time starts now, in steps of the physics rate
+    ros::WallTime start = ros::WallTime::now();
+    ros::Time& now = _now;
+    now = sim_time ? ros::Time(start.sec, start.nsec) : ros::Time::now();
+    ros::Time next_encoders = now, next_adc = now, next_imu = now, next_pose = now;
+    ros::WallTime wall = start;
+
+    double speedup = sim_time ? _speedup() : 1.0;
+    node_utils::LoopStats step_stats("maze_simulator/step", 1.0/(_physics_rate()*(speedup > 0 ? speedup : 1.0)));
+
+    while (ros::ok())
+    {
+        ros::WallTime step_start = ros::WallTime::now();
+
+        double dt = 1.0/_physics_rate();
+        now += ros::Duration(dt);
+
+        if (sim_time) {
+            rosgraph_msgs::ClockPtr clock(new rosgraph_msgs::Clock);
+            clock->clock = now;
+            _pub_clock.publish(clock);
+        }
+
+        ros::spinOnce();
+
+        //one impact when the robot hits the wall, not one per step while it pushes against it
+        bool contact = step(dt, now);
+        if (contact && !_in_contact)
+            _crashed = true;
+        _in_contact = contact;
+
+        if (now >= next_encoders) {
+            publish_encoders(now);
+            next_encoders += ros::Duration(1.0/_encoder_rate());
+        }
+        if (now >= next_adc) {
+            publish_adc();
+            next_adc += ros::Duration(1.0/_adc_rate());
+        }
+        if (now >= next_imu) {
+            publish_imu(now, 1.0/_imu_rate());
+            next_imu += ros::Duration(1.0/_imu_rate());
+        }
+        if (now >= next_pose) {
+            publish_pose(now);
+            next_pose += ros::Duration(0.1);
+        }
+
+        if (node_utils::diagnostics_active())
+            step_stats.add(step_start, ros::WallTime::now());
+
+        //pace against the wall clock; without sim time the clock is real time
+        speedup = sim_time ? _speedup() : 1.0;
+        if (speedup > 0) {
+            wall += ros::WallDuration(dt/speedup);
+            ros::WallTime::sleepUntil(wall);
+        }
+    }
+
+    return 0;
+}
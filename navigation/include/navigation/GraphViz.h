@@ -3,7 +3,8 @@
 
 #include "Graph.h"
 #include <common/marker_delegate.h>
-#include <sstream>
+#include <cstdio>
+#include <string>
 
 class GraphViz {
 public:
@@ -29,8 +30,13 @@ protected:
         int id_node;
         std::vector<int> edges;
         int id_circle_on, id_circle_merge, id_label;
+
+        //kept between draws so that the text is only rebuilt when it changes
+        std::string label;
     };
 
+    void update_label(MarkerID& marker_id, int value);
+
     void draw_node(int id, bool highlight);
     void adjust_data_size();
 
@@ -90,7 +96,7 @@ void GraphViz::draw()
 void GraphViz::draw_node(int id, bool highlight)
 {
     using namespace navigation_msgs;
-    Node& node = _graph.get_node(id);
+    const robot_core::GraphNode& node = _graph.get_node(id);
     MarkerID& marker_id = _marker_ids.at(id);
 
     static common::Color color_regular(131,178,75);
@@ -122,13 +128,15 @@ void GraphViz::draw_node(int id, bool highlight)
 
     //draw node
     if (node.object_here) {
-        std::string label = static_cast<std::ostringstream*>( &(std::ostringstream() << node.object_type) )->str();
+        update_label(marker_id, node.object_type);
+        const std::string& label = marker_id.label;
         marker_id.id_circle_on = _marker.add_circle(node.x,node.y, 0.00001, _graph.get_dist_thresh()*2.0, color_object.r, color_object.g, color_object.b, 50, marker_id.id_circle_on);
         marker_id.id_circle_merge = _marker.add_circle(node.x,node.y, 0.00001, _graph.get_merge_thresh()*2.0, color_circle_merge.r, color_circle_merge.g, color_circle_merge.b, 50, marker_id.id_circle_merge);
         marker_id.id_label = _marker.add_text(node.x,node.y, scale*2.0f, label, 0,255,0, marker_id.id_label);
     }
     else {
-        std::string label = static_cast<std::ostringstream*>( &(std::ostringstream() << node.id_this) )->str();
+        update_label(marker_id, node.id_this);
+        const std::string& label = marker_id.label;
         marker_id.id_node = _marker.add_cube(node.x,node.y,scale, color_node.r, color_node.g, color_node.b, marker_id.id_node);
         marker_id.id_circle_on = _marker.add_circle(node.x,node.y, 0.00001, _graph.get_dist_thresh()*2.0, color_circle_on.r, color_circle_on.g, color_circle_on.b, 50, marker_id.id_circle_on);
         marker_id.id_circle_merge = _marker.add_circle(node.x,node.y, 0.00001, _graph.get_merge_thresh()*2.0, color_circle_merge.r, color_circle_merge.g, color_circle_merge.b, 50, marker_id.id_circle_merge);
@@ -158,7 +166,7 @@ void GraphViz::draw_node(int id, bool highlight)
                 common::Color& color = (i == Node::OBJECT) ? color_object : color_edge;
 
                 double s = scale;
-                navigation_msgs::Node& next = _graph.get_node(node.edges[i]);
+                const robot_core::GraphNode& next = _graph.get_node(node.edges[i]);
                 marker_id.edges[i] = _marker.add_line(node.x+s*dx,node.y+s*dy, next.x,next.y, line_z, thickness, color.r, color.g, color.b, marker_id.edges[i]);
             }
         }
@@ -167,6 +175,18 @@ void GraphViz::draw_node(int id, bool highlight)
 
 }
 
+/**
+  * Formats the label on the stack and only touches the string if the text
+  * differs, so redrawing an unchanged graph does not allocate.
+  */
+void GraphViz::update_label(MarkerID& marker_id, int value)
+{
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%d", value);
+    if (marker_id.label != buffer)
+        marker_id.label = buffer;
+}
+
 void GraphViz::highlight_node(int id, bool flag)
 {
     adjust_data_size();
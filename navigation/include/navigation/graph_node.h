@@ -0,0 +1,39 @@
+#ifndef NAVIGATION_GRAPH_NODE_H
+#define NAVIGATION_GRAPH_NODE_H
+
+#include <ros/ros.h>
+#include <navigation_msgs/Graph.h>
+#include <node_utils/periodic_executor.h>
+
+/**
+  * Advertises the graph topics and services on the given handle. The graph
+  * is restored from the latest checkpoint if /checkpoint/restore is set;
+  * otherwise with p2 the graph of the first phase is loaded from
+  * /graph/save, or phase 2 starts with an empty graph if restoring was on
+  * and found no checkpoint. Without tf_thread the transform listener is
+  * served by the callbacks of n, which the replay tool needs for a
+  * deterministic order; the transforms are then never waited for.
+  */
+void setup_graph(ros::NodeHandle& n, bool p2, bool tf_thread = true);
+
+/**
+  * Publishes the node the robot is on.
+  */
+void graph_cycle();
+
+/**
+  * Redraws the graph.
+  */
+void graph_draw();
+
+/**
+  * Copies the current graph into msg.
+  */
+void graph_snapshot(navigation_msgs::Graph& msg);
+
+/**
+  * Adds graph_cycle and graph_draw at their rates.
+  */
+void add_graph_tasks(node_utils::PeriodicExecutor& executor);
+
+#endif // NAVIGATION_GRAPH_NODE_H
@@ -5,8 +5,15 @@
 #include <nav_msgs/Odometry.h>
 #include <navigation/Graph.h>
 #include <navigation/GraphViz.h>
+#include <navigation/graph_node.h>
+#include <node_utils/trace.h>
+#include <node_utils/diagnostics.h>
+#include <node_utils/checkpoint.h>
 #include <tf/transform_listener.h>
 #include <tf/transform_datatypes.h>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <boost/thread/mutex.hpp>
 #include <boost/random.hpp>
 #include <boost/random/normal_distribution.hpp>
 #include <algorithm>
@@ -17,10 +24,20 @@
 #define NODE_TRAIT_UNKNOWN 0
 #define NODE_TRAIT_HAS_OBJECT 1
 
+//the graph is shared by the periodic tasks and the callbacks
+boost::mutex _mutex;
+
 geometry_msgs::Point _position;
+ros::Time _pose_stamp;
+uint32_t _pose_trace_id = 0;
+
+node_utils::CallbackStats _odometry_stats("graph/odometry");
+node_utils::CallbackStats _place_node_stats("graph/place_node");
+node_utils::CallbackStats _next_noi_stats("graph/next_node_of_interest");
 Graph _graph;
 boost::shared_ptr<GraphViz> _graph_viz;
-tf::StampedTransform _transform;
+boost::shared_ptr<tf::TransformListener> _tf_listener;
+bool _tf_thread = true;
 
 
 typedef struct GraphPath_t {
@@ -33,26 +50,66 @@ GraphPath _path;
 ros::Publisher _pub_on_node;
 ros::Publisher _pub_save;
 
+bool save_checkpoint(const std::string& file_name);
+bool restore_checkpoint(const std::string& file_name);
+node_utils::CheckpointPart _checkpoint("graph", save_checkpoint, restore_checkpoint);
+
 void callback_odometry(const nav_msgs::OdometryConstPtr& odom) {
 
+    node_utils::CallbackTimer timer(_odometry_stats);
+    boost::mutex::scoped_lock lock(_mutex);
     _position = odom->pose.pose.position;
+    _pose_stamp = odom->header.stamp;
+    _pose_trace_id = node_utils::trace_id(odom->header.stamp);
 }
 
 void callback_save(const std_msgs::EmptyConstPtr& empty) {
+    boost::mutex::scoped_lock lock(_mutex);
     _graph.publish_to_topic(_pub_save);
 }
 
 void callback_load(const navigation_msgs::GraphConstPtr& graph) {
-    ROS_ERROR("Loading graph");
-    _graph.read_from_msg(graph);
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        ROS_INFO("Loading graph");
+        _graph.read_from_msg(graph);
+    }
+    _checkpoint.ready();
+}
+
+bool save_checkpoint(const std::string& file_name)
+{
+    navigation_msgs::Graph msg;
+    graph_snapshot(msg);
+    return node_utils::write_message(file_name, msg);
 }
 
-bool update_transform()
+bool restore_checkpoint(const std::string& file_name)
 {
-    static tf::TransformListener tf_listener;
+    navigation_msgs::GraphPtr msg(new navigation_msgs::Graph);
+    if (!node_utils::read_message(file_name, *msg))
+        return false;
+
+    boost::mutex::scoped_lock lock(_mutex);
+    _graph.read_from_msg(msg);
+    return true;
+}
+
+/**
+  * Without the tf thread the listener is fed by the callbacks of this
+  * thread, which cannot run while waiting, so it only checks.
+  */
+bool update_transform(tf::StampedTransform& transform)
+{
+    if (!_tf_thread && !_tf_listener->canTransform("map", "robot", ros::Time(0))) {
+        ROS_ERROR("[update_transform] No transform from robot to map");
+        return false;
+    }
+
     try {
-        tf_listener.waitForTransform("map", "robot", ros::Time(0), ros::Duration(1.0) );
-        tf_listener.lookupTransform("map", "robot", ros::Time(0), _transform);
+        if (_tf_thread)
+            _tf_listener->waitForTransform("map", "robot", ros::Time(0), ros::Duration(1.0) );
+        _tf_listener->lookupTransform("map", "robot", ros::Time(0), transform);
     } catch (tf::TransformException ex) {
         ROS_ERROR("%s",ex.what());
         return false;
@@ -62,7 +119,8 @@ bool update_transform()
 
 bool robotToMapTransform(float x, float y, float& map_x, float& map_y)
 {
-    if(!update_transform()) return false;
+    tf::StampedTransform transform;
+    if(!update_transform(transform)) return false;
 
     geometry_msgs::PointStamped robot_point_msg;
     robot_point_msg.header.frame_id = "robot";
@@ -72,7 +130,7 @@ bool robotToMapTransform(float x, float y, float& map_x, float& map_y)
     robot_point_msg.point.z = 0.0;
     tf::Stamped<tf::Point> robot_point;
     tf::pointStampedMsgToTF(robot_point_msg, robot_point);
-    tf::Vector3 map_point = _transform*robot_point;
+    tf::Vector3 map_point = transform*robot_point;
 
     map_x = map_point.x();
     map_y = map_point.y();
@@ -83,6 +141,15 @@ bool robotToMapTransform(float x, float y, float& map_x, float& map_y)
 bool service_place_node(navigation_msgs::PlaceNodeRequest& request,
                         navigation_msgs::PlaceNodeResponse& response)
 {
+    node_utils::CallbackTimer timer(_place_node_stats);
+
+    //the transform may wait up to a second for tf, which must not block the
+    //graph for the other callbacks
+    bool object_mapped = request.object_here &&
+        robotToMapTransform(request.object_x,request.object_y, request.object_x,request.object_y);
+
+    boost::mutex::scoped_lock lock(_mutex);
+
     if (request.id_previous == -1 && _graph.num_nodes() > 0) {
         ROS_ERROR("Every node has to have a predecessor (except the first)");
         return false;
@@ -93,15 +160,15 @@ bool service_place_node(navigation_msgs::PlaceNodeRequest& request,
     float x = _position.x;
     float y = _position.y;
 
-    response.generated_node = _graph.place_node(x, y, request);
+    node_to_msg(_graph.place_node(x, y, request), response.generated_node);
     if (request.id_previous >= 0) {
-        navigation_msgs::Node prev_node = _graph.get_node(request.id_previous);
+        const robot_core::GraphNode& prev_node = _graph.get_node(request.id_previous);
         ROS_INFO("Place node. %d(%.2f,%.2f) -> %d(%.2f,%.2f)", request.id_previous, prev_node.x,prev_node.y, response.generated_node.id_this, response.generated_node.x, response.generated_node.y);
     }
 
     if (request.object_here == true) {
 
-        if(robotToMapTransform(request.object_x,request.object_y, request.object_x,request.object_y))
+        if(object_mapped)
         {
             _graph.place_object(response.generated_node.id_this, request);
         }
@@ -265,6 +332,9 @@ void init_path_to_noi(int id_from, int trait) {
 bool service_next_noi(navigation_msgs::NextNodeOfInterestRequest& request,
                       navigation_msgs::NextNodeOfInterestResponse& response)
 {
+    node_utils::CallbackTimer timer(_next_noi_stats);
+    boost::mutex::scoped_lock lock(_mutex);
+
     if ( request.trait == navigation_msgs::NextNodeOfInterestRequest::TRAIT_UNKNOWN_DIR ||
          request.trait == navigation_msgs::NextNodeOfInterestRequest::TRAIT_OBJECT ||
          request.trait == navigation_msgs::NextNodeOfInterestRequest::TRAIT_START ||
@@ -289,10 +359,9 @@ bool service_next_noi(navigation_msgs::NextNodeOfInterestRequest& request,
         init_path_to_noi(request.id_from, request.trait);
         
         response.path.path.clear();
-        response.path.path.clear();
-        response.path.path.reserve(_path.path.size());
+        response.path.path.resize(_path.path.empty() ? 0 : _path.path.size()-1);
         for(int i = 1; i < _path.path.size(); ++i) {
-            response.path.path.push_back(_graph.get_node(_path.path[i]));
+            node_to_msg(_graph.get_node(_path.path[i]), response.path.path[i-1]);
         }
     }
     else {
@@ -369,7 +438,7 @@ void print_graph()
 {
     for(int i = 0; i < _graph.num_nodes(); ++i)
     {
-        navigation_msgs::Node& node = _graph.get_node(i);
+        const robot_core::GraphNode& node = _graph.get_node(i);
         int north = node.edges[navigation_msgs::Node::NORTH];
         int east = node.edges[navigation_msgs::Node::EAST];
         int south = node.edges[navigation_msgs::Node::SOUTH];
@@ -435,34 +504,34 @@ void test2_graph(const std::vector<Point>& points)
 
 void test_graph() {
     navigation_msgs::PlaceNodeRequest place;
-    navigation_msgs::Node node;
+    robot_core::GraphNode node;
 
     test_request(-1,-1, false, false, true, true, place);
     node = _graph.place_node(0,0,place);
 
-    test_request(node.id_this,Graph::East,false,true,true,false,place);
+    test_request(node.id_this,robot_core::Graph::East,false,true,true,false,place);
     node = _graph.place_node(3,0,place);
 
-    test_request(node.id_this,Graph::North,true,true,false,false,place);
+    test_request(node.id_this,robot_core::Graph::North,true,true,false,false,place);
     node = _graph.place_node(3,0.5,place);
 
-    test_request(node.id_this,Graph::West,false,false,true,true,place);
+    test_request(node.id_this,robot_core::Graph::West,false,false,true,true,place);
     node = _graph.place_node(2.5,0.5,place);
 
-    test_request(node.id_this,Graph::North,false,false,false,true,place);
+    test_request(node.id_this,robot_core::Graph::North,false,false,false,true,place);
     node = _graph.place_node(2.5,1.0,place);
 
-    test_request(node.id_this,Graph::North,true,true,false,false,place);
+    test_request(node.id_this,robot_core::Graph::North,true,true,false,false,place);
     place.object_here = true;
     place.object_x = 2.8;
     place.object_y = 1.55;
     node = _graph.place_node(2.5,1.5,place);
     _graph.place_object(node.id_this, place);
 
-    test_request(node.id_this,Graph::West,true,false,false,true,place);
+    test_request(node.id_this,robot_core::Graph::West,true,false,false,true,place);
     node = _graph.place_node(0,1.5,place);
 
-    test_request(node.id_this,Graph::South,false,false,true,true,place);
+    test_request(node.id_this,robot_core::Graph::South,false,false,true,true,place);
     node = _graph.place_node(0,0.1,place);
 
     std::vector<int> path;
@@ -481,7 +550,7 @@ void test_graph() {
 
     std::cout << std::endl;
 
-    test_request(4,Graph::East,false,true,true,false,place);
+    test_request(4,robot_core::Graph::East,false,true,true,false,place);
     place.object_here = true;
     place.object_x = 2.8;
     place.object_y = 1.48;
@@ -489,81 +558,130 @@ void test_graph() {
     _graph.place_object(node.id_this,place);
 }
 
-int main(int argc, char **argv)
-{
-    ros::init(argc, argv, "graph");
+//------------------------------------------------------------------------------
+// Setup
 
-    bool p2 = false;
+ros::Subscriber _sub_odom;
+ros::Subscriber _sub_save;
+ros::Subscriber _sub_graph;
+ros::ServiceServer _srv_place_node;
+ros::ServiceServer _srv_next_noi;
 
-    for (int i = 1; i < argc; ++i) {
-        if (strcmp(argv[i], "p2")==0) {
-            p2 = true;
-            break;
-        }
-    }
+void setup_graph(ros::NodeHandle& n, bool p2, bool tf_thread)
+{
+    node_utils::start_parameter_updates();
+    node_utils::start_trace_export();
+    node_utils::start_diagnostics();
 
-    _path.next = 0;
+    _tf_thread = tf_thread;
+    _tf_listener.reset(new tf::TransformListener(n, ros::Duration(tf::Transformer::DEFAULT_CACHE_TIME), tf_thread));
 
-    ros::NodeHandle n;
+    _path.next = 0;
 
     _pub_on_node = n.advertise<navigation_msgs::Node>("/navigation/graph/on_node",10);
 
     if (!p2)
         _pub_save = n.advertise<navigation_msgs::Graph>("/graph/save",10);
 
-    ros::Subscriber sub_odom = n.subscribe("/pose/odometry",10,callback_odometry);
-    ros::Subscriber sub_save = n.subscribe("/save",10,callback_save);
-    ros::Subscriber sub_graph;
-    if (p2) {
-        sub_graph = n.subscribe("/graph/save",10,callback_load);
-    }
+    _sub_odom = n.subscribe("/pose/odometry",10,callback_odometry);
+    _sub_save = n.subscribe("/save",10,callback_save);
 
-    ros::ServiceServer srv_place_node = n.advertiseService("/navigation/graph/place_node",service_place_node);
-    ros::ServiceServer srv_next_noi = n.advertiseService("/navigation/graph/next_node_of_interest",service_next_noi);
+    //without a checkpoint phase 2 waits for the graph of phase 1 on /graph/save
+    _checkpoint.start(n);
+    if (_checkpoint.restore() || !p2)
+        _checkpoint.ready();
+    else
+        _sub_graph = n.subscribe("/graph/save",10,callback_load);
 
-    navigation_msgs::Node node;
+    //with restore on nothing replays /graph/save (see p2.launch), so waiting would block the brain
+    if (p2 && node_utils::checkpoint_restore_enabled() && _sub_graph) {
+        ROS_WARN("[graph] No checkpoint of the graph, starting phase 2 with an empty graph");
+        _checkpoint.ready();
+    }
+
+    _srv_place_node = n.advertiseService("/navigation/graph/place_node",service_place_node);
+    _srv_next_noi = n.advertiseService("/navigation/graph/next_node_of_interest",service_next_noi);
 
     _graph_viz = boost::shared_ptr<GraphViz>(new GraphViz(_graph, n));
+}
 
-    ros::Rate rate(10.0);
-   ///////test
-//   std::vector<Point> test_points;
-//   test2_graph_build(test_points);
-//   std::vector<int> best_path;
-//   std::cout<<"banana"<<std::endl;
-//    bool save = true;
+void graph_cycle()
+{
+    boost::mutex::scoped_lock lock(_mutex);
 
-    while(n.ok())
-    {
-//       test2_graph(test_points);
+    //the first cycle after a new pose ends its trace
+    node_utils::TraceSpan span("graph/cycle", _pose_trace_id);
 
-        float x = _position.x;
-        float y = _position.y;
+    float x = _position.x;
+    float y = _position.y;
 
-        if (_graph.on_node(x,y, node) || _graph.on_object_node(x,y, node)) {
-            _pub_on_node.publish(node);
-            _graph_viz->highlight_node(node.id_this,true);
-        }
+    navigation_msgs::NodePtr node(new navigation_msgs::Node);
+    if (_graph.on_node(x,y, *node) || _graph.on_object_node(x,y, *node)) {
+        _pub_on_node.publish(node);
+        _graph_viz->highlight_node(node->id_this,true);
+    }
+
+    if (_pose_trace_id != 0) {
+        node_utils::trace_span("pose/end_to_end", _pose_trace_id, _pose_stamp, ros::Time::now());
+        _pose_trace_id = 0;
+    }
+}
+
+void graph_draw()
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    _graph_viz->draw();
+}
+
+void graph_snapshot(navigation_msgs::Graph& msg)
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    _graph.to_msg(msg);
+}
 
-        _graph_viz->draw();
+/**
+  * The node detection runs at 10 Hz, the visualization at 2 Hz with a lower
+  * priority.
+  */
+void add_graph_tasks(node_utils::PeriodicExecutor& executor)
+{
+    executor.add("graph/cycle", 10.0, graph_cycle);
+    executor.add("graph/draw", 2.0, graph_draw, node_utils::PeriodicExecutor::SKIP, -5);
+}
 
-//        if (_test2_i >= test_points.size() && save) {
-//            std_msgs::EmptyConstPtr empty;
-//            callback_save(empty);
-//            save = false;
-//        }
+//------------------------------------------------------------------------------
+// Nodelet
 
-//       if (_test2_i >= test_points.size()) {
-//            best_path=tsp_traverse_all_objects();
-//             for (int i=0; i<best_path.size();++i){
-//             std::cout<<best_path[i]<< "->"<<std::endl;
-//            }
+namespace navigation {
 
-//        }
+class GraphNodelet : public nodelet::Nodelet
+{
+public:
+    virtual void onInit()
+    {
+        bool p2 = false;
+        const std::vector<std::string>& argv = getMyArgv();
+        for(size_t i = 0; i < argv.size(); ++i) {
+            if(argv[i] == "p2")
+                p2 = true;
+        }
 
-        ros::spinOnce();
-        rate.sleep();
+        ros::NodeHandle& n = getNodeHandle();
+        setup_graph(n, p2);
+
+        add_graph_tasks(_executor);
+        _executor.start();
+    }
+
+    virtual ~GraphNodelet()
+    {
+        _executor.stop();
     }
 
-    return 0;
+private:
+    node_utils::PeriodicExecutor _executor;
+};
+
 }
+
+PLUGINLIB_EXPORT_CLASS(navigation::GraphNodelet, nodelet::Nodelet)
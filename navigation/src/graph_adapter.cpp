@@ -0,0 +1,125 @@
+#include <navigation/Graph.h>
+#include <common/robot.h>
+
+void node_to_msg(const robot_core::GraphNode& node, navigation_msgs::Node& msg)
+{
+    msg.id_this = node.id_this;
+    msg.edges = node.edges;
+    msg.object_here = node.object_here;
+    msg.object_type = node.object_type;
+    msg.x = node.x;
+    msg.y = node.y;
+}
+
+void node_from_msg(const navigation_msgs::Node& msg, robot_core::GraphNode& node)
+{
+    node.id_this = msg.id_this;
+    node.edges = msg.edges;
+    node.object_here = msg.object_here;
+    node.object_type = msg.object_type;
+    node.x = msg.x;
+    node.y = msg.y;
+}
+
+Graph::Graph()
+    :_merge_thresh("/navigation/graph/merge_thresh",robot::dim::wheel_distance/1.5)
+    ,_dist_thresh("/navigation/graph/dist_thresh",robot::dim::wheel_distance*0.9)
+    ,_update_positions("/navigation/graph/update_positions",false)
+{
+}
+
+robot_core::Graph& Graph::core()
+{
+    robot_core::Graph::Config config;
+    config.dist_thresh = _dist_thresh();
+    config.merge_thresh = _merge_thresh();
+    config.update_positions = _update_positions();
+    _core.set_config(config);
+    return _core;
+}
+
+static robot_core::Placement placement_from_request(const navigation_msgs::PlaceNodeRequest& request)
+{
+    robot_core::Placement placement;
+    placement.id_previous = request.id_previous;
+    placement.direction = request.direction;
+    placement.north_blocked = request.north_blocked;
+    placement.east_blocked = request.east_blocked;
+    placement.south_blocked = request.south_blocked;
+    placement.west_blocked = request.west_blocked;
+    placement.object_here = request.object_here;
+    placement.object_type = request.object_type;
+    placement.object_x = request.object_x;
+    placement.object_y = request.object_y;
+    return placement;
+}
+
+/**
+  * request.id_previous is updated if the node was attached to another one.
+  */
+const robot_core::GraphNode& Graph::place_node(float x, float y, navigation_msgs::PlaceNodeRequest &request)
+{
+    robot_core::Placement placement = placement_from_request(request);
+    const robot_core::GraphNode& node = core().place_node(x, y, placement);
+    request.id_previous = placement.id_previous;
+    return node;
+}
+
+const robot_core::GraphNode& Graph::place_object(int id_origin, navigation_msgs::PlaceNodeRequest &request)
+{
+    return core().place_object(id_origin, placement_from_request(request));
+}
+
+const robot_core::GraphNode& Graph::get_node(int id)
+{
+    if (id < 0 || id >= _core.num_nodes()) {
+        ROS_ERROR("[Graph::get_node] id: %d out of array bounds",id);
+        return _invalid_node;
+    }
+
+    return _core.get_node(id);
+}
+
+bool Graph::on_node(float x, float y, navigation_msgs::Node &node)
+{
+    robot_core::GraphNode found;
+    if (!core().on_node(x, y, found))
+        return false;
+
+    node_to_msg(found, node);
+    return true;
+}
+
+bool Graph::on_object_node(float x, float y, navigation_msgs::Node& node)
+{
+    robot_core::GraphNode found;
+    if (!core().on_object_node(x, y, found))
+        return false;
+
+    node_to_msg(found, node);
+    return true;
+}
+
+void Graph::publish_to_topic(ros::Publisher& pub)
+{
+    navigation_msgs::Graph graph;
+    to_msg(graph);
+    pub.publish(graph);
+}
+
+void Graph::to_msg(navigation_msgs::Graph& msg)
+{
+    const std::vector<robot_core::GraphNode>& nodes = _core.nodes();
+    msg.nodes.resize(nodes.size());
+    for(int i = 0; i < nodes.size(); ++i)
+        node_to_msg(nodes[i], msg.nodes[i]);
+}
+
+void Graph::read_from_msg(const navigation_msgs::GraphConstPtr& msg)
+{
+    std::vector<robot_core::GraphNode> nodes(msg->nodes.size());
+    for(int i = 0; i < msg->nodes.size(); ++i)
+        node_from_msg(msg->nodes[i], nodes[i]);
+
+    _core.assign(nodes);
+}
@@ -0,0 +1,27 @@
+#include <navigation/graph_node.h>
+#include <cstring>
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "graph");
+
+    bool p2 = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "p2")==0) {
+            p2 = true;
+            break;
+        }
+    }
+
+    ros::NodeHandle n;
+
+    setup_graph(n, p2);
+
+    //node detection and drawing on their own threads, callbacks on the spinner
+    node_utils::PeriodicExecutor executor;
+    add_graph_tasks(executor);
+    executor.spin();
+
+    return 0;
+}
@@ -0,0 +1,158 @@
+#ifndef NODE_UTILS_ALLOCATION_H
+#define NODE_UTILS_ALLOCATION_H
+
+#include <node_utils/diagnostics.h>
+#include <cassert>
+#include <string>
+
+namespace node_utils {
+
+/**
+  * Heap allocations of a thread through operator new (and hence all
+  * containers, strings and messages). Counted by the operator new hooks in
+  * node_utils, which replace the ones of libstdc++ in every executable that
+  * links node_utils. In a nodelet manager node_utils is loaded afterwards, so
+  * there the hooks are not used and nothing is counted, see
+  * allocation_hooks_active().
+  */
+struct AllocationCounts {
+    long count;
+    long bytes;
+
+    AllocationCounts() :count(0), bytes(0) {}
+};
+
+/**
+  * Allocations of the calling thread since it started.
+  */
+AllocationCounts thread_allocations();
+
+/**
+  * True if operator new of this process is the counting one.
+  */
+bool allocation_hooks_active();
+
+/**
+  * Allocations of the calling thread within the lifetime of the scope.
+  */
+class AllocationScope {
+public:
+
+    AllocationScope() :_start(thread_allocations()) {}
+
+    AllocationCounts counts() const
+    {
+        AllocationCounts now = thread_allocations();
+        now.count -= _start.count;
+        now.bytes -= _start.bytes;
+        return now;
+    }
+
+protected:
+
+    AllocationCounts _start;
+};
+
+/**
+  * A code region that must not allocate once it is warm. The first WARM_UP
+  * passes (which fill pools, thread buffers etc.) are not checked. Passes
+  * that do allocate are counted and published on /diagnostics with level
+  * WARN. In debug builds of the code with the region every such pass is
+  * also logged, and with NODE_UTILS_ALLOCATION_ASSERT defined it fails an
+  * assertion (see NoAllocationGuard).
+  */
+class AllocationSite : public DiagnosticsSource {
+public:
+
+    static const long WARM_UP = 16;
+
+    AllocationSite(const std::string& name);
+    virtual ~AllocationSite() { unregister_source(); }
+
+    /**
+      * Counts a pass, returns true if it allocated after the warm up.
+      */
+    bool add(const AllocationCounts& counts);
+
+    /**
+      * Logs an allocating pass, at most once a second.
+      */
+    void report(const AllocationCounts& counts);
+
+    virtual void fill(diagnostic_msgs::DiagnosticStatus& status, double period);
+
+protected:
+
+    long _warm_up;
+    long _passes;
+    long _allocating;
+    long _allocating_total;
+    long _count;
+    long _bytes;
+};
+
+/**
+  * Checks the enclosing scope against an AllocationSite, usually through
+  * NO_ALLOCATION_REGION. Inline, so that the debug checks follow the build
+  * type of the code with the region and not the one of node_utils.
+  */
+class NoAllocationGuard {
+public:
+
+    NoAllocationGuard(AllocationSite& site) :_site(site) {}
+
+    ~NoAllocationGuard()
+    {
+        AllocationCounts counts = _scope.counts();
+        if (!_site.add(counts))
+            return;
+#ifndef NDEBUG
+        _site.report(counts);
+#ifdef NODE_UTILS_ALLOCATION_ASSERT
+        assert(counts.count == 0);
+#endif
+#endif
+    }
+
+protected:
+
+    AllocationSite& _site;
+    AllocationScope _scope;
+};
+
+/**
+  * Lets the enclosing scope allocate, e.g. logging or publishing within a
+  * region that must not allocate otherwise. Its allocations are not
+  * counted for the calling thread.
+  */
+class AllowAllocations {
+public:
+
+    AllowAllocations() {}
+    ~AllowAllocations();
+
+protected:
+
+    AllocationScope _scope;
+};
+
+}
+
+#define NODE_UTILS_ALLOCATION_CONCAT2(a, b) a##b
+#define NODE_UTILS_ALLOCATION_CONCAT(a, b) NODE_UTILS_ALLOCATION_CONCAT2(a, b)
+
+/**
+  * Marks the rest of the enclosing scope as a region that must not allocate:
+  *
+  *   void callback(...)
+  *   {
+  *       NO_ALLOCATION_REGION("mapping/update_grid");
+  *       ...
+  *   }
+  */
+#define NO_ALLOCATION_REGION(name) \
+    static node_utils::AllocationSite NODE_UTILS_ALLOCATION_CONCAT(_allocation_site_, __LINE__)(name); \
+    node_utils::NoAllocationGuard NODE_UTILS_ALLOCATION_CONCAT(_allocation_guard_, __LINE__)( \
+        NODE_UTILS_ALLOCATION_CONCAT(_allocation_site_, __LINE__))
+
+#endif // NODE_UTILS_ALLOCATION_H
@@ -0,0 +1,146 @@
+#ifndef NODE_UTILS_CACHED_PARAMETER_H
+#define NODE_UTILS_CACHED_PARAMETER_H
+
+#include <ros/ros.h>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <string>
+
+namespace node_utils {
+
+/**
+  * Common part of all cached parameters, used by the registry that
+  * refreshes them.
+  */
+class CachedParameterBase {
+public:
+
+    CachedParameterBase(const std::string& name) :_name(name) {}
+    virtual ~CachedParameterBase() {}
+
+    const std::string& name() const { return _name; }
+
+    /**
+      * Reads the value from the parameter server. Keeps the default if the
+      * parameter is not set.
+      */
+    virtual void refresh() = 0;
+
+protected:
+
+    std::string _name;
+};
+
+void register_parameter(CachedParameterBase* parameter);
+void unregister_parameter(CachedParameterBase* parameter);
+
+/**
+  * Loads all registered parameters and starts the background thread that
+  * refreshes them. Has to be called after ros::init; further calls (e.g. from
+  * other nodelets in the same manager) do nothing.
+  *
+  * Parameters are refreshed when a std_msgs/String arrives on
+  * /parameters/update. It holds a parameter name or namespace; an empty
+  * string refreshes everything:
+  *
+  *   rosparam set /perception/imu/accel_th 3.0
+  *   rostopic pub -1 /parameters/update std_msgs/String /perception/imu
+  *
+  * If /parameters/poll_period is greater than zero all parameters are
+  * additionally reloaded with that period.
+  */
+void start_parameter_updates();
+
+/**
+  * Reloads all parameters whose name starts with prefix.
+  */
+void refresh_parameters(const std::string& prefix = "");
+
+}
+
+/**
+  * Drop in replacement for Parameter<T> that keeps the value in the
+  * process. Reading it is a single relaxed atomic load, so it may be called
+  * in callbacks and inner loops. The value is updated by the registry thread
+  * (see node_utils::start_parameter_updates).
+  */
+template<typename T>
+class CachedParameter : public node_utils::CachedParameterBase {
+public:
+
+    CachedParameter(const std::string& name, const T& default_value)
+        :CachedParameterBase(name)
+        ,_default(default_value)
+        ,_value(default_value)
+    {
+        node_utils::register_parameter(this);
+    }
+
+    virtual ~CachedParameter()
+    {
+        node_utils::unregister_parameter(this);
+    }
+
+    inline T operator()() const
+    {
+        return _value.load(boost::memory_order_relaxed);
+    }
+
+    virtual void refresh()
+    {
+        T value;
+        if (!ros::param::get(_name, value))
+            value = _default;
+        _value.store(value, boost::memory_order_relaxed);
+    }
+
+protected:
+
+    T _default;
+    boost::atomic<T> _value;
+};
+
+/**
+  * Strings do not fit into an atomic, they are copied under a lock.
+  */
+template<>
+class CachedParameter<std::string> : public node_utils::CachedParameterBase {
+public:
+
+    CachedParameter(const std::string& name, const std::string& default_value)
+        :CachedParameterBase(name)
+        ,_default(default_value)
+        ,_value(default_value)
+    {
+        node_utils::register_parameter(this);
+    }
+
+    virtual ~CachedParameter()
+    {
+        node_utils::unregister_parameter(this);
+    }
+
+    std::string operator()() const
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _value;
+    }
+
+    virtual void refresh()
+    {
+        std::string value;
+        if (!ros::param::get(_name, value))
+            value = _default;
+
+        boost::mutex::scoped_lock lock(_mutex);
+        _value = value;
+    }
+
+protected:
+
+    std::string _default;
+    std::string _value;
+    mutable boost::mutex _mutex;
+};
+
+#endif // NODE_UTILS_CACHED_PARAMETER_H
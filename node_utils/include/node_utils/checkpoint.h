@@ -0,0 +1,142 @@
+#ifndef NODE_UTILS_CHECKPOINT_H
+#define NODE_UTILS_CHECKPOINT_H
+
+#include <ros/ros.h>
+#include <ros/serialization.h>
+#include <std_msgs/String.h>
+#include <boost/function.hpp>
+#include <string>
+#include <vector>
+
+namespace node_utils {
+
+/**
+  * Checkpoints of the whole system in one versioned bundle, so that a
+  * restarted node (or phase 2) continues where the last one stopped instead
+  * of rebuilding its state.
+  *
+  *   /save                std_msgs/Empty, starts a checkpoint (as before)
+  *   /checkpoint/save     std_msgs/String, the bundle directory the
+  *                        coordinator (node_utils/checkpoint) picked
+  *   /checkpoint/written  std_msgs/String "<part> <bundle> ok|failed"
+  *   /checkpoint/ready    std_msgs/String, latched, the parts of a process
+  *                        that are warm, separated by spaces
+  *
+  * Every part writes <bundle>/<part>. Once all parts of /checkpoint/parts
+  * answered, the coordinator writes <bundle>/manifest and points
+  * <dir>/latest at the bundle, so latest is always complete. With
+  * /checkpoint/restore set the parts load <dir>/latest/<part> at startup.
+  *
+  *   /checkpoint/dir           default $ROS_HOME/checkpoints
+  *   /checkpoint/parts         e.g. [map, graph, pose]
+  *   /checkpoint/restore       default false
+  *   /checkpoint/restore_pose  default true, false keeps only the wheel
+  *                             calibration of the pose part
+  *
+  * The version is bumped whenever the layout of a bundle changes. Each
+  * part file also carries the md5 sum of its message type.
+  */
+const int CHECKPOINT_VERSION = 1;
+
+std::string checkpoint_dir();
+
+/**
+  * Whether /checkpoint/restore is set.
+  */
+bool checkpoint_restore_enabled();
+
+/**
+  * Directory of the bundle that is restored, empty if restoring is off or
+  * there is no complete bundle of this version. latest is resolved on the
+  * first call only, so all parts of a process restore the same bundle even
+  * if a checkpoint completes in between.
+  */
+std::string checkpoint_restore_bundle();
+
+bool write_checkpoint_file(const std::string& file_name, const std::string& md5sum,
+                           const std::vector<uint8_t>& data);
+bool read_checkpoint_file(const std::string& file_name, const std::string& md5sum,
+                          std::vector<uint8_t>& data);
+
+/**
+  * Writes msg to file_name, atomically by renaming a temporary file.
+  */
+template<class M>
+bool write_message(const std::string& file_name, const M& msg)
+{
+    uint32_t size = ros::serialization::serializationLength(msg);
+    std::vector<uint8_t> buffer(size);
+    ros::serialization::OStream stream(buffer.empty() ? NULL : &buffer[0], size);
+    ros::serialization::serialize(stream, msg);
+    return write_checkpoint_file(file_name, ros::message_traits::md5sum<M>(), buffer);
+}
+
+/**
+  * Reads msg from file_name. Fails if the file is missing, truncated or
+  * holds a different message type (or version of it).
+  */
+template<class M>
+bool read_message(const std::string& file_name, M& msg)
+{
+    std::vector<uint8_t> buffer;
+    if (!read_checkpoint_file(file_name, ros::message_traits::md5sum<M>(), buffer))
+        return false;
+
+    try {
+        ros::serialization::IStream stream(buffer.empty() ? NULL : &buffer[0], buffer.size());
+        ros::serialization::deserialize(stream, msg);
+    } catch (ros::serialization::StreamOverrunException& ex) {
+        ROS_ERROR("[checkpoint] %s is truncated: %s", file_name.c_str(), ex.what());
+        return false;
+    }
+    return true;
+}
+
+/**
+  * The part of a node in the checkpoint. save and restore get the file of
+  * the part and are called on the queue of the handle passed to start, so
+  * they have to lock what the node shares with other threads.
+  */
+class CheckpointPart {
+public:
+
+    typedef boost::function<bool (const std::string& file_name)> Handler;
+
+    CheckpointPart(const std::string& name, const Handler& save, const Handler& restore)
+        :_name(name)
+        ,_save(save)
+        ,_restore(restore)
+    {}
+
+    void start(ros::NodeHandle& handle);
+
+    /**
+      * Loads the part from checkpoint_restore_bundle() if
+      * /checkpoint/restore is set. Returns true if it did.
+      */
+    bool restore();
+
+    /**
+      * Loads the part from bundle, unless it is empty.
+      */
+    bool restore(const std::string& bundle);
+
+    /**
+      * Announces on /checkpoint/ready that the part is warm.
+      */
+    void ready();
+
+protected:
+
+    void callback_save(const std_msgs::StringConstPtr& bundle);
+
+    std::string _name;
+    Handler _save;
+    Handler _restore;
+    ros::Subscriber _sub_save;
+    ros::Publisher _pub_written;
+};
+
+}
+
+#endif // NODE_UTILS_CHECKPOINT_H
@@ -0,0 +1,216 @@
+#ifndef NODE_UTILS_DIAGNOSTICS_H
+#define NODE_UTILS_DIAGNOSTICS_H
+
+#include <ros/ros.h>
+#include <diagnostic_msgs/DiagnosticStatus.h>
+#include <boost/thread/mutex.hpp>
+#include <string>
+
+namespace node_utils {
+
+/**
+  * Histogram of durations in power of two bins of microseconds, so adding
+  * a sample is constant time and memory over 1 us ... 8 s.
+  */
+class DurationHistogram {
+public:
+
+    static const int NUM_BINS = 24;
+
+    DurationHistogram() { reset(); }
+
+    void add(double seconds);
+
+    /**
+      * Duration in seconds below which the given fraction of samples lies
+      * (upper edge of the bin).
+      */
+    double percentile(double fraction) const;
+
+    long count() const { return _count; }
+    double mean() const { return _count > 0 ? _sum/_count : 0.0; }
+    double max() const { return _max; }
+
+    void reset();
+
+protected:
+
+    long _bins[NUM_BINS];
+    long _count;
+    double _sum;
+    double _max;
+};
+
+/**
+  * A statistic that is published on /diagnostics. fill is called from the
+  * diagnostics thread, so the subclasses register once they are complete
+  * and unregister before they are torn down.
+  */
+class DiagnosticsSource {
+public:
+
+    DiagnosticsSource(const std::string& name) :_name(name) {}
+    virtual ~DiagnosticsSource() {}
+
+    const std::string& name() const { return _name; }
+
+    /**
+      * Writes the statistics since the last call into status and restarts
+      * them. period is the time in seconds since the last call.
+      */
+    virtual void fill(diagnostic_msgs::DiagnosticStatus& status, double period) = 0;
+
+    /**
+      * Called every period of /diagnostics, also while nobody listens, for
+      * sources that have to act when a period ends.
+      */
+    virtual void flush() {}
+
+protected:
+
+    void register_source();
+    void unregister_source();
+
+    std::string _name;
+    boost::mutex _mutex;
+};
+
+/**
+  * Appends value, printed with format, to the values of status.
+  */
+void add_value(diagnostic_msgs::DiagnosticStatus& status, const char* key, const char* format, double value);
+
+/**
+  * Execution time of a callback. If the receipt time of the message is
+  * known, also the time it waited in the subscriber queue; by Little's law
+  * the mean queue depth is the arrival rate times the mean wait.
+  */
+class CallbackStats : public DiagnosticsSource {
+public:
+
+    CallbackStats(const std::string& name) :DiagnosticsSource(name) { register_source(); }
+    virtual ~CallbackStats() { unregister_source(); }
+
+    void add(double duration, double queue_wait = -1.0);
+
+    virtual void fill(diagnostic_msgs::DiagnosticStatus& status, double period);
+
+protected:
+
+    DurationHistogram _duration;
+    DurationHistogram _queue_wait;
+};
+
+/**
+  * Period jitter and overruns of a loop that should run with a fixed
+  * period. A cycle overruns if it takes longer than the period; a scheduler
+  * may additionally report release times it had to drop or delay.
+  */
+class LoopStats : public DiagnosticsSource {
+public:
+
+    LoopStats(const std::string& name, double period)
+        :DiagnosticsSource(name)
+        ,_period(period)
+        ,_overruns(0)
+        ,_overruns_total(0)
+        ,_missed(0)
+        ,_missed_total(0)
+    {
+        register_source();
+    }
+
+    virtual ~LoopStats() { unregister_source(); }
+
+    void add(const ros::WallTime& start, const ros::WallTime& end);
+    void add_missed(long missed);
+
+    virtual void fill(diagnostic_msgs::DiagnosticStatus& status, double period);
+
+protected:
+
+    double _period;
+    ros::WallTime _last_start;
+    DurationHistogram _duration;
+    DurationHistogram _jitter;
+    long _overruns;
+    long _overruns_total;
+    long _missed;
+    long _missed_total;
+};
+
+/**
+  * Starts the diagnostics thread, which publishes all sources of the process
+  * every /diagnostics/period seconds (wall time) as a
+  * diagnostic_msgs/DiagnosticArray on /diagnostics. Has to be called after
+  * ros::init; further calls do nothing.
+  */
+void start_diagnostics();
+
+/**
+  * True while /diagnostics has subscribers. Nothing is measured otherwise.
+  */
+bool diagnostics_active();
+
+/**
+  * Adds the execution time of the enclosing scope to a CallbackStats.
+  */
+class CallbackTimer {
+public:
+
+    CallbackTimer(CallbackStats& stats, const ros::Time& receipt = ros::Time())
+        :_stats(stats)
+        ,_active(diagnostics_active())
+        ,_queue_wait(-1.0)
+    {
+        if (!_active)
+            return;
+        _start = ros::WallTime::now();
+        if (!receipt.isZero())
+            _queue_wait = (ros::Time::now() - receipt).toSec();
+    }
+
+    ~CallbackTimer()
+    {
+        if (_active)
+            _stats.add((ros::WallTime::now() - _start).toSec(), _queue_wait);
+    }
+
+protected:
+
+    CallbackStats& _stats;
+    bool _active;
+    double _queue_wait;
+    ros::WallTime _start;
+};
+
+/**
+  * Adds one cycle of the enclosing scope to a LoopStats.
+  */
+class LoopTimer {
+public:
+
+    LoopTimer(LoopStats& stats)
+        :_stats(stats)
+        ,_active(diagnostics_active())
+    {
+        if (_active)
+            _start = ros::WallTime::now();
+    }
+
+    ~LoopTimer()
+    {
+        if (_active)
+            _stats.add(_start, ros::WallTime::now());
+    }
+
+protected:
+
+    LoopStats& _stats;
+    bool _active;
+    ros::WallTime _start;
+};
+
+}
+
+#endif // NODE_UTILS_DIAGNOSTICS_H
@@ -0,0 +1,91 @@
+#ifndef NODE_UTILS_LOG_LIMIT_H
+#define NODE_UTILS_LOG_LIMIT_H
+
+#include <node_utils/diagnostics.h>
+#include <node_utils/allocation.h>
+#include <string>
+
+namespace node_utils {
+
+/**
+  * Rate limit of a log message that can fire in an inner loop, e.g. for
+  * every cell of a ray. Events take a token from a bucket that refills with
+  * rate tokens per second up to burst; events without a token are only
+  * counted. The next message that is logged is followed by a summary of how
+  * many were dropped since the last one:
+  *
+  *   [mapping/out_of_bounds] 312 more in the last 1.0 s
+  *
+  * If no message is logged for a token period after the drops, e.g. because
+  * the events stopped, the summary is logged on its own with the timer of
+  * /diagnostics, at the level of the last event.
+  *
+  * The counts are also published on /diagnostics. Several log statements
+  * may share one site, then they share the budget and the counts.
+  */
+class LogSite : public DiagnosticsSource {
+public:
+
+    struct Summary {
+        long suppressed;
+        double period;
+
+        Summary() :suppressed(0), period(0) {}
+    };
+
+    LogSite(const std::string& name, double rate = 1.0, double burst = 3.0);
+    virtual ~LogSite() { unregister_source(); }
+
+    /**
+      * Counts one event at level and returns true if it may be logged.
+      * summary then holds the events dropped since the last summary.
+      */
+    bool hit(ros::console::levels::Level level, Summary& summary);
+
+    virtual void fill(diagnostic_msgs::DiagnosticStatus& status, double period);
+    virtual void flush();
+
+protected:
+
+    void take_summary(const ros::WallTime& now, Summary& summary);
+
+    double _rate;
+    double _burst;
+    double _tokens;
+    ros::WallTime _last_refill;
+    ros::WallTime _last_logged;
+    long _suppressed;
+    ros::console::levels::Level _level;
+
+    long _events;
+    long _events_total;
+    long _dropped;
+};
+
+}
+
+/**
+  * Logs through a LogSite with the given rosconsole level:
+  *
+  *   LOG_ERROR_LIMITED(_out_of_bounds_log, "[Mapping::markCellOccupied] Cell (%d, %d) out of bounds", x, y);
+  *
+  * Dropped events cost a lock and a clock read. Logging allocates, so it is
+  * allowed within a NO_ALLOCATION_REGION.
+  */
+#define NODE_UTILS_LOG_LIMITED(level, site, ...) \
+    do { \
+        node_utils::LogSite::Summary _log_summary; \
+        if ((site).hit(level, _log_summary)) { \
+            node_utils::AllowAllocations _log_allow; \
+            ROS_LOG(level, ROSCONSOLE_DEFAULT_NAME, __VA_ARGS__); \
+            if (_log_summary.suppressed > 0) \
+                ROS_LOG(level, ROSCONSOLE_DEFAULT_NAME, "[%s] %ld more in the last %.1f s", \
+                        (site).name().c_str(), _log_summary.suppressed, _log_summary.period); \
+        } \
+    } while (0)
+
+#define LOG_ERROR_LIMITED(site, ...) NODE_UTILS_LOG_LIMITED(::ros::console::levels::Error, site, __VA_ARGS__)
+#define LOG_WARN_LIMITED(site, ...) NODE_UTILS_LOG_LIMITED(::ros::console::levels::Warn, site, __VA_ARGS__)
+#define LOG_INFO_LIMITED(site, ...) NODE_UTILS_LOG_LIMITED(::ros::console::levels::Info, site, __VA_ARGS__)
+
+#endif // NODE_UTILS_LOG_LIMIT_H
@@ -0,0 +1,109 @@
+#ifndef NODE_UTILS_MESSAGE_POOL_H
+#define NODE_UTILS_MESSAGE_POOL_H
+
+#include <ros/ros.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <string>
+#include <vector>
+
+namespace node_utils {
+
+/**
+  * Recycles messages for a publisher so that their vectors and strings keep
+  * their capacity and publishing does not allocate once the pool is warm.
+  *
+  * A message is handed out again once no one but the pool references it,
+  * i.e. roscpp has serialized it and every subscriber in the process has
+  * let go of it. acquire() returns it as its last user left it, so the
+  * caller has to set every field it publishes.
+  *
+  * If all messages are in use the pool grows up to max_size; beyond that
+  * it hands out messages that are not recycled.
+  */
+template <class M>
+class MessagePool {
+public:
+
+    typedef boost::shared_ptr<M> Ptr;
+
+    MessagePool(size_t size = 4, size_t max_size = 32)
+        :_max_size(max_size)
+        ,_next(0)
+    {
+        _messages.reserve(max_size);
+        for(size_t i = 0; i < size; ++i)
+            _messages.push_back(Ptr(new M));
+    }
+
+    Ptr acquire()
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+
+        for(size_t k = 0; k < _messages.size(); ++k) {
+            size_t i = (_next + k) % _messages.size();
+            if (_messages[i].unique()) {
+                _next = (i + 1) % _messages.size();
+                return _messages[i];
+            }
+        }
+
+        Ptr msg(new M);
+        if (_messages.size() < _max_size)
+            _messages.push_back(msg);
+        else
+            ROS_WARN_THROTTLE(10.0, "[MessagePool] All %lu messages in use, allocating", _messages.size());
+        return msg;
+    }
+
+    size_t size() const { return _messages.size(); }
+
+protected:
+
+    size_t _max_size;
+    size_t _next;
+    std::vector<Ptr> _messages;
+    boost::mutex _mutex;
+};
+
+/**
+  * A publisher with its own message pool:
+  *
+  *   PooledPublisher<ir_converter::Distance> pub;
+  *   pub.advertise(handle, "/perception/ir/distance", 10);
+  *   ir_converter::DistancePtr msg = pub.next();
+  *   msg->... = ...;
+  *   pub.publish(msg);
+  */
+template <class M>
+class PooledPublisher {
+public:
+
+    typedef boost::shared_ptr<M> Ptr;
+
+    PooledPublisher(size_t size = 4, size_t max_size = 32)
+        :_pool(size, max_size)
+    {}
+
+    void advertise(ros::NodeHandle& handle, const std::string& topic, uint32_t queue_size, bool latch = false)
+    {
+        _pub = handle.advertise<M>(topic, queue_size, latch);
+    }
+
+    Ptr next() { return _pool.acquire(); }
+
+    void publish(const Ptr& msg) const { _pub.publish(msg); }
+
+    uint32_t getNumSubscribers() const { return _pub.getNumSubscribers(); }
+
+    ros::Publisher& publisher() { return _pub; }
+
+protected:
+
+    ros::Publisher _pub;
+    MessagePool<M> _pool;
+};
+
+}
+
+#endif // NODE_UTILS_MESSAGE_POOL_H
@@ -0,0 +1,89 @@
+#ifndef NODE_UTILS_PERIODIC_EXECUTOR_H
+#define NODE_UTILS_PERIODIC_EXECUTOR_H
+
+#include <ros/ros.h>
+#include <node_utils/diagnostics.h>
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <string>
+#include <vector>
+
+namespace node_utils {
+
+/**
+  * Runs periodic tasks at fixed rates, each on its own thread.
+  *
+  * Release times are start + k*period in ros time (so sim time works as
+  * well), hence the rate does not drift with the execution time of the task.
+  * If a task overruns and misses release times:
+  *   SKIP      the task runs once at once and then continues on the grid,
+  *             the missed releases are dropped
+  *   CATCH_UP  the missed releases run back to back, at most
+  *             MAX_CATCH_UP of them, the rest is dropped
+  * Missed releases are counted as deadline misses in the diagnostics of the
+  * task (a LoopStats with the name of the task).
+  *
+  * priority is relative to the other threads of the process: negative values
+  * lower it (nice), positive values raise it and need the privilege to.
+  *
+  * The tasks of one executor share nothing but the state they touch, so that
+  * state has to be locked against the tasks and the callbacks.
+  */
+class PeriodicExecutor {
+public:
+
+    enum OverrunPolicy {
+        SKIP,
+        CATCH_UP
+    };
+
+    typedef boost::function<void ()> Task;
+
+    static const int MAX_CATCH_UP = 5;
+
+    PeriodicExecutor() :_running(false) {}
+    ~PeriodicExecutor() { stop(); }
+
+    void add(const std::string& name, double rate, const Task& task,
+             OverrunPolicy policy = SKIP, int priority = 0);
+
+    /**
+      * Starts one thread per task.
+      */
+    void start();
+
+    /**
+      * Stops and joins the task threads. A task that is running is finished.
+      */
+    void stop();
+
+    /**
+      * Starts the tasks, serves the global callback queue with
+      * spinner_threads threads and blocks until shutdown.
+      */
+    void spin(int spinner_threads = 1);
+
+protected:
+
+    struct Entry {
+        std::string name;
+        double period;
+        Task task;
+        OverrunPolicy policy;
+        int priority;
+        boost::shared_ptr<LoopStats> stats;
+    };
+
+    void run(Entry* entry);
+    bool sleep_until(const ros::Time& time);
+
+    std::vector<boost::shared_ptr<Entry> > _entries;
+    boost::thread_group _threads;
+    boost::atomic<bool> _running;
+};
+
+}
+
+#endif // NODE_UTILS_PERIODIC_EXECUTOR_H
@@ -0,0 +1,96 @@
+#ifndef NODE_UTILS_REALTIME_H
+#define NODE_UTILS_REALTIME_H
+
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <boost/atomic.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <string>
+#include <vector>
+
+namespace node_utils {
+
+/**
+  * Opt-in real-time scheduling of the callback thread of a node. Read from
+  * the private namespace of the node (or nodelet):
+  *
+  *   realtime/enabled         false
+  *   realtime/priority        SCHED_FIFO priority 1..99, default 80
+  *   realtime/cpus            cpus the thread may run on, e.g. [3], default all
+  *   realtime/lock_memory     mlockall the process, default true
+  *   realtime/stack_prefault  bytes of stack touched up front, default 256 kB
+  *   realtime/heap_reserve    bytes of heap touched and kept, default 8 MB
+  *
+  * SCHED_FIFO needs CAP_SYS_NICE or an rtprio limit, locking memory
+  * CAP_IPC_LOCK or a memlock limit (see /etc/security/limits.conf). Whatever
+  * is not granted is reported and the node runs on without it.
+  */
+struct RealtimeProfile {
+    bool enabled;
+    int priority;
+    std::vector<int> cpus;
+    bool lock_memory;
+    int stack_prefault;
+    int heap_reserve;
+
+    RealtimeProfile();
+
+    void load(const ros::NodeHandle& private_handle);
+};
+
+/**
+  * Locks the memory of the process and reserves the heap. Only the first
+  * call of a process does anything. Returns false if not everything was
+  * granted.
+  */
+bool setup_realtime_process(const RealtimeProfile& profile);
+
+/**
+  * Applies priority, affinity and stack prefaulting to the calling thread.
+  * Returns false if not everything was granted.
+  */
+bool setup_realtime_thread(const RealtimeProfile& profile, const std::string& name);
+
+/**
+  * For the main of a standalone node that spins on the main thread: loads
+  * the profile from ~realtime and applies it to the process and the calling
+  * thread if it is enabled.
+  */
+void setup_realtime_main(const std::string& name);
+
+/**
+  * Serves a callback queue on its own thread with a real-time profile. A
+  * nodelet subscribes through a handle on queue() to get its callbacks off
+  * the thread pool of the manager.
+  */
+class RealtimeSpinner {
+public:
+
+    RealtimeSpinner(const RealtimeProfile& profile, const std::string& name)
+        :_profile(profile)
+        ,_name(name)
+        ,_running(false)
+    {}
+
+    ~RealtimeSpinner() { stop(); }
+
+    ros::CallbackQueue* queue() { return &_queue; }
+
+    void start();
+    void stop();
+
+protected:
+
+    void run();
+
+    RealtimeProfile _profile;
+    std::string _name;
+    ros::CallbackQueue _queue;
+    boost::scoped_ptr<boost::thread> _thread;
+    boost::atomic<bool> _running;
+};
+
+}
+
+#endif // NODE_UTILS_REALTIME_H
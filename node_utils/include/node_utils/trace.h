@@ -0,0 +1,97 @@
+#ifndef NODE_UTILS_TRACE_H
+#define NODE_UTILS_TRACE_H
+
+#include <ros/ros.h>
+#include <stdint.h>
+#include <string>
+
+/**
+  * Low overhead latency tracing.
+  *
+  * A span is a named interval of ros time that belongs to a trace, i.e. to
+  * one sensor reading on its way through the nodes. The trace id is derived
+  * from the sensor stamp of the reading, which the messages derived from it
+  * pass on in header.stamp, so every node computes the same id. (header.seq
+  * can not carry it, roscpp overwrites it with a counter of the publisher.)
+  * Every thread writes its spans into its own ring buffer without locking;
+  * the last TRACE_CAPACITY spans per thread are kept.
+  *
+  * Tracing is off unless /trace/enabled is true, then recording a span costs
+  * two clock reads and a copy. The buffers of a process are written as
+  * Chrome trace JSON (chrome://tracing, ui.perfetto.dev) when a directory name
+  * arrives on /trace/dump:
+  *
+  *   rosparam set /trace/enabled true
+  *   rostopic pub -1 /parameters/update std_msgs/String /trace
+  *   rostopic pub -1 /trace/dump std_msgs/String /tmp
+  *
+  * Spans of one trace are connected by flow arrows, and count, p50, p99 and
+  * max per span name are logged and stored under otherData in the file.
+  */
+
+namespace node_utils {
+
+const int TRACE_CAPACITY = 4096;
+
+bool tracing_enabled();
+
+/**
+  * Id of the trace of the reading with the sensor stamp stamp, never 0.
+  */
+uint32_t trace_id(const ros::Time& stamp);
+
+/**
+  * Records a span. name has to be a string literal (only the pointer is kept).
+  */
+void trace_span(const char* name, uint32_t trace_id, const ros::Time& begin, const ros::Time& end);
+
+/**
+  * Writes the spans of all threads of this process as Chrome trace JSON.
+  */
+bool write_trace(const std::string& file_name);
+
+/**
+  * Subscribes to /trace/dump. Has to be called after ros::init; further calls
+  * do nothing.
+  */
+void start_trace_export();
+
+/**
+  * Records the span from construction to destruction.
+  */
+class TraceSpan {
+public:
+
+    TraceSpan(const char* name, uint32_t trace_id = 0)
+        :_name(name)
+        ,_trace_id(trace_id)
+        ,_enabled(tracing_enabled())
+    {
+        if (_enabled)
+            _begin = ros::Time::now();
+    }
+
+    ~TraceSpan()
+    {
+        if (_enabled)
+            trace_span(_name, _trace_id, _begin, ros::Time::now());
+    }
+
+    /**
+      * For spans whose trace is only known once they have started.
+      */
+    void set_trace_id(uint32_t trace_id) { _trace_id = trace_id; }
+
+    const ros::Time& begin() const { return _begin; }
+
+protected:
+
+    const char* _name;
+    uint32_t _trace_id;
+    bool _enabled;
+    ros::Time _begin;
+};
+
+}
+
+#endif // NODE_UTILS_TRACE_H
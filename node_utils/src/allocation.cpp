@@ -0,0 +1,199 @@
+#include <node_utils/allocation.h>
+#include <cstdlib>
+#include <new>
+
+//------------------------------------------------------------------------------
+// Members
+
+namespace {
+
+/**
+  * Plain data, so that it needs no constructor and can be used from
+  * operator new at any time, also before main and while a thread starts.
+  */
+struct ThreadCounts {
+    long count;
+    long bytes;
+};
+
+__thread ThreadCounts _thread_counts;
+
+inline void* counted_malloc(std::size_t size)
+{
+    ++_thread_counts.count;
+    _thread_counts.bytes += (long)size;
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+}
+
+//------------------------------------------------------------------------------
+// Hooks
+
+//dynamic exception specifications are deprecated in C++11 and an error in C++17
+#if __cplusplus >= 201103L
+#define NODE_UTILS_THROW_BAD_ALLOC
+#define NODE_UTILS_NOEXCEPT noexcept
+#else
+#define NODE_UTILS_THROW_BAD_ALLOC throw(std::bad_alloc)
+#define NODE_UTILS_NOEXCEPT throw()
+#endif
+
+void* operator new(std::size_t size) NODE_UTILS_THROW_BAD_ALLOC
+{
+    void* p = counted_malloc(size);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size) NODE_UTILS_THROW_BAD_ALLOC
+{
+    void* p = counted_malloc(size);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) NODE_UTILS_NOEXCEPT
+{
+    return counted_malloc(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) NODE_UTILS_NOEXCEPT
+{
+    return counted_malloc(size);
+}
+
+void operator delete(void* p) NODE_UTILS_NOEXCEPT
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) NODE_UTILS_NOEXCEPT
+{
+    std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) NODE_UTILS_NOEXCEPT
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) NODE_UTILS_NOEXCEPT
+{
+    std::free(p);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void* p, std::size_t) NODE_UTILS_NOEXCEPT
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) NODE_UTILS_NOEXCEPT
+{
+    std::free(p);
+}
+#endif
+
+namespace node_utils {
+
+//------------------------------------------------------------------------------
+// Methods
+
+AllocationCounts thread_allocations()
+{
+    AllocationCounts counts;
+    counts.count = _thread_counts.count;
+    counts.bytes = _thread_counts.bytes;
+    return counts;
+}
+
+bool allocation_hooks_active()
+{
+    static bool active = false;
+    static bool checked = false;
+    if (!checked) {
+        long before = _thread_counts.count;
+        //volatile, so that the compiler can not drop the pair
+        char* volatile probe = new char;
+        delete probe;
+        active = _thread_counts.count != before;
+        checked = true;
+
+        if (!active)
+            ROS_WARN("[allocation] operator new is not the counting one (loaded into a nodelet manager?), "
+                     "allocations are not checked");
+    }
+    return active;
+}
+
+AllowAllocations::~AllowAllocations()
+{
+    AllocationCounts counts = _scope.counts();
+    _thread_counts.count -= counts.count;
+    _thread_counts.bytes -= counts.bytes;
+}
+
+AllocationSite::AllocationSite(const std::string& name)
+    :DiagnosticsSource("allocations " + name)
+    ,_warm_up(0)
+    ,_passes(0)
+    ,_allocating(0)
+    ,_allocating_total(0)
+    ,_count(0)
+    ,_bytes(0)
+{
+    allocation_hooks_active();
+    register_source();
+}
+
+bool AllocationSite::add(const AllocationCounts& counts)
+{
+    boost::mutex::scoped_lock lock(_mutex);
+
+    ++_passes;
+    if (_warm_up < WARM_UP) {
+        ++_warm_up;
+        return false;
+    }
+    if (counts.count == 0)
+        return false;
+
+    ++_allocating;
+    ++_allocating_total;
+    _count += counts.count;
+    _bytes += counts.bytes;
+    return true;
+}
+
+void AllocationSite::report(const AllocationCounts& counts)
+{
+    AllowAllocations allow;
+    ROS_ERROR_THROTTLE(1.0, "[allocation] %s allocated %ld times (%ld bytes) in a region that must not allocate",
+                       _name.c_str(), counts.count, counts.bytes);
+}
+
+void AllocationSite::fill(diagnostic_msgs::DiagnosticStatus& status, double period)
+{
+    boost::mutex::scoped_lock lock(_mutex);
+
+    add_value(status, "passes", "%.0f", _passes);
+    add_value(status, "allocating passes", "%.0f", _allocating);
+    add_value(status, "allocating passes total", "%.0f", _allocating_total);
+    add_value(status, "allocations", "%.0f", _count);
+    add_value(status, "bytes", "%.0f", _bytes);
+
+    if (_allocating > 0) {
+        status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+        status.message = "Allocations in a region that must not allocate";
+    }
+
+    _passes = 0;
+    _allocating = 0;
+    _count = 0;
+    _bytes = 0;
+}
+
+}
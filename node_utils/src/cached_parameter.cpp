@@ -0,0 +1,117 @@
+#include <node_utils/cached_parameter.h>
+#include <ros/callback_queue.h>
+#include <std_msgs/String.h>
+#include <boost/scoped_ptr.hpp>
+#include <algorithm>
+#include <vector>
+
+namespace node_utils {
+
+//------------------------------------------------------------------------------
+// Members
+
+namespace {
+
+/**
+  * All parameters of the process. Globals of other translation units
+  * register during static initialization, so the registry is created on
+  * first use.
+  */
+struct Registry {
+    boost::mutex mutex;
+    std::vector<CachedParameterBase*> parameters;
+
+    boost::scoped_ptr<ros::NodeHandle> handle;
+    ros::CallbackQueue queue;
+    boost::scoped_ptr<ros::AsyncSpinner> spinner;
+    ros::Subscriber sub_update;
+    ros::Timer timer_poll;
+};
+
+Registry& registry()
+{
+    static Registry r;
+    return r;
+}
+
+bool has_prefix(const std::string& name, const std::string& prefix)
+{
+    return name.compare(0, prefix.size(), prefix) == 0;
+}
+
+//------------------------------------------------------------------------------
+// Callbacks
+
+void callback_update(const std_msgs::StringConstPtr& msg)
+{
+    refresh_parameters(msg->data);
+}
+
+void callback_poll(const ros::TimerEvent& event)
+{
+    refresh_parameters();
+}
+
+}
+
+//------------------------------------------------------------------------------
+// Methods
+
+void register_parameter(CachedParameterBase* parameter)
+{
+    Registry& r = registry();
+    {
+        boost::mutex::scoped_lock lock(r.mutex);
+        r.parameters.push_back(parameter);
+    }
+
+    //parameters created after startup, e.g. members of a nodelet, load at once
+    if (ros::isInitialized())
+        parameter->refresh();
+}
+
+void unregister_parameter(CachedParameterBase* parameter)
+{
+    Registry& r = registry();
+    boost::mutex::scoped_lock lock(r.mutex);
+    r.parameters.erase(std::remove(r.parameters.begin(), r.parameters.end(), parameter),
+                       r.parameters.end());
+}
+
+void refresh_parameters(const std::string& prefix)
+{
+    Registry& r = registry();
+    boost::mutex::scoped_lock lock(r.mutex);
+
+    for(size_t i = 0; i < r.parameters.size(); ++i) {
+        if (has_prefix(r.parameters[i]->name(), prefix))
+            r.parameters[i]->refresh();
+    }
+}
+
+void start_parameter_updates()
+{
+    Registry& r = registry();
+    {
+        boost::mutex::scoped_lock lock(r.mutex);
+        if (r.handle)
+            return;
+
+        r.handle.reset(new ros::NodeHandle());
+        r.handle->setCallbackQueue(&r.queue);
+    }
+
+    refresh_parameters();
+
+    r.sub_update = r.handle->subscribe("/parameters/update", 10, callback_update);
+
+    double poll_period = 0;
+    ros::param::get("/parameters/poll_period", poll_period);
+    if (poll_period > 0)
+        r.timer_poll = r.handle->createTimer(ros::Duration(poll_period), callback_poll);
+
+    r.spinner.reset(new ros::AsyncSpinner(1, &r.queue));
+    r.spinner->start();
+}
+
+}
@@ -0,0 +1,246 @@
+#include <node_utils/checkpoint.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <set>
+
+namespace node_utils {
+
+//------------------------------------------------------------------------------
+// Members
+
+namespace {
+
+const char FILE_MAGIC[] = "robot_ai checkpoint";
+
+/**
+  * The ready topic is latched, which keeps one message per publication and
+  * process. So all parts of a process (e.g. a nodelet manager) announce
+  * together.
+  */
+struct Readiness {
+    boost::mutex mutex;
+    std::set<std::string> parts;
+    boost::scoped_ptr<ros::NodeHandle> handle;
+    ros::Publisher pub;
+};
+
+Readiness& readiness()
+{
+    static Readiness r;
+    return r;
+}
+
+/**
+  * The bundle the parts of this process restore from, once resolved.
+  */
+struct RestoreBundle {
+    boost::mutex mutex;
+    bool resolved;
+    std::string bundle;
+
+    RestoreBundle() :resolved(false) {}
+};
+
+RestoreBundle& restore_bundle()
+{
+    static RestoreBundle r;
+    return r;
+}
+
+std::string resolve_restore_bundle()
+{
+    //resolved once, so that a checkpoint written meanwhile does not mix in
+    std::string latest = checkpoint_dir() + "/latest";
+    char resolved[PATH_MAX];
+    if (!realpath(latest.c_str(), resolved)) {
+        ROS_WARN("[checkpoint] No checkpoint in %s, starting fresh", latest.c_str());
+        return "";
+    }
+
+    std::string bundle(resolved);
+    std::ifstream manifest((bundle + "/manifest").c_str());
+    std::string key;
+    int version = -1;
+    manifest >> key >> version;
+    if (key != "version" || version != CHECKPOINT_VERSION) {
+        ROS_ERROR("[checkpoint] %s has version %d, expected %d, starting fresh",
+                  bundle.c_str(), version, CHECKPOINT_VERSION);
+        return "";
+    }
+
+    return bundle;
+}
+
+}
+
+//------------------------------------------------------------------------------
+// Methods
+
+std::string checkpoint_dir()
+{
+    std::string dir;
+    if (ros::param::get("/checkpoint/dir", dir))
+        return dir;
+
+    const char* ros_home = getenv("ROS_HOME");
+    if (ros_home)
+        return std::string(ros_home) + "/checkpoints";
+
+    const char* home = getenv("HOME");
+    return std::string(home ? home : ".") + "/.ros/checkpoints";
+}
+
+bool checkpoint_restore_enabled()
+{
+    bool restore = false;
+    ros::param::get("/checkpoint/restore", restore);
+    return restore;
+}
+
+std::string checkpoint_restore_bundle()
+{
+    if (!checkpoint_restore_enabled())
+        return "";
+
+    RestoreBundle& r = restore_bundle();
+    boost::mutex::scoped_lock lock(r.mutex);
+    if (!r.resolved) {
+        r.bundle = resolve_restore_bundle();
+        r.resolved = true;
+    }
+    return r.bundle;
+}
+
+/**
+  * Layout: magic, md5 sum of the message type and size as a text line, then
+  * the serialized message.
+  */
+bool write_checkpoint_file(const std::string& file_name, const std::string& md5sum,
+                           const std::vector<uint8_t>& data)
+{
+    std::string tmp_name = file_name + ".tmp";
+    FILE* file = fopen(tmp_name.c_str(), "wb");
+    if (!file) {
+        ROS_ERROR("[checkpoint] Could not write %s: %s", tmp_name.c_str(), strerror(errno));
+        return false;
+    }
+
+    bool ok = fprintf(file, "%s %s %lu\n", FILE_MAGIC, md5sum.c_str(), (unsigned long)data.size()) > 0;
+    if (ok && !data.empty())
+        ok = fwrite(&data[0], 1, data.size(), file) == data.size();
+    ok = fclose(file) == 0 && ok;
+
+    if (!ok || rename(tmp_name.c_str(), file_name.c_str()) != 0) {
+        ROS_ERROR("[checkpoint] Could not write %s: %s", file_name.c_str(), strerror(errno));
+        remove(tmp_name.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool read_checkpoint_file(const std::string& file_name, const std::string& md5sum,
+                          std::vector<uint8_t>& data)
+{
+    FILE* file = fopen(file_name.c_str(), "rb");
+    if (!file) {
+        ROS_ERROR("[checkpoint] Could not read %s: %s", file_name.c_str(), strerror(errno));
+        return false;
+    }
+
+    char line[256];
+    char file_md5[64];
+    unsigned long size = 0;
+    bool ok = fgets(line, sizeof(line), file) != NULL
+           && strncmp(line, FILE_MAGIC, sizeof(FILE_MAGIC)-1) == 0
+           && sscanf(line + sizeof(FILE_MAGIC), "%63s %lu", file_md5, &size) == 2;
+
+    if (!ok)
+        ROS_ERROR("[checkpoint] %s is not a checkpoint file", file_name.c_str());
+    else if (md5sum != file_md5) {
+        ROS_ERROR("[checkpoint] %s holds a different message type (md5 %s, expected %s)",
+                  file_name.c_str(), file_md5, md5sum.c_str());
+        ok = false;
+    }
+
+    if (ok) {
+        data.resize(size);
+        ok = size == 0 || fread(&data[0], 1, size, file) == size;
+        if (!ok)
+            ROS_ERROR("[checkpoint] %s is truncated", file_name.c_str());
+    }
+
+    fclose(file);
+    return ok;
+}
+
+void CheckpointPart::start(ros::NodeHandle& handle)
+{
+    _sub_save = handle.subscribe("/checkpoint/save", 1, &CheckpointPart::callback_save, this);
+    _pub_written = handle.advertise<std_msgs::String>("/checkpoint/written", 10);
+}
+
+bool CheckpointPart::restore()
+{
+    return restore(checkpoint_restore_bundle());
+}
+
+bool CheckpointPart::restore(const std::string& bundle)
+{
+    if (bundle.empty())
+        return false;
+
+    ros::WallTime start = ros::WallTime::now();
+    if (!_restore(bundle + "/" + _name)) {
+        ROS_ERROR("[checkpoint] Restoring %s from %s failed, starting fresh", _name.c_str(), bundle.c_str());
+        return false;
+    }
+
+    ROS_INFO("[checkpoint] Restored %s from %s in %.1f ms", _name.c_str(), bundle.c_str(),
+             (ros::WallTime::now() - start).toSec()*1000.0);
+    return true;
+}
+
+void CheckpointPart::ready()
+{
+    Readiness& r = readiness();
+    boost::mutex::scoped_lock lock(r.mutex);
+
+    if (!r.handle) {
+        r.handle.reset(new ros::NodeHandle());
+        r.pub = r.handle->advertise<std_msgs::String>("/checkpoint/ready", 1, true);
+    }
+
+    r.parts.insert(_name);
+
+    std_msgs::String msg;
+    for(std::set<std::string>::const_iterator it = r.parts.begin(); it != r.parts.end(); ++it)
+        msg.data += (msg.data.empty() ? "" : " ") + *it;
+    r.pub.publish(msg);
+}
+
+//------------------------------------------------------------------------------
+// Callbacks
+
+void CheckpointPart::callback_save(const std_msgs::StringConstPtr& bundle)
+{
+    ros::WallTime start = ros::WallTime::now();
+    bool ok = _save(bundle->data + "/" + _name);
+
+    if (ok)
+        ROS_INFO("[checkpoint] Saved %s to %s in %.1f ms", _name.c_str(), bundle->data.c_str(),
+                 (ros::WallTime::now() - start).toSec()*1000.0);
+    else
+        ROS_ERROR("[checkpoint] Saving %s to %s failed", _name.c_str(), bundle->data.c_str());
+
+    std_msgs::String written;
+    written.data = _name + " " + bundle->data + (ok ? " ok" : " failed");
+    _pub_written.publish(written);
+}
+
+}
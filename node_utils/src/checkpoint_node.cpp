@@ -0,0 +1,184 @@
+#include <node_utils/checkpoint.h>
+#include <std_msgs/Empty.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+  * Coordinates checkpoints (see node_utils/checkpoint.h): turns a /save into
+  * a bundle directory, waits for every part and then completes the bundle.
+  */
+
+std::vector<std::string> _parts;
+double _timeout = 5.0;
+
+std::string _bundle;
+std::set<std::string> _pending;
+bool _failed = false;
+
+ros::Publisher _pub_save;
+ros::WallTimer _timer;
+
+//------------------------------------------------------------------------------
+// Methods
+
+bool make_dir(const std::string& dir)
+{
+    if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        ROS_ERROR("[checkpoint] Could not create %s: %s", dir.c_str(), strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+/**
+  * Creates the directory of a new bundle in dir, named after the time in
+  * milliseconds. A bundle of the same name is never reused, the name gets a
+  * counter instead. Returns an empty string on failure.
+  */
+std::string create_bundle(const std::string& dir)
+{
+    ros::WallTime now = ros::WallTime::now();
+    time_t sec = now.sec;
+    char date[32];
+    strftime(date, sizeof(date), "%Y%m%d-%H%M%S", localtime(&sec));
+
+    char name[64];
+    snprintf(name, sizeof(name), "%s.%03u", date, now.nsec/1000000);
+
+    std::string bundle = dir + "/" + name;
+    for(int i = 1; mkdir(bundle.c_str(), 0755) != 0; ++i) {
+        if (errno != EEXIST) {
+            ROS_ERROR("[checkpoint] Could not create %s: %s", bundle.c_str(), strerror(errno));
+            return "";
+        }
+        std::ostringstream numbered;
+        numbered << dir << "/" << name << "-" << i;
+        bundle = numbered.str();
+    }
+    return bundle;
+}
+
+/**
+  * Writes the manifest and points latest at the bundle. The link is replaced
+  * by a rename, so readers see either the old or the new bundle.
+  */
+void complete_bundle()
+{
+    std::ofstream manifest((_bundle + "/manifest").c_str());
+    manifest << "version " << node_utils::CHECKPOINT_VERSION << "\n";
+    manifest << "stamp " << ros::Time::now() << "\n";
+    manifest << "parts";
+    for(size_t i = 0; i < _parts.size(); ++i)
+        manifest << " " << _parts[i];
+    manifest << "\n";
+    manifest.close();
+
+    std::string dir = node_utils::checkpoint_dir();
+    std::string link_tmp = dir + "/latest.tmp";
+    remove(link_tmp.c_str());
+    if (!manifest || symlink(_bundle.c_str(), link_tmp.c_str()) != 0
+            || rename(link_tmp.c_str(), (dir + "/latest").c_str()) != 0) {
+        ROS_ERROR("[checkpoint] Could not complete %s: %s", _bundle.c_str(), strerror(errno));
+        return;
+    }
+
+    ROS_INFO("[checkpoint] Checkpoint %s complete", _bundle.c_str());
+}
+
+//------------------------------------------------------------------------------
+// Callbacks
+
+void callback_save(const std_msgs::EmptyConstPtr& empty)
+{
+    if (!_pending.empty()) {
+        ROS_WARN("[checkpoint] Checkpoint %s still in progress, ignoring /save", _bundle.c_str());
+        return;
+    }
+
+    std::string dir = node_utils::checkpoint_dir();
+    if (!make_dir(dir))
+        return;
+    _bundle = create_bundle(dir);
+    if (_bundle.empty())
+        return;
+
+    _pending.insert(_parts.begin(), _parts.end());
+    _failed = false;
+
+    std_msgs::String msg;
+    msg.data = _bundle;
+    _pub_save.publish(msg);
+
+    if (_pending.empty()) {
+        complete_bundle();
+        return;
+    }
+
+    _timer.stop();
+    _timer.setPeriod(ros::WallDuration(_timeout));
+    _timer.start();
+}
+
+void callback_written(const std_msgs::StringConstPtr& written)
+{
+    std::istringstream in(written->data);
+    std::string part, bundle, status;
+    in >> part >> bundle >> status;
+
+    if (bundle != _bundle || _pending.erase(part) == 0)
+        return;
+
+    if (status != "ok") {
+        ROS_ERROR("[checkpoint] Part %s of %s failed", part.c_str(), _bundle.c_str());
+        _failed = true;
+    }
+
+    if (_pending.empty()) {
+        _timer.stop();
+        if (!_failed)
+            complete_bundle();
+    }
+}
+
+void callback_timeout(const ros::WallTimerEvent& event)
+{
+    _timer.stop();
+    if (_pending.empty())
+        return;
+
+    std::string missing;
+    for(std::set<std::string>::const_iterator it = _pending.begin(); it != _pending.end(); ++it)
+        missing += " " + *it;
+    ROS_ERROR("[checkpoint] %s incomplete, no answer from%s", _bundle.c_str(), missing.c_str());
+
+    _pending.clear();
+}
+
+//------------------------------------------------------------------------------
+// Entry point
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "checkpoint");
+    ros::NodeHandle handle;
+
+    ros::param::get("/checkpoint/parts", _parts);
+    ros::param::get("/checkpoint/timeout", _timeout);
+    if (_parts.empty())
+        ROS_WARN("[checkpoint] /checkpoint/parts is empty, checkpoints complete without any part");
+
+    _pub_save = handle.advertise<std_msgs::String>("/checkpoint/save", 1);
+    ros::Subscriber sub_save = handle.subscribe("/save", 1, callback_save);
+    ros::Subscriber sub_written = handle.subscribe("/checkpoint/written", 10, callback_written);
+    _timer = handle.createWallTimer(ros::WallDuration(_timeout), callback_timeout, false, false);
+
+    ros::spin();
+    return 0;
+}
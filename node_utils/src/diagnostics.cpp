@@ -0,0 +1,266 @@
+#include <node_utils/diagnostics.h>
+#include <ros/callback_queue.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <boost/atomic.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace node_utils {
+
+//------------------------------------------------------------------------------
+// Members
+
+namespace {
+
+struct Diagnostics {
+    boost::mutex mutex;
+    std::vector<DiagnosticsSource*> sources;
+    boost::atomic<bool> active;
+
+    boost::scoped_ptr<ros::NodeHandle> handle;
+    ros::CallbackQueue queue;
+    boost::scoped_ptr<ros::AsyncSpinner> spinner;
+    ros::Publisher pub;
+    ros::WallTimer timer;
+    ros::WallTime last_publish;
+
+    Diagnostics() :active(false) {}
+};
+
+Diagnostics& diagnostics()
+{
+    static Diagnostics d;
+    return d;
+}
+
+void add_histogram(diagnostic_msgs::DiagnosticStatus& status, const std::string& prefix, const DurationHistogram& h)
+{
+    add_value(status, (prefix + " mean [ms]").c_str(), "%.3f", h.mean()*1000.0);
+    add_value(status, (prefix + " p50 [ms]").c_str(), "%.3f", h.percentile(0.5)*1000.0);
+    add_value(status, (prefix + " p99 [ms]").c_str(), "%.3f", h.percentile(0.99)*1000.0);
+    add_value(status, (prefix + " max [ms]").c_str(), "%.3f", h.max()*1000.0);
+}
+
+//------------------------------------------------------------------------------
+// Callbacks
+
+void callback_publish(const ros::WallTimerEvent& event)
+{
+    Diagnostics& d = diagnostics();
+
+    //measure only while someone listens
+    bool active = d.pub.getNumSubscribers() > 0;
+    bool was_active = d.active.exchange(active, boost::memory_order_relaxed);
+
+    ros::WallTime now = ros::WallTime::now();
+    double period = (now - d.last_publish).toSec();
+    d.last_publish = now;
+
+    {
+        boost::mutex::scoped_lock lock(d.mutex);
+        for(size_t i = 0; i < d.sources.size(); ++i)
+            d.sources[i]->flush();
+    }
+
+    if (!active)
+        return;
+
+    diagnostic_msgs::DiagnosticArrayPtr msg(new diagnostic_msgs::DiagnosticArray);
+    msg->header.stamp = ros::Time::now();
+
+    std::string node = ros::this_node::getName();
+    {
+        boost::mutex::scoped_lock lock(d.mutex);
+        msg->status.resize(d.sources.size());
+        for(size_t i = 0; i < d.sources.size(); ++i) {
+            diagnostic_msgs::DiagnosticStatus& status = msg->status[i];
+            status.name = node + ": " + d.sources[i]->name();
+            status.hardware_id = node;
+            status.level = diagnostic_msgs::DiagnosticStatus::OK;
+            status.message = "OK";
+            d.sources[i]->fill(status, period);
+        }
+    }
+
+    //the first period after switching on is incomplete
+    if (was_active)
+        d.pub.publish(msg);
+}
+
+}
+
+//------------------------------------------------------------------------------
+// Methods
+
+void add_value(diagnostic_msgs::DiagnosticStatus& status, const char* key, const char* format, double value)
+{
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), format, value);
+
+    diagnostic_msgs::KeyValue kv;
+    kv.key = key;
+    kv.value = buffer;
+    status.values.push_back(kv);
+}
+
+void DurationHistogram::add(double seconds)
+{
+    double us = seconds*1e6;
+
+    int bin = 0;
+    if (us >= 1.0) {
+        int exponent;
+        std::frexp(us, &exponent);
+        bin = std::min(exponent, NUM_BINS-1);
+    }
+
+    ++_bins[bin];
+    ++_count;
+    _sum += seconds;
+    _max = std::max(_max, seconds);
+}
+
+double DurationHistogram::percentile(double fraction) const
+{
+    long target = (long)(fraction*_count);
+    long accum = 0;
+    for(int i = 0; i < NUM_BINS; ++i) {
+        accum += _bins[i];
+        if (accum > target)
+            return std::min(std::ldexp(1.0, i)*1e-6, _max);
+    }
+    return _max;
+}
+
+void DurationHistogram::reset()
+{
+    std::fill(_bins, _bins+NUM_BINS, 0);
+    _count = 0;
+    _sum = 0;
+    _max = 0;
+}
+
+void DiagnosticsSource::register_source()
+{
+    Diagnostics& d = diagnostics();
+    boost::mutex::scoped_lock lock(d.mutex);
+    d.sources.push_back(this);
+}
+
+void DiagnosticsSource::unregister_source()
+{
+    Diagnostics& d = diagnostics();
+    boost::mutex::scoped_lock lock(d.mutex);
+    d.sources.erase(std::remove(d.sources.begin(), d.sources.end(), this), d.sources.end());
+}
+
+void CallbackStats::add(double duration, double queue_wait)
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    _duration.add(duration);
+    if (queue_wait >= 0)
+        _queue_wait.add(queue_wait);
+}
+
+void CallbackStats::fill(diagnostic_msgs::DiagnosticStatus& status, double period)
+{
+    boost::mutex::scoped_lock lock(_mutex);
+
+    double rate = period > 0 ? _duration.count()/period : 0.0;
+    add_value(status, "calls", "%.0f", _duration.count());
+    add_value(status, "rate [Hz]", "%.1f", rate);
+    add_histogram(status, "duration", _duration);
+
+    if (_queue_wait.count() > 0) {
+        add_histogram(status, "queue wait", _queue_wait);
+        add_value(status, "queue depth", "%.2f", rate*_queue_wait.mean());
+    }
+
+    _duration.reset();
+    _queue_wait.reset();
+}
+
+void LoopStats::add(const ros::WallTime& start, const ros::WallTime& end)
+{
+    boost::mutex::scoped_lock lock(_mutex);
+
+    double duration = (end - start).toSec();
+    _duration.add(duration);
+    if (duration > _period) {
+        ++_overruns;
+        ++_overruns_total;
+    }
+
+    //the first cycle, and the first after measuring was off, has no period
+    if (!_last_start.isZero()) {
+        double actual = (start - _last_start).toSec();
+        if (actual < 10.0*_period)
+            _jitter.add(std::fabs(actual - _period));
+    }
+    _last_start = start;
+}
+
+void LoopStats::add_missed(long missed)
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    _missed += missed;
+    _missed_total += missed;
+}
+
+void LoopStats::fill(diagnostic_msgs::DiagnosticStatus& status, double period)
+{
+    boost::mutex::scoped_lock lock(_mutex);
+
+    add_value(status, "cycles", "%.0f", _duration.count());
+    add_value(status, "rate [Hz]", "%.1f", period > 0 ? _duration.count()/period : 0.0);
+    add_value(status, "target rate [Hz]", "%.1f", 1.0/_period);
+    add_histogram(status, "duration", _duration);
+    add_histogram(status, "jitter", _jitter);
+    add_value(status, "overruns", "%.0f", _overruns);
+    add_value(status, "overruns total", "%.0f", _overruns_total);
+    add_value(status, "deadline misses", "%.0f", _missed);
+    add_value(status, "deadline misses total", "%.0f", _missed_total);
+
+    if (_overruns > 0 || _missed > 0) {
+        status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+        status.message = _missed > 0 ? "Deadline misses" : "Overruns";
+    }
+
+    _duration.reset();
+    _jitter.reset();
+    _overruns = 0;
+    _missed = 0;
+}
+
+bool diagnostics_active()
+{
+    return diagnostics().active.load(boost::memory_order_relaxed);
+}
+
+void start_diagnostics()
+{
+    Diagnostics& d = diagnostics();
+    {
+        boost::mutex::scoped_lock lock(d.mutex);
+        if (d.handle)
+            return;
+
+        d.handle.reset(new ros::NodeHandle());
+        d.handle->setCallbackQueue(&d.queue);
+    }
+
+    double period = 1.0;
+    ros::param::get("/diagnostics/period", period);
+
+    d.pub = d.handle->advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 10);
+    d.last_publish = ros::WallTime::now();
+    d.timer = d.handle->createWallTimer(ros::WallDuration(period), callback_publish);
+
+    d.spinner.reset(new ros::AsyncSpinner(1, &d.queue));
+    d.spinner->start();
+}
+
+}
@@ -0,0 +1,94 @@
+#include <node_utils/log_limit.h>
+#include <algorithm>
+
+namespace node_utils {
+
+//------------------------------------------------------------------------------
+// Methods
+
+LogSite::LogSite(const std::string& name, double rate, double burst)
+    :DiagnosticsSource(name)
+    ,_rate(rate)
+    ,_burst(burst)
+    ,_tokens(burst)
+    ,_suppressed(0)
+    ,_level(ros::console::levels::Info)
+    ,_events(0)
+    ,_events_total(0)
+    ,_dropped(0)
+{
+    register_source();
+}
+
+bool LogSite::hit(ros::console::levels::Level level, Summary& summary)
+{
+    ros::WallTime now = ros::WallTime::now();
+    boost::mutex::scoped_lock lock(_mutex);
+
+    ++_events;
+    ++_events_total;
+    _level = level;
+
+    if (!_last_refill.isZero())
+        _tokens = std::min(_burst, _tokens + (now - _last_refill).toSec()*_rate);
+    _last_refill = now;
+
+    if (_tokens < 1.0) {
+        ++_suppressed;
+        ++_dropped;
+        return false;
+    }
+
+    _tokens -= 1.0;
+    take_summary(now, summary);
+    return true;
+}
+
+/**
+  * While the events keep coming the summary follows the next logged
+  * message, a token period at the latest.
+  */
+void LogSite::flush()
+{
+    ros::WallTime now = ros::WallTime::now();
+    Summary summary;
+    ros::console::levels::Level level;
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        if (_suppressed == 0 || (now - _last_logged).toSec() < 1.0/_rate)
+            return;
+        take_summary(now, summary);
+        level = _level;
+    }
+
+    ROS_LOG(level, ROSCONSOLE_DEFAULT_NAME, "[%s] %ld more in the last %.1f s",
+            _name.c_str(), summary.suppressed, summary.period);
+}
+
+void LogSite::take_summary(const ros::WallTime& now, Summary& summary)
+{
+    summary.suppressed = _suppressed;
+    summary.period = _last_logged.isZero() ? 0.0 : (now - _last_logged).toSec();
+    _suppressed = 0;
+    _last_logged = now;
+}
+
+void LogSite::fill(diagnostic_msgs::DiagnosticStatus& status, double period)
+{
+    boost::mutex::scoped_lock lock(_mutex);
+
+    add_value(status, "events", "%.0f", _events);
+    add_value(status, "events total", "%.0f", _events_total);
+    add_value(status, "rate [Hz]", "%.1f", period > 0 ? _events/period : 0.0);
+    add_value(status, "dropped", "%.0f", _dropped);
+
+    if (_dropped > 0) {
+        status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+        status.message = "Log messages dropped";
+    }
+
+    _events = 0;
+    _dropped = 0;
+}
+
+}
@@ -0,0 +1,138 @@
+#include <node_utils/periodic_executor.h>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace node_utils {
+
+//------------------------------------------------------------------------------
+// Members
+
+namespace {
+
+/**
+  * Longest sleep between checks for a stop request.
+  */
+const double MAX_SLEEP = 0.05;
+
+void set_thread_priority(const std::string& name, int priority)
+{
+    if (priority == 0)
+        return;
+
+    //on linux the nice value of a thread id applies to that thread only
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+    if (setpriority(PRIO_PROCESS, tid, -priority) != 0)
+        ROS_ERROR("[PeriodicExecutor] Could not set priority %d for %s: %s",
+                  priority, name.c_str(), strerror(errno));
+}
+
+}
+
+//------------------------------------------------------------------------------
+// Methods
+
+void PeriodicExecutor::add(const std::string& name, double rate, const Task& task,
+                           OverrunPolicy policy, int priority)
+{
+    boost::shared_ptr<Entry> entry(new Entry);
+    entry->name = name;
+    entry->period = 1.0/rate;
+    entry->task = task;
+    entry->policy = policy;
+    entry->priority = priority;
+    entry->stats.reset(new LoopStats(name, entry->period));
+    _entries.push_back(entry);
+}
+
+void PeriodicExecutor::start()
+{
+    if (_running.exchange(true))
+        return;
+
+    for(size_t i = 0; i < _entries.size(); ++i)
+        _threads.create_thread(boost::bind(&PeriodicExecutor::run, this, _entries[i].get()));
+}
+
+void PeriodicExecutor::stop()
+{
+    if (!_running.exchange(false))
+        return;
+
+    _threads.join_all();
+}
+
+void PeriodicExecutor::spin(int spinner_threads)
+{
+    start();
+
+    ros::AsyncSpinner spinner(spinner_threads);
+    spinner.start();
+    ros::waitForShutdown();
+
+    stop();
+}
+
+/**
+  * Sleeps in short steps so that stop requests are noticed. Returns false if
+  * the executor or ros is shutting down.
+  */
+bool PeriodicExecutor::sleep_until(const ros::Time& time)
+{
+    while (_running && ros::ok())
+    {
+        double left = (time - ros::Time::now()).toSec();
+        if (left <= 0)
+            return true;
+        ros::Duration(std::min(left, MAX_SLEEP)).sleep();
+    }
+    return false;
+}
+
+void PeriodicExecutor::run(Entry* entry)
+{
+    set_thread_priority(entry->name, entry->priority);
+
+    //with sim time the clock is zero until the first /clock message
+    while (_running && ros::ok() && ros::Time::now().isZero())
+        ros::WallDuration(0.01).sleep();
+
+    const ros::Duration period(entry->period);
+    ros::Time next = ros::Time::now();
+
+    while (sleep_until(next))
+    {
+        ros::WallTime start = ros::WallTime::now();
+        entry->task();
+        if (diagnostics_active())
+            entry->stats->add(start, ros::WallTime::now());
+
+        next += period;
+
+        ros::Time now = ros::Time::now();
+
+        //the clock went back (e.g. a restarted simulation), start over
+        if (next - now > period + period) {
+            next = now;
+            continue;
+        }
+
+        //whole periods that were missed
+        long missed = (long)((now - next).toSec()/entry->period);
+        if (missed <= 0)
+            continue;
+
+        entry->stats->add_missed(missed);
+
+        if (entry->policy == CATCH_UP)
+            missed = std::max(0L, missed - MAX_CATCH_UP);
+
+        next += ros::Duration(missed*entry->period);
+    }
+}
+
+}
@@ -0,0 +1,177 @@
+#include <node_utils/realtime.h>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace node_utils {
+
+//------------------------------------------------------------------------------
+// Members
+
+namespace {
+
+boost::atomic<bool> _process_done(false);
+
+const int MAX_STACK_PREFAULT = 1024*1024;
+
+/**
+  * Touches the pages below the current stack frame, so that they are mapped
+  * (and locked) before the thread has to be fast.
+  */
+void prefault_stack(int size)
+{
+    volatile char frame[MAX_STACK_PREFAULT];
+    size = std::min(size, MAX_STACK_PREFAULT);
+    for(int i = 0; i < size; i += 4096)
+        frame[MAX_STACK_PREFAULT-1-i] = 0;
+    (void)frame;
+}
+
+const char* privilege_hint(int error)
+{
+    return error == EPERM ? " (missing privilege, see realtime.h)" : "";
+}
+
+}
+
+//------------------------------------------------------------------------------
+// Methods
+
+RealtimeProfile::RealtimeProfile()
+    :enabled(false)
+    ,priority(80)
+    ,lock_memory(true)
+    ,stack_prefault(256*1024)
+    ,heap_reserve(8*1024*1024)
+{}
+
+void RealtimeProfile::load(const ros::NodeHandle& private_handle)
+{
+    private_handle.param("realtime/enabled", enabled, enabled);
+    private_handle.param("realtime/priority", priority, priority);
+    private_handle.param("realtime/cpus", cpus, cpus);
+    private_handle.param("realtime/lock_memory", lock_memory, lock_memory);
+    private_handle.param("realtime/stack_prefault", stack_prefault, stack_prefault);
+    private_handle.param("realtime/heap_reserve", heap_reserve, heap_reserve);
+}
+
+bool setup_realtime_process(const RealtimeProfile& profile)
+{
+    if (!profile.enabled || _process_done.exchange(true))
+        return true;
+
+    bool ok = true;
+
+    if (profile.lock_memory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        int error = errno;
+        struct rlimit limit;
+        getrlimit(RLIMIT_MEMLOCK, &limit);
+        ROS_ERROR("[realtime] mlockall failed: %s%s, memlock limit %ld kB",
+                  strerror(error), privilege_hint(error), (long)limit.rlim_cur/1024);
+        ok = false;
+    }
+
+    if (profile.heap_reserve > 0) {
+        //keep freed memory in the process instead of returning it to the system
+        mallopt(M_TRIM_THRESHOLD, -1);
+        mallopt(M_MMAP_MAX, 0);
+
+        char* reserve = (char*)malloc(profile.heap_reserve);
+        if (reserve) {
+            for(int i = 0; i < profile.heap_reserve; i += 4096)
+                reserve[i] = 0;
+            free(reserve);
+        }
+    }
+
+    return ok;
+}
+
+bool setup_realtime_thread(const RealtimeProfile& profile, const std::string& name)
+{
+    if (!profile.enabled)
+        return true;
+
+    bool ok = true;
+
+    if (!profile.cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for(size_t i = 0; i < profile.cpus.size(); ++i)
+            CPU_SET(profile.cpus[i], &set);
+
+        int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (error != 0) {
+            ROS_ERROR("[realtime] %s: setting the cpu affinity failed: %s", name.c_str(), strerror(error));
+            ok = false;
+        }
+    }
+
+    if (profile.priority > 0) {
+        struct sched_param param;
+        param.sched_priority = std::min(profile.priority, sched_get_priority_max(SCHED_FIFO));
+
+        int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (error != 0) {
+            struct rlimit limit;
+            getrlimit(RLIMIT_RTPRIO, &limit);
+            ROS_ERROR("[realtime] %s: SCHED_FIFO priority %d failed: %s%s, rtprio limit %ld",
+                      name.c_str(), param.sched_priority, strerror(error), privilege_hint(error),
+                      (long)limit.rlim_cur);
+            ok = false;
+        }
+    }
+
+    if (profile.stack_prefault > 0)
+        prefault_stack(profile.stack_prefault);
+
+    if (ok)
+        ROS_INFO("[realtime] %s: SCHED_FIFO %d, %lu cpus pinned", name.c_str(), profile.priority, profile.cpus.size());
+
+    return ok;
+}
+
+void setup_realtime_main(const std::string& name)
+{
+    RealtimeProfile profile;
+    profile.load(ros::NodeHandle("~"));
+
+    setup_realtime_process(profile);
+    setup_realtime_thread(profile, name);
+}
+
+void RealtimeSpinner::start()
+{
+    if (_running.exchange(true))
+        return;
+
+    _thread.reset(new boost::thread(boost::bind(&RealtimeSpinner::run, this)));
+}
+
+void RealtimeSpinner::stop()
+{
+    if (!_running.exchange(false))
+        return;
+
+    _thread->join();
+    _thread.reset();
+}
+
+void RealtimeSpinner::run()
+{
+    setup_realtime_process(_profile);
+    setup_realtime_thread(_profile, _name);
+
+    while (_running && ros::ok())
+        _queue.callAvailable(ros::WallDuration(0.1));
+}
+
+}
@@ -0,0 +1,261 @@
+#include <node_utils/trace.h>
+#include <node_utils/cached_parameter.h>
+#include <ros/callback_queue.h>
+#include <std_msgs/String.h>
+#include <boost/atomic.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <vector>
+#include <unistd.h>
+
+namespace node_utils {
+
+//------------------------------------------------------------------------------
+// Members
+
+namespace {
+
+struct Span {
+    const char* name;
+    uint32_t trace_id;
+    int thread;
+    int64_t begin;  //ns
+    int64_t end;
+};
+
+/**
+  * Single producer ring buffer. The owning thread writes the slot and then
+  * publishes it by advancing head; the exporter copies the slots and drops
+  * those that were overwritten meanwhile.
+  */
+struct ThreadBuffer {
+    int index;
+    boost::atomic<uint64_t> head;
+    Span spans[TRACE_CAPACITY];
+
+    ThreadBuffer(int index) :index(index), head(0) {}
+};
+
+void keep_buffer(ThreadBuffer*)
+{
+    //buffers outlive their thread so that they can still be exported
+}
+
+struct Tracer {
+    boost::mutex mutex;
+    std::vector<ThreadBuffer*> buffers;
+    boost::thread_specific_ptr<ThreadBuffer> local;
+
+    boost::scoped_ptr<ros::NodeHandle> handle;
+    ros::CallbackQueue queue;
+    boost::scoped_ptr<ros::AsyncSpinner> spinner;
+    ros::Subscriber sub_dump;
+
+    Tracer() :local(keep_buffer) {}
+};
+
+Tracer& tracer()
+{
+    static Tracer t;
+    return t;
+}
+
+CachedParameter<bool> _enabled("/trace/enabled", false);
+
+ThreadBuffer* local_buffer()
+{
+    Tracer& t = tracer();
+    ThreadBuffer* buffer = t.local.get();
+    if (!buffer) {
+        boost::mutex::scoped_lock lock(t.mutex);
+        buffer = new ThreadBuffer((int)t.buffers.size());
+        t.buffers.push_back(buffer);
+        t.local.reset(buffer);
+    }
+    return buffer;
+}
+
+void copy_spans(std::vector<Span>& spans)
+{
+    Tracer& t = tracer();
+    boost::mutex::scoped_lock lock(t.mutex);
+
+    for(size_t b = 0; b < t.buffers.size(); ++b)
+    {
+        ThreadBuffer* buffer = t.buffers[b];
+        uint64_t head = buffer->head.load(boost::memory_order_acquire);
+        uint64_t first = head > TRACE_CAPACITY ? head - TRACE_CAPACITY : 0;
+
+        std::vector<Span> copy;
+        for(uint64_t i = first; i < head; ++i)
+            copy.push_back(buffer->spans[i % TRACE_CAPACITY]);
+
+        //spans written during the copy may have replaced the oldest ones, and
+        //the writer may still be in the middle of the one at index valid
+        uint64_t after = buffer->head.load(boost::memory_order_acquire);
+        size_t skip = 0;
+        if (after >= TRACE_CAPACITY) {
+            uint64_t valid = after - TRACE_CAPACITY;
+            if (valid + 1 > first)
+                skip = std::min<size_t>(valid + 1 - first, copy.size());
+        }
+
+        spans.insert(spans.end(), copy.begin() + skip, copy.end());
+    }
+}
+
+bool by_begin(const Span& a, const Span& b)
+{
+    return a.begin < b.begin;
+}
+
+/**
+  * Chrome trace timestamps are in microseconds.
+  */
+inline double us(int64_t ns)
+{
+    return ns/1000.0;
+}
+
+//------------------------------------------------------------------------------
+// Callbacks
+
+void callback_dump(const std_msgs::StringConstPtr& msg)
+{
+    std::string dir = msg->data.empty() ? "." : msg->data;
+
+    std::string node = ros::this_node::getName();
+    std::replace(node.begin(), node.end(), '/', '_');
+
+    char file_name[512];
+    snprintf(file_name, sizeof(file_name), "%s/trace%s_%d.json", dir.c_str(), node.c_str(), (int)getpid());
+
+    if (!write_trace(file_name))
+        ROS_ERROR("[trace] Could not write %s", file_name);
+}
+
+}
+
+//------------------------------------------------------------------------------
+// Methods
+
+bool tracing_enabled()
+{
+    return _enabled();
+}
+
+uint32_t trace_id(const ros::Time& stamp)
+{
+    //0 means no trace
+    uint32_t id = stamp.sec*1000003u ^ stamp.nsec;
+    return id != 0 ? id : 1;
+}
+
+void trace_span(const char* name, uint32_t trace_id, const ros::Time& begin, const ros::Time& end)
+{
+    if (!_enabled())
+        return;
+
+    ThreadBuffer* buffer = local_buffer();
+    uint64_t head = buffer->head.load(boost::memory_order_relaxed);
+
+    Span& span = buffer->spans[head % TRACE_CAPACITY];
+    span.name = name;
+    span.trace_id = trace_id;
+    span.thread = buffer->index;
+    span.begin = begin.toNSec();
+    span.end = end.toNSec();
+
+    buffer->head.store(head + 1, boost::memory_order_release);
+}
+
+bool write_trace(const std::string& file_name)
+{
+    std::vector<Span> spans;
+    copy_spans(spans);
+    std::stable_sort(spans.begin(), spans.end(), by_begin);
+
+    FILE* file = fopen(file_name.c_str(), "w");
+    if (!file)
+        return false;
+
+    int pid = (int)getpid();
+    std::string node = ros::this_node::getName();
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s\"}}", pid, node.c_str());
+
+    std::map<uint32_t, int> count;
+    for(size_t i = 0; i < spans.size(); ++i) {
+        if (spans[i].trace_id != 0)
+            ++count[spans[i].trace_id];
+    }
+
+    std::map<std::string, std::vector<double> > durations;
+    std::map<uint32_t, int> seen;
+
+    for(size_t i = 0; i < spans.size(); ++i)
+    {
+        const Span& s = spans[i];
+        fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"span\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"trace\":%u}}",
+                s.name, us(s.begin), us(s.end - s.begin), pid, s.thread, s.trace_id);
+
+        durations[s.name].push_back((s.end - s.begin)/1e6);
+
+        //flow arrows through the spans of a trace
+        if (s.trace_id == 0 || count[s.trace_id] < 2)
+            continue;
+
+        int n = seen[s.trace_id]++;
+        const char* phase = n == 0 ? "s" : (n < count[s.trace_id]-1 ? "t" : "f");
+
+        fprintf(file, ",\n{\"name\":\"trace\",\"cat\":\"flow\",\"ph\":\"%s\",\"bp\":\"e\",\"id\":%u,\"ts\":%.3f,\"pid\":%d,\"tid\":%d}",
+                phase, s.trace_id, us(s.begin), pid, s.thread);
+    }
+
+    fprintf(file, "\n],\"otherData\":{");
+
+    //stage latencies in ms
+    bool first = true;
+    for(std::map<std::string, std::vector<double> >::iterator it = durations.begin(); it != durations.end(); ++it)
+    {
+        std::vector<double>& d = it->second;
+        std::sort(d.begin(), d.end());
+        double p50 = d[(size_t)(0.5*(d.size()-1))];
+        double p99 = d[(size_t)(0.99*(d.size()-1))];
+
+        fprintf(file, "%s\n\"%s\":\"n=%lu p50=%.3fms p99=%.3fms max=%.3fms\"",
+                first ? "" : ",", it->first.c_str(), d.size(), p50, p99, d.back());
+        first = false;
+
+        ROS_INFO("[trace] %s: n=%lu p50=%.3fms p99=%.3fms max=%.3fms",
+                 it->first.c_str(), d.size(), p50, p99, d.back());
+    }
+
+    fprintf(file, "\n}}\n");
+    return fclose(file) == 0;
+}
+
+void start_trace_export()
+{
+    Tracer& t = tracer();
+    {
+        boost::mutex::scoped_lock lock(t.mutex);
+        if (t.handle)
+            return;
+
+        t.handle.reset(new ros::NodeHandle());
+        t.handle->setCallbackQueue(&t.queue);
+    }
+
+    t.sub_dump = t.handle->subscribe("/trace/dump", 1, callback_dump);
+
+    t.spinner.reset(new ros::AsyncSpinner(1, &t.queue));
+    t.spinner->start();
+}
+
+}
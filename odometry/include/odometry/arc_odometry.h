@@ -0,0 +1,60 @@
+#ifndef ODOMETRY_ARC_ODOMETRY_H
+#define ODOMETRY_ARC_ODOMETRY_H
+
+#include <cmath>
+
+namespace odometry {
+
+/**
+  * Differential drive pose integration along the exact circular arc.
+  * Both wheels move with constant velocity during one tick, so the robot
+  * travels on a circle with dTheta = (r-l)/b. The displacement is the chord
+  * of that arc, taken at the mid heading theta + dTheta/2:
+  *
+  *   chord = dist * sin(dTheta/2) / (dTheta/2)
+  *
+  * For small angles the sinc term is replaced by its Taylor expansion, which
+  * keeps the step free of divisions by zero and of branches in the common
+  * straight driving case. Integrating (-l,-r) after (l,r) returns exactly to
+  * the starting pose, which is what reverting readings relies on.
+  *
+  * integrate_arc_turn takes the travelled distance and the heading change
+  * directly, e.g. when the heading change comes from the gyro.
+  */
+inline void integrate_arc_turn(double dist, double dTheta,
+                               double& x, double& y, double& theta)
+{
+    const double half = dTheta / 2.0;
+    const double sq = half*half;
+    const double sinc = (sq < 1e-6) ? 1.0 - sq/6.0 : std::sin(half)/half;
+
+    const double mid = theta + half;
+    const double chord = dist * sinc;
+
+    x += chord * std::cos(mid);
+    y += chord * std::sin(mid);
+    theta += dTheta;
+}
+
+inline void integrate_arc(double dist_l, double dist_r, double wheel_distance,
+                          double& x, double& y, double& theta)
+{
+    integrate_arc_turn((dist_r + dist_l) / 2.0, (dist_r - dist_l) / wheel_distance, x, y, theta);
+}
+
+/**
+  * Integrates a batch of n ticks. The per tick cost is the same as for
+  * single calls, so a lower encoder message rate with several ticks per
+  * message does not lose accuracy.
+  */
+inline void integrate_arc(const double* dist_l, const double* dist_r, int n,
+                          double wheel_distance,
+                          double& x, double& y, double& theta)
+{
+    for(int i = 0; i < n; ++i)
+        integrate_arc(dist_l[i], dist_r[i], wheel_distance, x, y, theta);
+}
+
+}
+
+#endif // ODOMETRY_ARC_ODOMETRY_H
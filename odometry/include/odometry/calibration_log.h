@@ -0,0 +1,114 @@
+#ifndef ODOMETRY_CALIBRATION_LOG_H
+#define ODOMETRY_CALIBRATION_LOG_H
+
+#include <stdint.h>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace odometry {
+
+/**
+  * Binary log of a calibrator run. A fixed header with the nominal robot
+  * dimensions and the start pose is followed by one record per encoder
+  * message holding the wheel ticks in driving direction as int16 pairs.
+  * Deltas that do not fit are split into parts that sum up exactly, but each
+  * part is rounded to whole ticks, so its left/right ratio and the integrated
+  * arc can differ from the unsplit delta by up to a tick per part.
+  */
+struct CalibrationLogHeader {
+    char magic[4];
+    uint32_t version;
+    double ticks_per_rev;
+    double wheel_radius;
+    double wheel_distance;
+    double start_x, start_y, start_theta;
+};
+
+struct CalibrationTick {
+    int16_t left;
+    int16_t right;
+};
+
+static const char CALIBRATION_LOG_MAGIC[4] = {'C','A','L','B'};
+static const uint32_t CALIBRATION_LOG_VERSION = 1;
+
+class CalibrationLogWriter {
+public:
+
+    CalibrationLogWriter() {}
+
+    bool open(const std::string& file_name, const CalibrationLogHeader& header)
+    {
+        _out.open(file_name.c_str(), std::ios::out | std::ios::binary);
+        if (!_out.is_open())
+            return false;
+
+        CalibrationLogHeader h = header;
+        memcpy(h.magic, CALIBRATION_LOG_MAGIC, 4);
+        h.version = CALIBRATION_LOG_VERSION;
+        _out.write((const char*)&h, sizeof(h));
+
+        return _out.good();
+    }
+
+    bool is_open() const { return _out.is_open(); }
+
+    void write(int left, int right)
+    {
+        int parts = 1 + std::max(std::abs(left), std::abs(right)) / 32767;
+
+        CalibrationTick tick;
+        for(int i = 0; i < parts; ++i) {
+            //distribute the remainder so that the parts sum up exactly
+            tick.left = (int16_t)(left*(i+1)/parts - left*i/parts);
+            tick.right = (int16_t)(right*(i+1)/parts - right*i/parts);
+            _out.write((const char*)&tick, sizeof(tick));
+        }
+    }
+
+    void close()
+    {
+        if (_out.is_open())
+            _out.close();
+    }
+
+protected:
+
+    std::ofstream _out;
+};
+
+/**
+  * Reads a whole log into memory. Returns false if the file cannot be read
+  * or has an unknown format.
+  */
+inline bool read_calibration_log(const std::string& file_name,
+                                 CalibrationLogHeader& header,
+                                 std::vector<CalibrationTick>& ticks)
+{
+    std::ifstream in(file_name.c_str(), std::ios::in | std::ios::binary);
+    if (!in.is_open())
+        return false;
+
+    in.read((char*)&header, sizeof(header));
+    if (!in.good() || memcmp(header.magic, CALIBRATION_LOG_MAGIC, 4) != 0 ||
+        header.version != CALIBRATION_LOG_VERSION)
+        return false;
+
+    in.seekg(0, std::ios::end);
+    std::streamoff size = (std::streamoff)in.tellg() - (std::streamoff)sizeof(header);
+    in.seekg(sizeof(header), std::ios::beg);
+
+    ticks.resize(size / sizeof(CalibrationTick));
+    if (!ticks.empty())
+        in.read((char*)&ticks[0], ticks.size()*sizeof(CalibrationTick));
+
+    return true;
+}
+
+}
+
+#endif // ODOMETRY_CALIBRATION_LOG_H
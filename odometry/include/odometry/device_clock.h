@@ -0,0 +1,79 @@
+#ifndef ODOMETRY_DEVICE_CLOCK_H
+#define ODOMETRY_DEVICE_CLOCK_H
+
+#include <ros/ros.h>
+#include <stdint.h>
+#include <algorithm>
+
+namespace odometry {
+
+/**
+  * Maps the millisecond counter of a device (e.g. the timestamp field of the
+  * arduino encoder message) onto ros time.
+  *
+  * Every message arrives after it was sampled, so receipt - device_time is
+  * an upper bound of the clock offset. The offset is tracked as the minimum
+  * of these bounds, which converges to the offset of the least delayed
+  * message. The estimate is allowed to grow by max_drift seconds per second
+  * to follow drift between the two clocks.
+  */
+class DeviceClock {
+public:
+
+    DeviceClock(double max_drift = 1e-3)
+        :_max_drift(max_drift)
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        _initialized = false;
+        _device_msec = 0;
+        _last_raw = 0;
+        _offset = 0;
+    }
+
+    ros::Time to_ros(int32_t device_stamp, const ros::Time& receipt)
+    {
+        uint32_t raw = (uint32_t)device_stamp;
+
+        if (!_initialized) {
+            _initialized = true;
+            _last_raw = raw;
+            _device_msec = 0;
+            _offset = receipt.toSec();
+            return receipt;
+        }
+
+        //unwrap the 32 bit counter; a jump backwards means the device restarted
+        uint32_t delta = raw - _last_raw;
+        if (delta > 0x7fffffffu) {
+            ROS_WARN("[DeviceClock::to_ros] Device clock jumped backwards. Resynchronizing.");
+            reset();
+            return to_ros(device_stamp, receipt);
+        }
+        _last_raw = raw;
+        _device_msec += delta;
+
+        double device_sec = (double)_device_msec / 1000.0;
+        double bound = receipt.toSec() - device_sec;
+
+        _offset = std::min(_offset + _max_drift * (double)delta / 1000.0, bound);
+
+        return ros::Time(device_sec + _offset);
+    }
+
+protected:
+
+    double _max_drift;
+
+    bool _initialized;
+    int64_t _device_msec;
+    uint32_t _last_raw;
+    double _offset;
+};
+
+}
+
+#endif // ODOMETRY_DEVICE_CLOCK_H
@@ -0,0 +1,120 @@
+#ifndef ODOMETRY_GYRO_HEADING_H
+#define ODOMETRY_GYRO_HEADING_H
+
+#include <ros/ros.h>
+
+namespace odometry {
+
+/**
+  * Keeps the most recent samples of the integrated imu yaw
+  * (/perception/imu/yaw) in a fixed ring and answers the yaw change between
+  * two encoder ticks. The yaw at a tick is linearly interpolated between the
+  * bracketing samples; a tick newer than the last sample uses the last
+  * sample if it is at most max_lag old.
+  */
+class GyroHeading {
+public:
+
+    static const int CAPACITY = 256;
+
+    GyroHeading(double max_lag = 0.02)
+        :_max_lag(max_lag)
+    {
+        reset();
+    }
+
+    void set_max_lag(double max_lag) { _max_lag = max_lag; }
+
+    void reset()
+    {
+        _head = 0;
+        _count = 0;
+        _tick_valid = false;
+    }
+
+    /**
+      * The next tick() starts a new increment instead of measuring from the
+      * previous tick.
+      */
+    void reset_tick() { _tick_valid = false; }
+
+    void add(const ros::Time& stamp, double yaw)
+    {
+        //samples out of order would break the interpolation
+        if (_count > 0 && stamp <= _stamps[(_head + CAPACITY - 1) % CAPACITY])
+            return;
+
+        _stamps[_head] = stamp;
+        _yaws[_head] = yaw;
+        _head = (_head+1) % CAPACITY;
+        if (_count < CAPACITY)
+            ++_count;
+    }
+
+    /**
+      * Yaw at time t. Returns false if t is not covered by the samples.
+      */
+    bool yaw_at(const ros::Time& t, double& yaw) const
+    {
+        if (_count == 0)
+            return false;
+
+        int newest = (_head + CAPACITY - 1) % CAPACITY;
+        if (t >= _stamps[newest]) {
+            if ((t - _stamps[newest]).toSec() > _max_lag)
+                return false;
+            yaw = _yaws[newest];
+            return true;
+        }
+
+        //ticks are close to the newest sample, so search from the back
+        for(int i = 1; i < _count; ++i) {
+            int older = (newest + CAPACITY - i) % CAPACITY;
+            int newer = (older + 1) % CAPACITY;
+            if (_stamps[older] <= t) {
+                double span = (_stamps[newer] - _stamps[older]).toSec();
+                double f = (t - _stamps[older]).toSec() / span;
+                yaw = _yaws[older] + f*(_yaws[newer] - _yaws[older]);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /**
+      * Yaw change since the previous call. Returns false if either end is
+      * not covered, e.g. on the first tick or after an imu dropout.
+      */
+    bool tick(const ros::Time& t, double& dYaw)
+    {
+        double yaw;
+        if (!yaw_at(t, yaw)) {
+            _tick_valid = false;
+            return false;
+        }
+
+        bool valid = _tick_valid;
+        dYaw = yaw - _tick_yaw;
+
+        _tick_yaw = yaw;
+        _tick_valid = true;
+        return valid;
+    }
+
+protected:
+
+    double _max_lag;
+
+    ros::Time _stamps[CAPACITY];
+    double _yaws[CAPACITY];
+    int _head;
+    int _count;
+
+    double _tick_yaw;
+    bool _tick_valid;
+};
+
+}
+
+#endif // ODOMETRY_GYRO_HEADING_H
@@ -0,0 +1,13 @@
+#ifndef ODOMETRY_POSE_GENERATOR_H
+#define ODOMETRY_POSE_GENERATOR_H
+
+#include <ros/ros.h>
+
+/**
+  * Initializes the pose and subscribes and advertises all topics of the
+  * pose generator on the given handle. Shared by the pose_generator
+  * executable and the pose generator nodelet.
+  */
+void setup_pose_generator(ros::NodeHandle& handle);
+
+#endif // ODOMETRY_POSE_GENERATOR_H
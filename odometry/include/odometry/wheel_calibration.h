@@ -0,0 +1,207 @@
+#ifndef ODOMETRY_WHEEL_CALIBRATION_H
+#define ODOMETRY_WHEEL_CALIBRATION_H
+
+#include <Eigen/Core>
+#include <cmath>
+#include <algorithm>
+
+namespace odometry {
+
+/**
+  * Online estimation of the left/right wheel scale (c_l, c_r) and the
+  * track width b by recursive least squares.
+  *
+  * The per tick cost is accumulating the nominal wheel displacements. Between
+  * two observations these sums are compared against
+  *  - the heading change measured from walls:  dTheta = (c_r*S_r - c_l*S_l)/b
+  *  - the distance driven towards a plane:     dist   = (c_l*S_l + c_r*S_r)/2
+  * and the estimate is refined by one scalar, linearized RLS update with
+  * exponential forgetting. Memory is constant.
+  */
+class WheelCalibration {
+public:
+
+    WheelCalibration()
+    {
+        reset(1.0, 1.0, 0.2);
+    }
+
+    void reset(double c_l, double c_r, double wheel_distance)
+    {
+        _p << c_l, c_r, wheel_distance;
+        _nominal_wheel_distance = wheel_distance;
+
+        _P.setZero();
+        _P(0,0) = _P(1,1) = 0.05*0.05;
+        _P(2,2) = (0.05*wheel_distance)*(0.05*wheel_distance);
+
+        _forgetting = 0.999;
+        _heading_var = 0.03*0.03;
+        _dist_var = 0.02*0.02;
+
+        _min_heading_travel = 1.0;
+        _min_plane_travel = 0.2;
+
+        reset_anchors();
+    }
+
+    /**
+      * Discards the open observation windows, e.g. when wheel readings were
+      * dropped or reverted.
+      */
+    void reset_anchors()
+    {
+        _has_heading_anchor = false;
+        _has_plane_anchor = false;
+        _hs_l = _hs_r = 0;
+        _ps_l = _ps_r = 0;
+    }
+
+    void set_noise(double heading_std, double dist_std)
+    {
+        _heading_var = heading_std*heading_std;
+        _dist_var = dist_std*dist_std;
+    }
+
+    void set_forgetting(double lambda) { _forgetting = lambda; }
+
+    /**
+      * Called once per encoder tick with the uncalibrated wheel displacements.
+      */
+    inline void accumulate(double nominal_l, double nominal_r)
+    {
+        _hs_l += nominal_l; _hs_r += nominal_r;
+        _ps_l += nominal_l; _ps_r += nominal_r;
+    }
+
+    inline double c_l() const { return _p(0); }
+    inline double c_r() const { return _p(1); }
+    inline double wheel_distance() const { return _p(2); }
+
+    /**
+      * Absolute heading measured from a wall. Returns true if the estimate
+      * was updated.
+      */
+    bool observe_heading(double theta)
+    {
+        if (!_has_heading_anchor) {
+            anchor_heading(theta);
+            return false;
+        }
+
+        //wait until the wheels travelled far enough for the error to show
+        if (std::abs(_hs_l) + std::abs(_hs_r) < 2.0*_min_heading_travel)
+            return false;
+
+        double b = _p(2);
+        double predicted = (_p(1)*_hs_r - _p(0)*_hs_l) / b;
+
+        Eigen::Vector3d H(-_hs_l/b, _hs_r/b, -predicted/b);
+        double residual = wrap_angle(theta - _heading_anchor - predicted);
+
+        bool updated = update(H, residual, _heading_var);
+
+        anchor_heading(theta);
+        return updated;
+    }
+
+    /**
+      * Distance to a plane in front of the robot. Returns true if the
+      * estimate was updated.
+      */
+    bool observe_plane_distance(double dist)
+    {
+        if (!_has_plane_anchor) {
+            anchor_plane(dist);
+            return false;
+        }
+
+        double travel = (_ps_l + _ps_r) / 2.0;
+        if (std::abs(travel) < _min_plane_travel)
+            return false;
+
+        //only straight segments are informative about the wheel radii
+        double turned = (_ps_r - _ps_l) / _p(2);
+        if (std::abs(turned) > 5.0*M_PI/180.0) {
+            anchor_plane(dist);
+            return false;
+        }
+
+        double predicted = (_p(0)*_ps_l + _p(1)*_ps_r) / 2.0;
+        Eigen::Vector3d H(_ps_l/2.0, _ps_r/2.0, 0.0);
+        double residual = (_plane_anchor - dist) - predicted;
+
+        bool updated = update(H, residual, _dist_var);
+
+        anchor_plane(dist);
+        return updated;
+    }
+
+    void lose_plane()
+    {
+        _has_plane_anchor = false;
+    }
+
+protected:
+
+    void anchor_heading(double theta)
+    {
+        _has_heading_anchor = true;
+        _heading_anchor = theta;
+        _hs_l = _hs_r = 0;
+    }
+
+    void anchor_plane(double dist)
+    {
+        _has_plane_anchor = true;
+        _plane_anchor = dist;
+        _ps_l = _ps_r = 0;
+    }
+
+    bool update(const Eigen::Vector3d& H, double residual, double variance)
+    {
+        Eigen::Vector3d PH = _P*H;
+        double S = _forgetting*variance + H.dot(PH);
+
+        //reject outliers beyond 3 sigma
+        if (residual*residual > 9.0*S)
+            return false;
+
+        Eigen::Vector3d K = PH / S;
+
+        _p += K*residual;
+        _P = (_P - K*PH.transpose()) / _forgetting;
+
+        //keep the estimate physically plausible
+        _p(0) = std::max(0.8, std::min(1.2, _p(0)));
+        _p(1) = std::max(0.8, std::min(1.2, _p(1)));
+        _p(2) = std::max(0.8*_nominal_wheel_distance, std::min(1.2*_nominal_wheel_distance, _p(2)));
+
+        return true;
+    }
+
+    static double wrap_angle(double a)
+    {
+        return std::atan2(std::sin(a), std::cos(a));
+    }
+
+    Eigen::Vector3d _p;
+    Eigen::Matrix3d _P;
+    double _nominal_wheel_distance;
+
+    double _forgetting;
+    double _heading_var, _dist_var;
+    double _min_heading_travel, _min_plane_travel;
+
+    bool _has_heading_anchor;
+    double _heading_anchor;
+    double _hs_l, _hs_r;
+
+    bool _has_plane_anchor;
+    double _plane_anchor;
+    double _ps_l, _ps_r;
+};
+
+}
+
+#endif // ODOMETRY_WHEEL_CALIBRATION_H
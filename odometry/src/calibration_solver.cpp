@@ -0,0 +1,256 @@
+#include <odometry/calibration_log.h>
+#include <Eigen/Core>
+#include <Eigen/Cholesky>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+
+/**
+  * Offline calibration of wheel scales and track width from recorded
+  * calibrator runs (see calibrator ... record).
+  *
+  * Every run is integrated from its start pose with the exact arc model and
+  * the end pose is compared against the true end pose. By default the true end
+  * pose is the start pose (closed square); it can be given per run in a text
+  * file <log>.truth containing "x y theta". The parameters p = (c_l, c_r, b)
+  * are fitted over all runs at once by Levenberg-Marquardt. The Jacobian of
+  * the end pose is propagated analytically along with the integration, so one
+  * iteration is a single pass over the ticks.
+  */
+
+//------------------------------------------------------------------------------
+// Members
+
+struct Run {
+    std::string name;
+    odometry::CalibrationLogHeader header;
+    std::vector<odometry::CalibrationTick> ticks;
+    Eigen::Vector3d truth;
+};
+
+const double SIGMA_POS = 0.02;
+const double SIGMA_THETA = 2.0*M_PI/180.0;
+const double SIGMA_PRIOR = 0.2;
+
+//------------------------------------------------------------------------------
+// Methods
+
+double wrap_angle(double a)
+{
+    return std::atan2(std::sin(a), std::cos(a));
+}
+
+/**
+  * Integrates a run with parameters p and returns the end pose and its
+  * Jacobian J = d(x,y,theta)/d(c_l,c_r,b).
+  */
+void integrate_run(const Run& run, const Eigen::Vector3d& p,
+                   Eigen::Vector3d& pose, Eigen::Matrix3d& J)
+{
+    const double c_l = p(0), c_r = p(1), b = p(2);
+    const double meter_per_tick = (2.0*M_PI*run.header.wheel_radius) / run.header.ticks_per_rev;
+
+    double x = run.header.start_x;
+    double y = run.header.start_y;
+    double theta = run.header.start_theta;
+
+    J.setZero();
+
+    for(size_t i = 0; i < run.ticks.size(); ++i)
+    {
+        const double nl = meter_per_tick * run.ticks[i].left;
+        const double nr = meter_per_tick * run.ticks[i].right;
+
+        const double dl = c_l*nl;
+        const double dr = c_r*nr;
+        const double dTheta = (dr - dl) / b;
+        const double dist = (dl + dr) / 2.0;
+
+        const double half = dTheta / 2.0;
+        const double sq = half*half;
+        double sinc, dsinc;
+        if (sq < 1e-6) {
+            sinc = 1.0 - sq/6.0;
+            dsinc = -half/3.0;
+        }
+        else {
+            sinc = std::sin(half)/half;
+            dsinc = (half*std::cos(half) - std::sin(half)) / sq;
+        }
+
+        const double mid = theta + half;
+        const double chord = dist*sinc;
+        const double c = std::cos(mid);
+        const double s = std::sin(mid);
+
+        //partial derivatives of the tick w.r.t. (c_l, c_r, b)
+        const double d_dTheta[3] = { -nl/b, nr/b, -dTheta/b };
+        const double d_dist[3] = { nl/2.0, nr/2.0, 0.0 };
+
+        for(int k = 0; k < 3; ++k)
+        {
+            double d_half = d_dTheta[k] / 2.0;
+            double d_mid = J(2,k) + d_half;
+            double d_chord = d_dist[k]*sinc + dist*dsinc*d_half;
+
+            J(0,k) += d_chord*c - chord*s*d_mid;
+            J(1,k) += d_chord*s + chord*c*d_mid;
+            J(2,k) += d_dTheta[k];
+        }
+
+        x += chord*c;
+        y += chord*s;
+        theta += dTheta;
+    }
+
+    pose << x, y, theta;
+}
+
+/**
+  * Accumulates the weighted normal equations over all runs and returns the
+  * cost. A weak prior towards the nominal parameters keeps the system well
+  * posed when runs do not excite all parameters.
+  */
+double build_normal_equations(const std::vector<Run>& runs, const Eigen::Vector3d& p,
+                              const Eigen::Vector3d& nominal,
+                              Eigen::Matrix3d& A, Eigen::Vector3d& g)
+{
+    const Eigen::Vector3d w(1.0/(SIGMA_POS*SIGMA_POS), 1.0/(SIGMA_POS*SIGMA_POS), 1.0/(SIGMA_THETA*SIGMA_THETA));
+
+    A.setZero();
+    g.setZero();
+    double cost = 0;
+
+    Eigen::Vector3d pose;
+    Eigen::Matrix3d J;
+
+    for(size_t i = 0; i < runs.size(); ++i)
+    {
+        integrate_run(runs[i], p, pose, J);
+
+        Eigen::Vector3d r = pose - runs[i].truth;
+        r(2) = wrap_angle(r(2));
+
+        A += J.transpose() * w.asDiagonal() * J;
+        g += J.transpose() * w.asDiagonal() * r;
+        cost += r.dot(w.asDiagonal() * r);
+    }
+
+    for(int k = 0; k < 3; ++k) {
+        double scale = (k == 2) ? nominal(2) : 1.0;
+        double w_prior = 1.0 / (SIGMA_PRIOR*scale*SIGMA_PRIOR*scale);
+        double r = p(k) - nominal(k);
+
+        A(k,k) += w_prior;
+        g(k) += w_prior*r;
+        cost += w_prior*r*r;
+    }
+
+    return cost;
+}
+
+Eigen::Vector3d solve(const std::vector<Run>& runs, const Eigen::Vector3d& nominal, int max_iterations,
+                      bool verbose)
+{
+    Eigen::Vector3d p = nominal;
+    Eigen::Matrix3d A;
+    Eigen::Vector3d g;
+
+    double lambda = 1e-3;
+    double cost = build_normal_equations(runs, p, nominal, A, g);
+
+    for(int it = 0; it < max_iterations; ++it)
+    {
+        Eigen::Matrix3d A_damped = A;
+        A_damped.diagonal() *= (1.0 + lambda);
+
+        Eigen::Vector3d step = A_damped.ldlt().solve(-g);
+        Eigen::Vector3d p_new = p + step;
+
+        Eigen::Matrix3d A_new;
+        Eigen::Vector3d g_new;
+        double cost_new = build_normal_equations(runs, p_new, nominal, A_new, g_new);
+
+        if (cost_new < cost) {
+            p = p_new; A = A_new; g = g_new;
+            lambda = std::max(lambda/10.0, 1e-9);
+
+            bool converged = (cost - cost_new) < 1e-9*cost;
+            cost = cost_new;
+
+            if (converged)
+                break;
+        }
+        else {
+            lambda *= 10.0;
+        }
+
+        if (verbose)
+            std::printf("iteration %d: cost %.6f, p = [%.5f %.5f %.5f]\n", it, cost, p(0), p(1), p(2));
+    }
+
+    return p;
+}
+
+bool load_run(const std::string& file_name, Run& run)
+{
+    run.name = file_name;
+    if (!odometry::read_calibration_log(file_name, run.header, run.ticks)) {
+        std::cerr << "Could not read calibration log " << file_name << std::endl;
+        return false;
+    }
+
+    run.truth << run.header.start_x, run.header.start_y, run.header.start_theta;
+
+    std::ifstream truth((file_name + ".truth").c_str());
+    if (truth.is_open())
+        truth >> run.truth(0) >> run.truth(1) >> run.truth(2);
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Entry point
+
+int main(int argc, char **argv)
+{
+    bool verbose = false;
+    int first = 1;
+    if (argc > 1 && std::string(argv[1]) == "--verbose") {
+        verbose = true;
+        first = 2;
+    }
+
+    if (argc <= first) {
+        std::cerr << "Usage: calibration_solver [--verbose] run.bin [run.bin ...]" << std::endl;
+        return 1;
+    }
+
+    std::vector<Run> runs;
+    runs.reserve(argc-first);
+    size_t num_ticks = 0;
+
+    for(int i = first; i < argc; ++i) {
+        Run run;
+        if (!load_run(argv[i], run))
+            return 1;
+
+        num_ticks += run.ticks.size();
+        runs.push_back(run);
+    }
+
+    Eigen::Vector3d nominal(1.0, 1.0, runs[0].header.wheel_distance);
+
+    std::clock_t start = std::clock();
+    Eigen::Vector3d p = solve(runs, nominal, 50, verbose);
+    double elapsed = (double)(std::clock() - start) / CLOCKS_PER_SEC;
+
+    std::printf("Fitted %lu runs with %lu ticks in %.3lf s\n", runs.size(), num_ticks, elapsed);
+    std::printf("/pose/odometry/calibration/c_l: %.6f\n", p(0));
+    std::printf("/pose/odometry/calibration/c_r: %.6f\n", p(1));
+    std::printf("/pose/odometry/calibration/wheel_distance: %.6f\n", p(2));
+
+    return 0;
+}
@@ -5,6 +5,9 @@
 #include <tf/transform_broadcaster.h>
 #include <std_msgs/Bool.h>
 #include <std_msgs/Float64.h>
+#include <odometry/arc_odometry.h>
+#include <odometry/calibration_log.h>
+#include <node_utils/diagnostics.h>
 
 #include <iostream>
 #include <fstream>
@@ -24,9 +27,39 @@ ros::Publisher _pub_fwd;
 
 int _phase;
 
+odometry::CalibrationLogWriter _log;
+
+node_utils::CallbackStats _stats_encoders("calibrator/encoders");
+
 //------------------------------------------------------------------------------
 // Methods
 
+/**
+  * Opens a binary log of all encoder deltas of this run, which can be
+  * fitted offline together with other runs by calibration_solver.
+  */
+bool open_log()
+{
+    std::stringstream filename;
+    filename << "calibration_" << ros::Time::now().toNSec() << ".bin";
+
+    odometry::CalibrationLogHeader header;
+    header.ticks_per_rev = robot::prop::ticks_per_rev;
+    header.wheel_radius = robot::dim::wheel_radius;
+    header.wheel_distance = robot::dim::wheel_distance;
+    header.start_x = _x;
+    header.start_y = _y;
+    header.start_theta = _theta;
+
+    if (!_log.open(filename.str(), header)) {
+        ROS_ERROR("[calibrator::open_log] Could not open %s", filename.str().c_str());
+        return false;
+    }
+
+    ROS_INFO("Recording encoder deltas to %s", filename.str().c_str());
+    return true;
+}
+
 int write_result(double x, double y, double theta)
 {
   using namespace std;
@@ -47,6 +80,7 @@ bool advance_phase() {
     if (_phase == 8) {
         ROS_ERROR("Finished round trip. Current odometry: [%lf, %lf, %lf]", _x, _y, _theta);
         write_result(_x,_y,_theta);
+        _log.close();
         ++_phase;
         return false;
     }
@@ -103,20 +137,22 @@ double sq_dist(double x0, double y0, double x1, double y1)
 }
 
 /**
-  * Adapter from http://simreal.com/content/Odometry
+  * Integrates along the exact arc, see arc_odometry.h
   */
-void callback_encoders(const ras_arduino_msgs::EncodersConstPtr& encoders)
+void callback_encoders(const ros::MessageEvent<ras_arduino_msgs::Encoders const>& event)
 {
     static tf::TransformBroadcaster pub_tf;
-    double dist_l = (2.0*M_PI*robot::dim::wheel_radius) * (-encoders->delta_encoder1 / robot::prop::ticks_per_rev);
-    double dist_r = (2.0*M_PI*robot::dim::wheel_radius) * (-encoders->delta_encoder2 / robot::prop::ticks_per_rev);
 
-    _theta += (dist_r - dist_l) / robot::dim::wheel_distance;
+    const ras_arduino_msgs::Encoders::ConstPtr& encoders = event.getMessage();
+    node_utils::CallbackTimer timer(_stats_encoders, event.getReceiptTime());
 
-    double dist = (dist_r + dist_l) / 2.0;
+    if (_log.is_open())
+        _log.write(-encoders->delta_encoder1, -encoders->delta_encoder2);
 
-    _x += dist * cos(_theta);
-    _y += dist * sin(_theta);
+    double dist_l = (2.0*M_PI*robot::dim::wheel_radius) * (-encoders->delta_encoder1 / robot::prop::ticks_per_rev);
+    double dist_r = (2.0*M_PI*robot::dim::wheel_radius) * (-encoders->delta_encoder2 / robot::prop::ticks_per_rev);
+
+    odometry::integrate_arc(dist_l, dist_r, robot::dim::wheel_distance, _x, _y, _theta);
 
     pack_pose(_q, _odom);
     _pub_odom.publish(_odom);
@@ -156,14 +192,17 @@ void callback_fwd_stopped(const std_msgs::BoolConstPtr& stopped)
 
 int main(int argc, char **argv)
 {
-    if (argc != 4) {
-        ROS_ERROR("Missing arguments. Expected: x y theta");
+    if (argc < 4) {
+        ROS_ERROR("Missing arguments. Expected: x y theta [record]");
         return 1;
     }
 
+    bool record = argc > 4 && strcmp(argv[4], "record") == 0;
+
     ros::init(argc, argv, "calibrator");
 
     ros::NodeHandle n;
+    node_utils::start_diagnostics();
 
     _odom.header.frame_id = "map";
 
@@ -172,6 +211,9 @@ int main(int argc, char **argv)
     _y = atof(argv[2]);
     _theta = atof(argv[3]);
 
+    if (record && !open_log())
+        return 1;
+
     ros::Subscriber sub_enc = n.subscribe("/arduino/encoders",10,callback_encoders);
     ros::Subscriber sub_turn_done = n.subscribe("/controller/turn/done",10,callback_turn_done);
     ros::Subscriber sub_fwd_done = n.subscribe("/controller/forward/stopped",10,callback_fwd_stopped);
@@ -1,3 +1,4 @@
+#include <odometry/pose_generator.h>
 #include <ros/ros.h>
 #include <ras_arduino_msgs/Encoders.h>
 #include <nav_msgs/Odometry.h>
@@ -9,9 +10,27 @@
 #include <std_msgs/Int8.h>
 #include <std_msgs/Time.h>
 #include <ir_converter/Distance.h>
-#include <common/parameter.h>
+#include <ir_converter/age_statistics.h>
+#include <node_utils/cached_parameter.h>
+#include <node_utils/trace.h>
+#include <node_utils/diagnostics.h>
+#include <node_utils/message_pool.h>
+#include <node_utils/realtime.h>
+#include <node_utils/allocation.h>
+#include <node_utils/log_limit.h>
+#include <node_utils/checkpoint.h>
+#include <navigation_msgs/PoseCheckpoint.h>
 #include <navigation_msgs/Raycast.h>
 #include <vision_msgs/Planes.h>
+#include <odometry/arc_odometry.h>
+#include <odometry/device_clock.h>
+#include <odometry/wheel_calibration.h>
+#include <odometry/gyro_heading.h>
+#include <geometry_msgs/Vector3.h>
+#include <geometry_msgs/Vector3Stamped.h>
+#include <boost/circular_buffer.hpp>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
 
 #define DEG2RAD(x) ((x)*M_PI/180.0)
 #define RAD2DEG(x) ((x)*180.0/M_PI)
@@ -19,20 +38,32 @@
 //------------------------------------------------------------------------------
 // Members
 
-Parameter<int> _max_iterations("/pose/odometry/num_correction_iterations",5);
-Parameter<bool> _enable_lateral_correction("/pose/odometry/correction/lateral_enabled",false);
-Parameter<bool> _enable_theta_correction("/pose/odometry/correction/theta_enabled",false);
-Parameter<int> _revert_last_msec("/pose/odometry/revert_last_msec",100);
+CachedParameter<int> _max_iterations("/pose/odometry/num_correction_iterations",5);
+CachedParameter<bool> _enable_lateral_correction("/pose/odometry/correction/lateral_enabled",false);
+CachedParameter<bool> _enable_theta_correction("/pose/odometry/correction/theta_enabled",false);
+CachedParameter<int> _revert_last_msec("/pose/odometry/revert_last_msec",100);
+CachedParameter<bool> _use_device_stamps("/pose/odometry/use_device_stamps",true);
+CachedParameter<bool> _online_calibration("/pose/odometry/calibration/online",false);
+CachedParameter<double> _calibration_max_wall_distance("/pose/odometry/calibration/max_wall_distance",0.3);
+CachedParameter<double> _calibration_max_turn_rate("/pose/odometry/calibration/max_turn_rate",DEG2RAD(5.0));
+CachedParameter<double> _calibration_c_l("/pose/odometry/calibration/c_l",1.0);
+CachedParameter<double> _calibration_c_r("/pose/odometry/calibration/c_r",1.0);
+CachedParameter<double> _calibration_wheel_distance("/pose/odometry/calibration/wheel_distance",robot::dim::wheel_distance);
+CachedParameter<double> _ir_max_age("/pose/odometry/ir_max_age",0.2);
+CachedParameter<double> _gyro_weight("/pose/odometry/gyro_weight",0.8);
+CachedParameter<double> _gyro_max_lag("/pose/odometry/gyro_max_lag",0.02);
 
 ros::NodeHandlePtr _handle;
-ros::Timer _timer;
 
 double _x,_y,_theta;
+ros::Time _stamp;
 tf::Quaternion _q;
 nav_msgs::Odometry _odom;
 
 //ir_converter::Distance _ir_dist;
 Eigen::Matrix<double,4,1> _ir_dist;
+ir_converter::AgeStatistics _ir_age("ir_converter -> pose_generator");
+double _ir_max_age_sec;
 bool _correct_theta, _correct_lateral;
 int _iteration_theta, _iteration_lateral;
 double _turn_accum;
@@ -44,14 +75,63 @@ vision_msgs::Plane _front_plane;
 ros::Publisher _pub_odom;
 ros::Publisher _pub_viz;
 ros::Publisher _pub_compass;
+ros::Publisher _pub_calibration;
 ros::ServiceClient _srv_raycast;
 
-std::vector<ras_arduino_msgs::Encoders> _ringbuffer;
+//recycled messages of the per tick publishers
+node_utils::MessagePool<nav_msgs::Odometry> _pool_odom;
+node_utils::MessagePool<visualization_msgs::Marker> _pool_marker;
+
+ros::Subscriber _sub_enc;
+ros::Subscriber _sub_turn_angle;
+ros::Subscriber _sub_turn_done;
+ros::Subscriber _sub_ir;
+ros::Subscriber _sub_planes;
+ros::Subscriber _sub_crash;
+ros::Subscriber _sub_yaw;
+
+node_utils::CallbackStats _stats_encoders("pose_generator/encoders");
+node_utils::CallbackStats _stats_ir("pose_generator/ir");
+node_utils::CallbackStats _stats_planes("pose_generator/planes");
+node_utils::CallbackStats _stats_yaw("pose_generator/yaw");
+node_utils::CallbackStats _stats_crash("pose_generator/crash");
+
+//messages of normal operation that would flood the log at error level
+node_utils::LogSite _log_revert("pose_generator/revert");
+node_utils::LogSite _log_plane_distance("pose_generator/plane_distance");
+node_utils::LogSite _log_x_diff("pose_generator/x_diff");
+node_utils::LogSite _log_wall_attempt("pose_generator/wall_attempt");
+node_utils::LogSite _log_wall_correction("pose_generator/wall_correction");
+
+/**
+  * Displacements as they were applied to the pose, together with
+  * the time they were sampled at.
+  */
+struct OdometryTick {
+    ros::Time stamp;
+    double dist, dTheta;
+};
+
+boost::circular_buffer<OdometryTick> _ringbuffer;
 int _ringbuffer_max_size = 50*2;
 
+odometry::DeviceClock _device_clock;
+
+odometry::WheelCalibration _calibration;
+bool _calibrate_online;
+//between /controller/turn/angle and /controller/turn/done
+bool _turning;
+
+odometry::GyroHeading _gyro;
+
 bool _mute = false;
+ros::Time _mute_until;
 double _muting_time = 1.0;
 
+bool save_checkpoint(const std::string& file_name);
+bool restore_checkpoint(const std::string& file_name);
+node_utils::CheckpointPart _checkpoint("pose", save_checkpoint, restore_checkpoint);
+
 //------------------------------------------------------------------------------
 // Methods
 
@@ -62,7 +142,7 @@ void pack_pose(tf::Quaternion& q, nav_msgs::Odometry& odom)
 {
     q.setRPY(0, 0, _theta);
 
-    odom.header.stamp = ros::Time::now();
+    odom.header.stamp = _stamp;
 
     odom.pose.pose.position.x = _x;
     odom.pose.pose.position.y = _y;
@@ -73,58 +153,102 @@ void pack_pose(tf::Quaternion& q, nav_msgs::Odometry& odom)
     odom.pose.pose.orientation.w = q.w();
 }
 
-//------------------------------------------------------------------------------
-// Callbacks
+/**
+  * Packs the current wheel calibration as (c_l, c_r, wheel_distance).
+  */
+void pack_calibration(geometry_msgs::Vector3& msg)
+{
+    msg.x = _calibration.c_l();
+    msg.y = _calibration.c_r();
+    msg.z = _calibration.wheel_distance();
+}
 
-void callback_timer(const ros::TimerEvent& event)
+/**
+  * Saved from the callback queue like the encoder ticks, so the state is
+  * consistent without a lock.
+  */
+bool save_checkpoint(const std::string& file_name)
 {
-    _mute = false;
-    ROS_ERROR("[PoseGenerator::callback_timer] Enabling encoder readings");
+    navigation_msgs::PoseCheckpoint msg;
+    msg.x = _x;
+    msg.y = _y;
+    msg.theta = _theta;
+    msg.heading = _heading;
+    msg.turn_accum = _turn_accum;
+    msg.c_l = _calibration.c_l();
+    msg.c_r = _calibration.c_r();
+    msg.wheel_distance = _calibration.wheel_distance();
+    return node_utils::write_message(file_name, msg);
 }
 
-void revert_applied_readings_since(const ros::Time& time)
+bool restore_checkpoint(const std::string& file_name)
 {
-    int msec = (int)(time.toNSec()/1000l) - _revert_last_msec();
+    navigation_msgs::PoseCheckpoint msg;
+    if (!node_utils::read_message(file_name, msg))
+        return false;
+
+    //a run that starts at the start position again only keeps the calibration
+    bool restore_pose = true;
+    ros::param::get("/checkpoint/restore_pose", restore_pose);
+    if (restore_pose) {
+        _x = msg.x;
+        _y = msg.y;
+        _theta = msg.theta;
+        _heading = msg.heading;
+        _turn_accum = msg.turn_accum;
+    }
 
-    int k = 0;
+    _calibration.reset(msg.c_l, msg.c_r, msg.wheel_distance);
+    return true;
+}
 
-    for(std::vector<ras_arduino_msgs::Encoders>::reverse_iterator it = _ringbuffer.rbegin(); it != _ringbuffer.rend(); ++it)
-    {
-        ras_arduino_msgs::Encoders& enc = *it;
-        if (enc.timestamp >= msec)
-        {
-            ++k;
+void publish_calibration()
+{
+    geometry_msgs::Vector3 msg;
+    pack_calibration(msg);
+    _pub_calibration.publish(msg);
+}
 
-            double dist_l = (2.0*M_PI*robot::dim::wheel_radius) * (enc.delta_encoder1 / robot::prop::ticks_per_rev);
-            double dist_r = (2.0*M_PI*robot::dim::wheel_radius) * (enc.delta_encoder2 / robot::prop::ticks_per_rev);
+//------------------------------------------------------------------------------
+// Callbacks
+
+void revert_applied_readings_since(const ros::Time& time)
+{
+    ros::Time since = time - ros::Duration(_revert_last_msec()/1000.0);
 
-            _theta += (dist_r - dist_l) / robot::dim::wheel_distance;
+    int k = 0;
 
-            double dist = (dist_r + dist_l) / 2.0;
+    //ticks are stored in chronological order, so undo them from the back
+    while (!_ringbuffer.empty() && _ringbuffer.back().stamp >= since)
+    {
+        const OdometryTick& tick = _ringbuffer.back();
 
-            _x += dist * cos(_theta);
-            _y += dist * sin(_theta);
+        odometry::integrate_arc_turn(-tick.dist, -tick.dTheta, _x, _y, _theta);
 
-            //remove reading
-            _ringbuffer.erase(--it.base());
-        }
+        _ringbuffer.pop_back();
+        ++k;
     }
 
-    ROS_ERROR("[PoseGenerator::revertReadingsSince] Reverted %d readings.",k);
+    LOG_INFO_LIMITED(_log_revert, "[PoseGenerator::revertReadingsSince] Reverted %d readings.",k);
 }
 
 void callback_crash(const std_msgs::TimeConstPtr& time)
 {
+    node_utils::CallbackTimer timer(_stats_crash);
+
     _mute = true;
 
     revert_applied_readings_since(time->data);
-    _timer = _handle->createTimer(ros::Duration(_muting_time), callback_timer, true, true );
+    _calibration.reset_anchors();
+    _gyro.reset_tick();
+    _mute_until = ros::Time::now() + ros::Duration(_muting_time);
 
     ROS_ERROR("[PoseGenerator::callbackCrash] Crash signal received. Will mute encoder readings for %.2lf seconds", _muting_time);
 }
 
 void send_marker(tf::Transform& transform) {
-    visualization_msgs::Marker _robot_marker;
+    visualization_msgs::MarkerPtr marker = _pool_marker.acquire();
+    visualization_msgs::Marker& _robot_marker = *marker;
     _robot_marker.header.frame_id = "robot";
     _robot_marker.header.stamp = _odom.header.stamp;
     _robot_marker.ns = "robot";
@@ -146,16 +270,39 @@ void send_marker(tf::Transform& transform) {
     _robot_marker.color.g = 141.0 / 255.0;
     _robot_marker.color.b = 240.0 / 255.0;
 
-    _pub_viz.publish(_robot_marker);
+    _pub_viz.publish(marker);
 }
 
-void ringbuffer_push(const ras_arduino_msgs::Encoders& encoders)
+void ringbuffer_push(const ros::Time& stamp, double dist, double dTheta)
 {
-    if (_ringbuffer.size() >= _ringbuffer_max_size)
-    {
-        _ringbuffer.erase(_ringbuffer.begin());
+    OdometryTick tick;
+    tick.stamp = stamp;
+    tick.dist = dist;
+    tick.dTheta = dTheta;
+
+    //circular buffer overwrites the oldest tick when full
+    _ringbuffer.push_back(tick);
+}
+
+/**
+  * Mean turn rate in rad/s over the ticks of the last window seconds.
+  */
+double recent_turn_rate(double window)
+{
+    if (_ringbuffer.empty())
+        return 0.0;
+
+    const ros::Time& last = _ringbuffer.back().stamp;
+    double dTheta = 0.0;
+    ros::Time first = last;
+    for(boost::circular_buffer<OdometryTick>::const_reverse_iterator it = _ringbuffer.rbegin();
+        it != _ringbuffer.rend() && (last - it->stamp).toSec() <= window; ++it) {
+        dTheta += it->dTheta;
+        first = it->stamp;
     }
-    _ringbuffer.push_back(encoders);
+
+    double span = (last - first).toSec();
+    return span > 0 ? dTheta/span : 0.0;
 }
 
 int get_compass()
@@ -203,44 +350,81 @@ void update_heading(double dTheta)
 //        ROS_ERROR("%s",ss.str().c_str());
 
         if (_heading != prev_heading) {
+            node_utils::AllowAllocations allow;
             std_msgs::Int8 msg;
             msg.data = get_compass();
             _pub_compass.publish(msg);
         }
 }
 
+void callback_yaw(const geometry_msgs::Vector3StampedConstPtr& yaw)
+{
+    node_utils::CallbackTimer timer(_stats_yaw);
+
+    _gyro.add(yaw->header.stamp, yaw->vector.x);
+}
+
 /**
-  * Adapter from http://simreal.com/content/Odometry
+  * Integrates the wheel displacements along the exact arc (see arc_odometry.h)
+  * and stamps the pose with the time the arduino sampled the encoders. Every
+  * tick starts a trace, identified by the stamp of the pose.
   */
-void callback_encoders(const ras_arduino_msgs::EncodersConstPtr& encoders)
+void callback_encoders(const ros::MessageEvent<ras_arduino_msgs::Encoders const>& event)
 {
     static tf::TransformBroadcaster pub_tf;
 
-    if (!_mute) {
+    const ras_arduino_msgs::Encoders::ConstPtr& encoders = event.getMessage();
+    node_utils::CallbackTimer timer(_stats_encoders, event.getReceiptTime());
 
-        double c_l = 1.0;//0.98416;
-        double c_r = 1.0;//1.0538;
+    node_utils::TraceSpan span("pose_generator/encoders");
 
-        double dist_l = c_l * (2.0*M_PI*robot::dim::wheel_radius) * (-encoders->delta_encoder1 / robot::prop::ticks_per_rev);
-        double dist_r = c_r * (2.0*M_PI*robot::dim::wheel_radius) * (-encoders->delta_encoder2 / robot::prop::ticks_per_rev);
+    ros::Time receipt = ros::Time::now();
+    if (_use_device_stamps())
+        _stamp = _device_clock.to_ros(encoders->timestamp, receipt);
+    else
+        _stamp = receipt;
+    span.set_trace_id(node_utils::trace_id(_stamp));
 
-        double dTheta = (dist_r - dist_l) / robot::dim::wheel_distance;
-        update_heading(dTheta);
+    //checked here rather than with a timer so that replays are deterministic
+    if (_mute && receipt >= _mute_until) {
+        _mute = false;
+        ROS_ERROR("[PoseGenerator::callback_encoders] Enabling encoder readings");
+    }
 
-        _theta += dTheta;
+    if (!_mute) {
+        NO_ALLOCATION_REGION("pose_generator/integrate");
+
+        double nominal_l = (2.0*M_PI*robot::dim::wheel_radius) * (-encoders->delta_encoder1 / robot::prop::ticks_per_rev);
+        double nominal_r = (2.0*M_PI*robot::dim::wheel_radius) * (-encoders->delta_encoder2 / robot::prop::ticks_per_rev);
+
+        _calibration.accumulate(nominal_l, nominal_r);
+
+        double dist_l = _calibration.c_l() * nominal_l;
+        double dist_r = _calibration.c_r() * nominal_r;
+        double wheel_distance = _calibration.wheel_distance();
 
         double dist = (dist_r + dist_l) / 2.0;
+        double dTheta = (dist_r - dist_l) / wheel_distance;
+
+        //blend in the gyro where it covers the whole tick
+        double dYaw;
+        _gyro.set_max_lag(_gyro_max_lag());
+        if (_gyro.tick(_stamp, dYaw)) {
+            double w = _gyro_weight();
+            dTheta = w*dYaw + (1.0-w)*dTheta;
+        }
+
+        update_heading(dTheta);
 
-        _x += dist * cos(_theta);
-        _y += dist * sin(_theta);
+        odometry::integrate_arc_turn(dist, dTheta, _x, _y, _theta);
 
-        ras_arduino_msgs::Encoders fixed = *encoders;
-        fixed.timestamp = (int)(ros::Time::now().toNSec()/1000l);
-        ringbuffer_push(fixed);
+        ringbuffer_push(_stamp, dist, dTheta);
     }
 
     pack_pose(_q, _odom);
-    _pub_odom.publish(_odom);
+    nav_msgs::OdometryPtr odom = _pool_odom.acquire();
+    *odom = _odom;
+    _pub_odom.publish(odom);
 
     tf::Transform transform;
     transform.setOrigin(tf::Vector3(_x, _y, 0));
@@ -256,6 +440,13 @@ void connect_odometry_callback(const ros::SingleSubscriberPublisher& pub)
     pub.publish(_odom);
 }
 
+void connect_calibration_callback(const ros::SingleSubscriberPublisher& pub)
+{
+    geometry_msgs::Vector3 msg;
+    pack_calibration(msg);
+    pub.publish(msg);
+}
+
 void connect_compass_callback(const ros::SingleSubscriberPublisher& pub)
 {
     std_msgs::Int8 msg;
@@ -395,7 +586,7 @@ double get_x_diff()
         double dist_to_obstacle;
         if (request_raycast(0,0,1,0,dist_to_obstacle))
         {
-            ROS_ERROR("Dist to obstacle: %.3lf, to plane: %.3lf",dist_to_obstacle, dist_to_plane);
+            LOG_INFO_LIMITED(_log_plane_distance, "[PoseGenerator::get_x_diff] Dist to obstacle: %.3lf, to plane: %.3lf",dist_to_obstacle, dist_to_plane);
             return dist_to_obstacle - dist_to_plane;
         }
         else {
@@ -406,8 +597,53 @@ double get_x_diff()
         return std::numeric_limits<double>::quiet_NaN();
 }
 
+/**
+  * Feeds the heading measured from a close side wall into the online
+  * calibration. Walls are assumed to be aligned with the compass directions,
+  * and the snapped compass heading is only the heading of the robot while it
+  * drives along one. So nothing is observed during turns, and only with both
+  * sensors of one side on a close wall.
+  */
+void observe_wall_heading(Eigen::Matrix<double,4,1>& m)
+{
+    if (_turning || std::abs(recent_turn_rate(0.2)) > _calibration_max_turn_rate())
+        return;
+
+    double max_dist = _calibration_max_wall_distance();
+    double dy;
+    if (m(0,0) < max_dist && m(1,0) < max_dist)
+        dy = -(m(0,0) - m(1,0));
+    else if (m(2,0) < max_dist && m(3,0) < max_dist)
+        dy = m(2,0) - m(3,0);
+    else
+        return;
+
+    double dx = robot::ir::offset_front_left_forward + robot::ir::offset_rear_left_forward;
+
+    double angle = atan(dy/dx);
+    if (RAD2DEG(std::abs(angle)) > 10.0)
+        return;
+
+    if (_calibration.observe_heading(_heading*M_PI_2 + angle))
+        publish_calibration();
+}
+
 void callback_ir(const ir_converter::DistanceConstPtr& distances)
 {
+    node_utils::CallbackTimer timer(_stats_ir);
+
+    ros::Time now = ros::Time::now();
+    _ir_age.add(distances->header.stamp, now);
+
+    //a stale reading does not describe the current pose any more
+    if ((now - distances->header.stamp).toSec() > _ir_max_age_sec)
+        return;
+
+    if (_calibrate_online) {
+        Eigen::Matrix<double,4,1> m = pack_matrix(distances);
+        observe_wall_heading(m);
+    }
+
     if (_correct_theta)
     {
         _ir_dist += pack_matrix(distances);
@@ -442,6 +678,8 @@ void callback_ir(const ir_converter::DistanceConstPtr& distances)
 
 void callback_turn_done(const std_msgs::BoolConstPtr& done)
 {
+    _turning = false;
+
     double dx = robot::ir::offset_front_left_forward + robot::ir::offset_rear_left_forward;
     double dy = get_dy(_ir_dist);
 
@@ -460,18 +698,14 @@ void callback_turn_done(const std_msgs::BoolConstPtr& done)
 
 void callback_turn_angle(const std_msgs::Float64ConstPtr& angle)
 {
-
+    _turning = true;
 }
 
 double _avg_plane_dist;
 int _accumulated_plane_dists;
 void callback_planes(const vision_msgs::PlanesConstPtr& planes)
 {
-    if (!_correct_lateral) {
-        _avg_plane_dist = 0;
-        _accumulated_plane_dists = 0;
-        return;
-    }
+    node_utils::CallbackTimer timer(_stats_planes);
 
     //find wall that is perpendicular to the robots direction
     double max_dot = 0.0;
@@ -493,6 +727,21 @@ void callback_planes(const vision_msgs::PlanesConstPtr& planes)
         }
     }
 
+    if (_calibrate_online) {
+        if (max_dot > 0.9) {
+            if (_calibration.observe_plane_distance(planes->planes[ortho_plane].bounding_box[0]))
+                publish_calibration();
+        }
+        else
+            _calibration.lose_plane();
+    }
+
+    if (!_correct_lateral) {
+        _avg_plane_dist = 0;
+        _accumulated_plane_dists = 0;
+        return;
+    }
+
     if (max_dot > 0.9) {
         _front_plane = planes->planes[ortho_plane];
         _see_front_plane = true;
@@ -500,7 +749,7 @@ void callback_planes(const vision_msgs::PlanesConstPtr& planes)
         _iteration_lateral++;
 
         double x_diff = get_x_diff();
-        ROS_ERROR("x diff = %.3lf",x_diff);
+        LOG_INFO_LIMITED(_log_x_diff, "[PoseGenerator::callback_planes] x diff = %.3lf",x_diff);
 
         if (!std::isnan(x_diff)) {
             _avg_plane_dist += x_diff;
@@ -513,7 +762,7 @@ void callback_planes(const vision_msgs::PlanesConstPtr& planes)
 
                 double avg_diff = _avg_plane_dist / (double)_accumulated_plane_dists;
 
-                ROS_ERROR("Attempt to correct position based on wall");
+                LOG_INFO_LIMITED(_log_wall_attempt, "[PoseGenerator::callback_planes] Attempt to correct position based on wall");
 
                 if (std::abs(avg_diff) < 0.1) {
                     double dx = cos(_theta);
@@ -522,7 +771,7 @@ void callback_planes(const vision_msgs::PlanesConstPtr& planes)
                     double new_x = _x + avg_diff*dx;
                     double new_y = _y + avg_diff*dy;
 
-                    ROS_ERROR("corrected position (%.3lf,%.3lf) -> (%.3lf,%.3lf)", _x, _y, new_x, new_y);
+                    LOG_INFO_LIMITED(_log_wall_correction, "[PoseGenerator::callback_planes] corrected position (%.3lf,%.3lf) -> (%.3lf,%.3lf)", _x, _y, new_x, new_y);
 
                     _x = new_x;
                     _y = new_y;
@@ -543,41 +792,87 @@ void callback_planes(const vision_msgs::PlanesConstPtr& planes)
 }
 
 //------------------------------------------------------------------------------
-// Entry point
+// Setup
 
-int main(int argc, char **argv)
+void setup_pose_generator(ros::NodeHandle& handle)
 {
-    ros::init(argc, argv, "pose_generator");
+    node_utils::start_parameter_updates();
+    node_utils::start_trace_export();
+    node_utils::start_diagnostics();
 
-    _handle = ros::NodeHandlePtr(new ros::NodeHandle(""));
+    _handle = ros::NodeHandlePtr(new ros::NodeHandle(handle));
 
     _odom.header.frame_id = "map";
     _x = _y = 0;
     _theta = 0;
+    _stamp = ros::Time::now();
     _correct_theta = false;
     _correct_lateral = false;
     _iteration_theta = 0; _iteration_lateral = 0;
     _turn_accum = 0;
     _heading = 0;
+    _turning = false;
 
     _see_front_plane = false;
 
-    _ringbuffer.reserve(_ringbuffer_max_size);
+    _ringbuffer.set_capacity(_ringbuffer_max_size);
+
+    _calibration.reset(_calibration_c_l(), _calibration_c_r(), _calibration_wheel_distance());
+    _calibrate_online = _online_calibration();
+    _ir_max_age_sec = _ir_max_age();
 
-    ros::Subscriber sub_enc = _handle->subscribe("/arduino/encoders",10,callback_encoders);
-    ros::Subscriber sub_turn_angle = _handle->subscribe("/controller/turn/angle",10,callback_turn_angle);
-    ros::Subscriber sub_turn_done = _handle->subscribe("/controller/turn/done",10,callback_turn_done);
-    ros::Subscriber sub_ir = _handle->subscribe("/perception/ir/distance",10,callback_ir);
-    ros::Subscriber sub_planes = _handle->subscribe("/vision/obstacles/planes",10,callback_planes);
-    ros::Subscriber sub_crash = _handle->subscribe("/perception/imu/peak", 10, callback_crash);
+    //before anything subscribes, so the first pose published is the restored one
+    _checkpoint.restore();
+
+    _sub_enc = _handle->subscribe("/arduino/encoders",10,callback_encoders);
+    _sub_turn_angle = _handle->subscribe("/controller/turn/angle",10,callback_turn_angle);
+    _sub_turn_done = _handle->subscribe("/controller/turn/done",10,callback_turn_done);
+    _sub_ir = _handle->subscribe("/perception/ir/distance",1,callback_ir,ros::TransportHints().tcpNoDelay());
+    _sub_planes = _handle->subscribe("/vision/obstacles/planes",10,callback_planes);
+    _sub_crash = _handle->subscribe("/perception/imu/peak", 10, callback_crash);
+    _sub_yaw = _handle->subscribe("/perception/imu/yaw", 50, callback_yaw, ros::TransportHints().tcpNoDelay());
 
     _pub_odom = _handle->advertise<nav_msgs::Odometry>("/pose/odometry/",10,(ros::SubscriberStatusCallback)connect_odometry_callback);
     _pub_viz = _handle->advertise<visualization_msgs::Marker>( "visualization_marker", 0 );
     _pub_compass = _handle->advertise<std_msgs::Int8>("/pose/compass", 10, (ros::SubscriberStatusCallback)connect_compass_callback);
+    _pub_calibration = _handle->advertise<geometry_msgs::Vector3>("/pose/odometry/calibration", 10, (ros::SubscriberStatusCallback)connect_calibration_callback);
 
     _srv_raycast = _handle->serviceClient<navigation_msgs::Raycast>("/mapping/raycast");
 
-    ros::spin();
+    _checkpoint.start(*_handle);
+    _checkpoint.ready();
+}
+
+//------------------------------------------------------------------------------
+// Nodelet
+
+namespace odometry {
+
+class PoseGeneratorNodelet : public nodelet::Nodelet
+{
+public:
+    virtual void onInit()
+    {
+        node_utils::RealtimeProfile profile;
+        profile.load(getPrivateNodeHandle());
+
+        //with a real-time profile the callbacks leave the manager's thread pool
+        ros::NodeHandle handle = getNodeHandle();
+        if (profile.enabled) {
+            _spinner.reset(new node_utils::RealtimeSpinner(profile, getName()));
+            handle.setCallbackQueue(_spinner->queue());
+        }
+
+        setup_pose_generator(handle);
+
+        if (_spinner)
+            _spinner->start();
+    }
+
+private:
+    boost::shared_ptr<node_utils::RealtimeSpinner> _spinner;
+};
 
-    return 0;
 }
+
+PLUGINLIB_EXPORT_CLASS(odometry::PoseGeneratorNodelet, nodelet::Nodelet)
@@ -0,0 +1,18 @@
+#include <odometry/pose_generator.h>
+#include <node_utils/realtime.h>
+
+//------------------------------------------------------------------------------
+// Entry point
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "pose_generator");
+
+    ros::NodeHandle handle("");
+    setup_pose_generator(handle);
+    node_utils::setup_realtime_main("pose_generator");
+
+    ros::spin();
+
+    return 0;
+}
@@ -0,0 +1,342 @@
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <topic_tools/shape_shifter.h>
+#include <nav_msgs/Odometry.h>
+#include <nav_msgs/OccupancyGrid.h>
+#include <navigation_msgs/Graph.h>
+#include <tf/transform_datatypes.h>
+#include <imu/imu.h>
+#include <ir_converter/ir_converter.h>
+#include <odometry/pose_generator.h>
+#include <mapping/mapping.h>
+#include <navigation/graph_node.h>
+#include <node_utils/trace.h>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/function.hpp>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+  * Replays a recorded run through the sensor chain without the robot.
+  *
+  * imu, ir_converter, pose_generator, mapping and graph run in this process
+  * on the global callback queue, with their transform listeners on that
+  * queue as well. The recorded streams are published in bag order under
+  * simulated time, and after every message all resulting callbacks are run
+  * to completion before the clock moves on. The periodic tasks the nodes
+  * run on their executors are called on the same thread at their rates of
+  * simulated time. Nothing waits for the wall
+  * clock, so the run is as fast as the CPU allows and gives the same result
+  * every time.
+  *
+  * Outputs in the output directory:
+  *   poses.csv      stamp x y theta of every /pose/odometry message
+  *   graph.bag      final graph on /graph/save (usable as input for p2)
+  *   summary.txt    map and graph hash, final pose and throughput
+  *   trace.json     spans of all nodes, if /trace/enabled is set
+  *
+  * Usage: roslaunch replay replay.launch bag:=run.bag [out:=dir] [phase:=p2]
+  */
+
+//------------------------------------------------------------------------------
+// Members
+
+const char* REPLAYED_TOPICS[] = {
+    "/arduino/adc",
+    "/arduino/encoders",
+    "/imu/data_raw",
+    "/vision/obstacles/planes",
+    "/perception/imu/active",
+    "/mapping/active",
+    "/controller/turn/angle",
+    "/controller/turn/done",
+};
+
+/**
+  * A periodic task of the nodes, see add_mapping_tasks and add_graph_tasks.
+  */
+struct Scheduled {
+    double period;
+    ros::Time next;
+    boost::function<void ()> task;
+};
+
+std::ofstream _poses;
+bool _have_pose = false;
+nav_msgs::Odometry _last_pose;
+nav_msgs::OccupancyGridConstPtr _last_map;
+
+//------------------------------------------------------------------------------
+// Callbacks
+
+void callback_odometry(const nav_msgs::OdometryConstPtr& odom)
+{
+    _have_pose = true;
+    _last_pose = *odom;
+
+    char line[128];
+    snprintf(line, sizeof(line), "%.6f %.6f %.6f %.6f\n",
+             odom->header.stamp.toSec(), odom->pose.pose.position.x, odom->pose.pose.position.y,
+             tf::getYaw(odom->pose.pose.orientation));
+    _poses << line;
+}
+
+void callback_map(const nav_msgs::OccupancyGridConstPtr& map)
+{
+    _last_map = map;
+}
+
+/**
+  * Mapping needs the first pose.
+  */
+void integrate_mapping(Mapping* mapping)
+{
+    if (_have_pose)
+        mapping->integrate();
+}
+
+//------------------------------------------------------------------------------
+// Methods
+
+/**
+  * Runs all queued callbacks, including the ones they queue in turn.
+  */
+void drain()
+{
+    ros::CallbackQueue* queue = ros::getGlobalCallbackQueue();
+    while (!queue->isEmpty())
+        queue->callAvailable();
+}
+
+/**
+  * 64 bit FNV-1a.
+  */
+uint64_t hash_bytes(const uint8_t* data, size_t size, uint64_t hash = 14695981039346656037ULL)
+{
+    for(size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+uint64_t hash_graph(const navigation_msgs::Graph& graph)
+{
+    uint32_t size = ros::serialization::serializationLength(graph);
+    std::vector<uint8_t> buffer(size);
+    ros::serialization::OStream stream(buffer.empty() ? NULL : &buffer[0], size);
+    ros::serialization::serialize(stream, graph);
+    return hash_bytes(buffer.empty() ? NULL : &buffer[0], size);
+}
+
+uint64_t hash_map(const nav_msgs::OccupancyGridConstPtr& map)
+{
+    if (!map || map->data.empty())
+        return 0;
+    return hash_bytes((const uint8_t*)&map->data[0], map->data.size());
+}
+
+/**
+  * Waits (in wall time) until the replayed topics are connected to the
+  * nodes in this process, since messages published before are lost.
+  */
+void wait_for_connections(std::map<std::string, ros::Publisher>& pubs, double timeout)
+{
+    ros::WallTime start = ros::WallTime::now();
+    bool connected = false;
+
+    while (!connected && (ros::WallTime::now() - start).toSec() < timeout)
+    {
+        connected = true;
+        for(std::map<std::string, ros::Publisher>::iterator it = pubs.begin(); it != pubs.end(); ++it)
+            connected &= it->second.getNumSubscribers() > 0;
+
+        drain();
+        ros::WallDuration(0.01).sleep();
+    }
+
+    //links between the nodes themselves are set up in the same way
+    ros::WallTime settle = ros::WallTime::now();
+    while ((ros::WallTime::now() - settle).toSec() < 1.0) {
+        drain();
+        ros::WallDuration(0.01).sleep();
+    }
+
+    if (!connected)
+        ROS_ERROR("[replay] Not all replayed topics have a subscriber, their messages are dropped.");
+}
+
+//------------------------------------------------------------------------------
+// Entry point
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "replay");
+
+    std::vector<std::string> args;
+    ros::removeROSArgs(argc, argv, args);
+
+    if (args.size() < 2) {
+        std::cerr << "Usage: replay run.bag [out_dir] [p2]" << std::endl;
+        return 1;
+    }
+
+    std::string bag_name = args[1];
+    std::string out_dir = args.size() > 2 ? args[2] : ".";
+    bool p2 = args.size() > 3 && args[3] == "p2";
+
+    //the corrections call the raycast service of mapping, which would block this single thread
+    ros::param::set("/pose/odometry/correction/lateral_enabled", false);
+    ros::param::set("/pose/odometry/correction/theta_enabled", false);
+
+    rosbag::Bag bag;
+    try {
+        bag.open(bag_name, rosbag::bagmode::Read);
+    } catch (rosbag::BagException& ex) {
+        ROS_ERROR("[replay] %s", ex.what());
+        return 1;
+    }
+
+    std::vector<std::string> topics(REPLAYED_TOPICS, REPLAYED_TOPICS + sizeof(REPLAYED_TOPICS)/sizeof(REPLAYED_TOPICS[0]));
+    if (p2)
+        topics.push_back("/graph/save");
+
+    rosbag::View view(bag, rosbag::TopicQuery(topics));
+    if (view.size() == 0) {
+        ROS_ERROR("[replay] %s contains none of the replayed topics", bag_name.c_str());
+        return 1;
+    }
+
+    ros::Time::setNow(view.getBeginTime());
+
+    _poses.open((out_dir + "/poses.csv").c_str());
+
+    ros::NodeHandle n;
+
+    setup_imu(n);
+    IRConverter ir_converter(n);
+    setup_pose_generator(n);
+    Mapping mapping(n, false);
+    if (p2)
+        mapping.recoverAndRefreshOccGrid(Mapping::MAP_NAME);
+    setup_graph(n, p2, false);
+
+    ros::Subscriber sub_odom = n.subscribe("/pose/odometry", 100, callback_odometry);
+    ros::Subscriber sub_map = n.subscribe("/mapping/occupancy_grid", 1, callback_map);
+
+    std::map<std::string, ros::Publisher> pubs;
+    BOOST_FOREACH(const rosbag::ConnectionInfo* info, view.getConnections())
+    {
+        if (pubs.count(info->topic))
+            continue;
+        ros::AdvertiseOptions opts(info->topic, 100, info->md5sum, info->datatype, info->msg_def);
+        pubs[info->topic] = n.advertise(opts);
+    }
+
+    wait_for_connections(pubs, 5.0);
+
+    //in order of priority for tasks due at the same time
+    Scheduled tasks[] = {
+        { 1.0/20.0, view.getBeginTime(), boost::bind(integrate_mapping, &mapping) },
+        { 1.0/2.0,  view.getBeginTime(), boost::bind(&Mapping::publishMap, &mapping) },
+        { 1.0/10.0, view.getBeginTime(), graph_cycle },
+    };
+    const int num_tasks = sizeof(tasks)/sizeof(tasks[0]);
+
+    //replay
+    std::map<std::string, long> counts;
+    ros::WallTime wall_start = ros::WallTime::now();
+
+    BOOST_FOREACH(const rosbag::MessageInstance& m, view)
+    {
+        if (!ros::ok())
+            break;
+
+        const ros::Time& t = m.getTime();
+
+        //periodic tasks due before this message
+        while (true)
+        {
+            int due = -1;
+            for(int i = 0; i < num_tasks; ++i) {
+                if (tasks[i].next <= t && (due < 0 || tasks[i].next < tasks[due].next))
+                    due = i;
+            }
+            if (due < 0)
+                break;
+
+            ros::Time::setNow(tasks[due].next);
+            tasks[due].task();
+            tasks[due].next += ros::Duration(tasks[due].period);
+            drain();
+        }
+
+        ros::Time::setNow(t);
+        topic_tools::ShapeShifter::ConstPtr msg = m.instantiate<topic_tools::ShapeShifter>();
+        pubs[m.getTopic()].publish(*msg);
+        drain();
+
+        ++counts[m.getTopic()];
+    }
+
+    double wall = (ros::WallTime::now() - wall_start).toSec();
+    double duration = (view.getEndTime() - view.getBeginTime()).toSec();
+
+    //final state
+    mapping.publishMap();
+    drain();
+
+    navigation_msgs::Graph graph;
+    graph_snapshot(graph);
+
+    rosbag::Bag graph_bag;
+    graph_bag.open(out_dir + "/graph.bag", rosbag::bagmode::Write);
+    graph_bag.write("/graph/save", view.getEndTime(), graph);
+    graph_bag.close();
+
+    _poses.close();
+    bag.close();
+
+    if (node_utils::tracing_enabled() && !node_utils::write_trace(out_dir + "/trace.json"))
+        ROS_ERROR("[replay] Could not write %s/trace.json", out_dir.c_str());
+
+    //summary
+    long total = 0;
+    std::string summary;
+    char line[256];
+
+    snprintf(line, sizeof(line), "map_hash %016llx\n", (unsigned long long)hash_map(_last_map));
+    summary += line;
+    snprintf(line, sizeof(line), "graph_hash %016llx\n", (unsigned long long)hash_graph(graph));
+    summary += line;
+    snprintf(line, sizeof(line), "graph_nodes %lu\n", graph.nodes.size());
+    summary += line;
+    snprintf(line, sizeof(line), "final_pose %.6f %.6f %.6f\n",
+             _last_pose.pose.pose.position.x, _last_pose.pose.pose.position.y,
+             tf::getYaw(_last_pose.pose.pose.orientation));
+    summary += line;
+
+    for(std::map<std::string, long>::iterator it = counts.begin(); it != counts.end(); ++it) {
+        snprintf(line, sizeof(line), "messages %s %ld\n", it->first.c_str(), it->second);
+        summary += line;
+        total += it->second;
+    }
+
+    snprintf(line, sizeof(line), "wall_time %.3f s\nsim_time %.3f s\nthroughput %.0f msg/s\nrealtime_factor %.1f\n",
+             wall, duration, wall > 0 ? total/wall : 0.0, wall > 0 ? duration/wall : 0.0);
+    summary += line;
+
+    std::ofstream out((out_dir + "/summary.txt").c_str());
+    out << summary;
+    std::cout << summary;
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+#ifndef ROBOT_CORE_BITMAP_H
+#define ROBOT_CORE_BITMAP_H
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+namespace robot_core {
+
+/**
+  * One bit per index, e.g. per cell of a grid. set and test_and_set are
+  * atomic, so several threads can mark the same bitmap.
+  */
+class Bitmap
+{
+public:
+
+    Bitmap() :_size(0) {}
+
+    void resize(size_t size)
+    {
+        _size = size;
+        _words.assign((size + 63)/64, 0);
+    }
+
+    size_t size() const { return _size; }
+
+    void clear()
+    {
+        if (!_words.empty())
+            memset(&_words[0], 0, _words.size()*sizeof(uint64_t));
+    }
+
+    bool test(size_t i) const { return (_words[i/64] >> (i%64)) & 1; }
+
+    void set(size_t i) { __sync_fetch_and_or(&_words[i/64], bit(i)); }
+
+    /**
+      * Sets the bit and returns whether it was set before.
+      */
+    bool test_and_set(size_t i)
+    {
+        uint64_t mask = bit(i);
+        if (_words[i/64] & mask)
+            return true;
+        return __sync_fetch_and_or(&_words[i/64], mask) & mask;
+    }
+
+    /**
+      * The word of bits 64*w to 64*w + 63, to skip the empty ones when
+      * iterating.
+      */
+    size_t num_words() const { return _words.size(); }
+    uint64_t word(size_t w) const { return _words[w]; }
+
+protected:
+
+    static uint64_t bit(size_t i) { return (uint64_t)1 << (i%64); }
+
+    size_t _size;
+    std::vector<uint64_t> _words;
+};
+
+}
+
+#endif // ROBOT_CORE_BITMAP_H
@@ -0,0 +1,131 @@
+#ifndef ROBOT_CORE_CLOUD_H
+#define ROBOT_CORE_CLOUD_H
+
+#include <robot_core/grid.h>
+#include <robot_core/bitmap.h>
+#include <robot_core/transform.h>
+#include <stddef.h>
+#include <vector>
+
+namespace robot_core {
+
+/**
+  * Inserts the point clouds of the depth camera into the occupancy grid.
+  *
+  * A cloud is reduced to columns of voxel_size x voxel_size over the floor.
+  * A column with a point between min_z and max_z is an obstacle, one with
+  * only points below min_z is floor. Every column is a ray from the sensor:
+  * the cells on the way are free, the last cell is occupied for an obstacle
+  * and free for the floor. Each cell is updated at most once per cloud, as
+  * neighbouring rays cross the same cells near the sensor, and occupied
+  * wins over free.
+  *
+  * The rays are traced in parallel by angular sectors around the sensor,
+  * into bitmaps of the cells to update. Only apply writes the grid, so the
+  * grid needs to be locked only for that.
+  */
+class CloudInserter
+{
+public:
+
+    struct Config {
+        double voxel_size;
+        //heights in the frame of the grid
+        double min_z;
+        double max_z;
+        //distances from the sensor
+        double min_range;
+        double max_range;
+        //0 for one per core
+        int threads;
+
+        Config()
+            :voxel_size(0.02), min_z(0.03), max_z(0.3)
+            ,min_range(0.3), max_range(2.0), threads(0)
+        {}
+    };
+
+    struct Stats {
+        //valid points within range and below max_z
+        int points;
+        //columns after the reduction
+        int columns;
+        int occupied_cells;
+        int free_cells;
+        int outside;
+
+        Stats() :points(0), columns(0), occupied_cells(0), free_cells(0), outside(0) {}
+    };
+
+    CloudInserter();
+
+    void set_config(const Config& config) { _config = config; }
+    const Config& config() const { return _config; }
+
+    /**
+      * Inserts count points into grid. Point i is the floats x, y, z at
+      * xyz + i*step bytes, in the frame of the sensor; NaN points are
+      * skipped. sensor_to_grid transforms into the frame of the grid.
+      */
+    Stats insert(Grid& grid, const uint8_t* xyz, size_t count, size_t step,
+                 const Transform& sensor_to_grid);
+
+    /**
+      * The first half of insert: collects the cells to update, without
+      * reading or writing the cells of grid.
+      */
+    Stats trace(const Grid& grid, const uint8_t* xyz, size_t count, size_t step,
+                const Transform& sensor_to_grid);
+
+    /**
+      * The second half of insert: updates the cells of the last trace. grid
+      * has the size of the traced one.
+      */
+    void apply(Grid& grid) const;
+
+protected:
+
+    struct Column {
+        Cell cell;
+        float angle;
+        bool obstacle;
+
+        bool operator<(const Column& other) const { return angle < other.angle; }
+    };
+
+    int num_threads() const;
+    void prepare(const Grid& grid);
+    void collect_columns(int thread);
+    void trace_sectors(int thread);
+
+    Config _config;
+
+    //the cloud of the current insert, shared by the threads
+    const Grid* _grid;
+    const uint8_t* _xyz;
+    size_t _count;
+    size_t _step;
+    Transform _transform;
+    Cell _origin;
+    int _threads;
+
+    //columns of the voxel grid over the extent of the grid
+    int _columns_x;
+    int _columns_y;
+    Bitmap _column_seen;
+    Bitmap _column_obstacle;
+
+    std::vector<Column> _columns;
+    std::vector<size_t> _sector_begin;
+    int _next_sector;
+
+    //per cell: occupied by this cloud, free in this cloud and not occupied
+    Bitmap _occupied;
+    Bitmap _free;
+
+    std::vector<Stats> _thread_stats;
+};
+
+}
+
+#endif // ROBOT_CORE_CLOUD_H
@@ -0,0 +1,143 @@
+#ifndef ROBOT_CORE_GRAPH_H
+#define ROBOT_CORE_GRAPH_H
+
+#include <vector>
+
+namespace robot_core {
+
+/**
+  * A node of the topological graph, with the fields of
+  * navigation_msgs/Node. edges holds the id of the next node in each
+  * direction, or Graph::UNKNOWN or Graph::BLOCKED.
+  */
+struct GraphNode
+{
+    int id_this;
+    std::vector<int> edges;
+    bool object_here;
+    int object_type;
+    float x;
+    float y;
+
+    GraphNode() :id_this(-1), object_here(false), object_type(0), x(0), y(0) {}
+};
+
+/**
+  * Where and how to place a node, with the fields of the
+  * navigation_msgs/PlaceNode request.
+  */
+struct Placement
+{
+    int id_previous;
+    int direction;
+    bool north_blocked;
+    bool east_blocked;
+    bool south_blocked;
+    bool west_blocked;
+    bool object_here;
+    int object_type;
+    float object_x;
+    float object_y;
+
+    Placement()
+        :id_previous(-1), direction(-1)
+        ,north_blocked(false), east_blocked(false), south_blocked(false), west_blocked(false)
+        ,object_here(false), object_type(0), object_x(0), object_y(0)
+    {}
+};
+
+class Graph {
+public:
+
+    enum Directions {
+        North = 0,
+        East,
+        South,
+        West,
+        Object
+    };
+
+    enum Edges {
+        UNKNOWN = -1,
+        BLOCKED = -2
+    };
+
+    struct Config {
+        //a position within dist_thresh of a node is on the node
+        double dist_thresh;
+        //a new node within merge_thresh of a node is merged into it
+        double merge_thresh;
+        bool update_positions;
+
+        Config() :dist_thresh(0), merge_thresh(0), update_positions(false) {}
+    };
+
+    Graph() :_next_node_id(0) {}
+
+    void set_config(const Config& config) { _config = config; }
+    const Config& config() const { return _config; }
+
+    /**
+      * Places a node at x, y connected to placement.id_previous, or merges
+      * it into a node nearby. If the previous node has no free edge in the
+      * direction, id_previous is changed to the closest node.
+      */
+    const GraphNode& place_node(float x, float y, Placement& placement);
+    const GraphNode& place_object(int id_origin, const Placement& placement);
+
+    bool on_node(float x, float y, GraphNode& node) const;
+    bool on_object_node(float x, float y, GraphNode& node) const;
+
+    /**
+      * Throws std::out_of_range for an unknown id.
+      */
+    const GraphNode& get_node(int id) const { return _nodes.at(id); }
+
+    void path_to_next_unknown(int id_from, std::vector<int>& path) const;
+    void path_to_next_object(int id_from, std::vector<int>& path) const;
+    void path_to_node(int id_from, int id_to, std::vector<int>& path, double& dist) const;
+
+    /**
+      * Returns the closest node (or object node) and its squared distance,
+      * -1 if there is none.
+      */
+    int get_closest_node(float x, float y, bool consider_obj, double& min_dist) const;
+
+    bool has_unknown_directions(int id) const;
+    bool is_connected(int id, int id_next) const;
+    bool is_free_connection(int id, int dir) const;
+    bool is_connectable(int id, int dir, int id_next) const;
+
+    int num_nodes() const { return _nodes.size(); }
+
+    const std::vector<GraphNode>& nodes() const { return _nodes; }
+    void assign(const std::vector<GraphNode>& nodes);
+
+protected:
+
+    bool on_node(float x, float y, float max_dist, GraphNode& node) const;
+    bool on_node_auto_recover(float x, float y, Placement& placement, GraphNode& node) const;
+
+    void init_node(GraphNode& node,
+                   bool blocked_north, bool blocked_east,
+                   bool blocked_south, bool blocked_west);
+    void set_connected(int id, int dir, int next);
+
+    void update_blocked_edges(GraphNode& node, const Placement& placement);
+    void update_position(float& x, float& y, float new_x, float new_y);
+
+    void path_to_poi(int id_from, const std::vector<bool>& filter, std::vector<int>& path, double& dist) const;
+
+    static int invert_direction(int dir) {
+        if (dir == Object) return dir;
+        return (dir+2)%4;
+    }
+
+    std::vector<GraphNode> _nodes;
+    int _next_node_id;
+    Config _config;
+};
+
+}
+
+#endif // ROBOT_CORE_GRAPH_H
@@ -0,0 +1,117 @@
+#ifndef ROBOT_CORE_GRID_H
+#define ROBOT_CORE_GRID_H
+
+#include <stdint.h>
+#include <vector>
+
+namespace robot_core {
+
+struct Cell
+{
+    int x;
+    int y;
+
+    Cell() {}
+    Cell(int x, int y) : x(x), y(y) {}
+};
+
+/**
+  * Occupancy grid in log odds together with the grid of what the camera has
+  * seen. Both are stored row by row (y*width + x).
+  *
+  * Every write also updates the views that are published as
+  * nav_msgs/OccupancyGrid data. These are stored column by column
+  * (x*height + y), as the nodes have always published them.
+  */
+class Grid
+{
+public:
+
+    enum Seen {
+        NOT_SEEN = 0,
+        SEEN = 1,
+        SEEN_OBSTACLE = 2
+    };
+
+    static const double P_PRIOR, P_OCC, P_FREE;
+    static const double FREE_OCCUPIED_THRESHOLD;
+    static const int8_t UNKNOWN, FREE, OCCUPIED;
+
+    /**
+      * origin_x and origin_y are the coordinates of cell (0, 0) in meters.
+      */
+    Grid(int width, int height, double resolution, double origin_x, double origin_y);
+
+    int width() const { return _width; }
+    int height() const { return _height; }
+    double resolution() const { return 1.0/_scale; }
+
+    bool contains(int x, int y) const { return x >= 0 && x < _width && y >= 0 && y < _height; }
+    bool contains(Cell cell) const { return contains(cell.x, cell.y); }
+
+    Cell to_cell(double x, double y) const;
+    void to_point(Cell cell, double& x, double& y) const;
+
+    double log_odds(int x, int y) const { return _log_odds[y*_width + x]; }
+    uint8_t seen(int x, int y) const { return _seen[y*_width + x]; }
+
+    /**
+      * Adds the evidence log_prob to the cell. Returns false if the cell is
+      * outside of the grid.
+      */
+    bool update(Cell cell, double log_prob);
+    bool mark_seen(Cell cell, uint8_t flag);
+
+    /**
+      * Cells outside of the grid are neither obstacles nor unexplored.
+      */
+    bool is_obstacle(int x, int y) const
+    {
+        return contains(x, y) && _log_odds[y*_width + x] > FREE_OCCUPIED_THRESHOLD;
+    }
+
+    bool is_seen_obstacle(int x, int y) const
+    {
+        return contains(x, y) && _seen[y*_width + x] == SEEN_OBSTACLE;
+    }
+
+    bool is_unexplored(int x, int y) const
+    {
+        return contains(x, y) && _seen[y*_width + x] == NOT_SEEN;
+    }
+
+    void reset();
+
+    /**
+      * Replaces both grids, e.g. from a checkpoint, and rebuilds the views.
+      * Returns false if the sizes do not match.
+      */
+    bool assign(const std::vector<double>& log_odds, const std::vector<uint8_t>& seen);
+
+    const std::vector<double>& log_odds() const { return _log_odds; }
+    const std::vector<uint8_t>& seen() const { return _seen; }
+
+    const std::vector<int8_t>& occupancy_view() const { return _occupancy_view; }
+    const std::vector<int8_t>& seen_view() const { return _seen_view; }
+
+protected:
+
+    void update_occupancy_view(int x, int y);
+    void update_seen_view(int x, int y);
+
+    int _width;
+    int _height;
+    double _scale;
+    double _origin_x;
+    double _origin_y;
+
+    std::vector<double> _log_odds;
+    std::vector<uint8_t> _seen;
+
+    std::vector<int8_t> _occupancy_view;
+    std::vector<int8_t> _seen_view;
+};
+
+}
+
+#endif // ROBOT_CORE_GRID_H
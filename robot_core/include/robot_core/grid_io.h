@@ -0,0 +1,24 @@
+#ifndef ROBOT_CORE_GRID_IO_H
+#define ROBOT_CORE_GRID_IO_H
+
+#include <robot_core/grid.h>
+#include <istream>
+#include <ostream>
+
+namespace robot_core {
+
+/**
+  * The map file of phase 1: the log odds as text, one cell per line and row
+  * by row.
+  */
+bool write_log_odds(const Grid& grid, std::ostream& out);
+
+/**
+  * Reads a map file into the log odds, the seen grid is kept. Fails if the
+  * file holds fewer cells than the grid.
+  */
+bool read_log_odds(Grid& grid, std::istream& in);
+
+}
+
+#endif // ROBOT_CORE_GRID_IO_H
@@ -0,0 +1,141 @@
+#ifndef ROBOT_CORE_HEIGHT_GRID_H
+#define ROBOT_CORE_HEIGHT_GRID_H
+
+#include <robot_core/grid.h>
+#include <robot_core/transform.h>
+#include <stddef.h>
+#include <vector>
+
+namespace robot_core {
+
+/**
+  * The 2.5D layer next to the occupancy grid, with the same cells: the
+  * lowest and highest point of the last cloud that saw each cell, as height
+  * over the ground plane, and what that makes the cell. It finds the low
+  * obstacles that the ir beams pass over.
+  *
+  * A cell takes a class only after min_hits clouds in a row agreed on it,
+  * so a single noisy cloud does not place an obstacle, and an obstacle that
+  * was moved away is cleared the same way.
+  *
+  * The class of a cell is a single byte, so a query that reads the
+  * occupancy grid can consult it with one more read. Like the occupancy
+  * grid, the view for nav_msgs/OccupancyGrid is stored column by column.
+  */
+class HeightGrid
+{
+public:
+
+    enum Class {
+        UNKNOWN = 0,
+        FLOOR,
+        STEP,
+        OBSTACLE
+    };
+
+    struct Config {
+        //up to floor_tolerance over the ground plane is floor, up to max_step a step
+        double floor_tolerance;
+        double max_step;
+        //points higher up are ignored, the robot passes below them
+        double max_height;
+        //distances from the sensor
+        double min_range;
+        double max_range;
+        //clouds in a row that have to agree before a cell changes its class
+        int min_hits;
+
+        Config()
+            :floor_tolerance(0.015), max_step(0.03), max_height(0.3)
+            ,min_range(0.3), max_range(2.0), min_hits(3)
+        {}
+    };
+
+    /**
+      * Same arguments as the Grid it belongs to.
+      */
+    HeightGrid(int width, int height, double resolution, double origin_x, double origin_y);
+
+    void set_config(const Config& config) { _config = config; }
+    const Config& config() const { return _config; }
+
+    /**
+      * The ground plane a*x + b*y + c*z + d = 0 in the frame of the grid.
+      * Without one it is z = 0. The cells are reset if the heights change by
+      * more than half the floor tolerance within max_range.
+      */
+    void set_ground(double a, double b, double c, double d);
+
+    int width() const { return _width; }
+    int height() const { return _height; }
+
+    /**
+      * Bins count points into the cells, as CloudInserter::insert. Returns
+      * the number of points outside of the grid.
+      */
+    int insert(const uint8_t* xyz, size_t count, size_t step, const Transform& sensor_to_grid);
+
+    /**
+      * Cells outside of the grid are unknown.
+      */
+    uint8_t cell_class(int x, int y) const
+    {
+        return contains(x, y) ? _class[y*_width + x] : (uint8_t)UNKNOWN;
+    }
+
+    bool is_obstacle(int x, int y) const { return cell_class(x, y) == OBSTACLE; }
+
+    /**
+      * Heights over the ground plane in the last cloud that saw the cell,
+      * only valid for cells that were seen.
+      */
+    float min_height(int x, int y) const { return _min[y*_width + x]; }
+    float max_height(int x, int y) const { return _max[y*_width + x]; }
+
+    void reset();
+
+    /**
+      * -1 unknown, 0 floor, 50 step and 100 obstacle.
+      */
+    const std::vector<int8_t>& view() const { return _view; }
+
+protected:
+
+    bool contains(int x, int y) const { return x >= 0 && x < _width && y >= 0 && y < _height; }
+    void bin(size_t count);
+    void classify();
+
+    Config _config;
+
+    int _width;
+    int _height;
+    double _resolution;
+    double _origin_x;
+    double _origin_y;
+
+    double _ground[4];
+
+    //the cloud that _min and _max of a cell belong to, counting from 1
+    uint32_t _cloud;
+    std::vector<uint32_t> _cell_cloud;
+    std::vector<int> _touched;
+
+    std::vector<float> _min;
+    std::vector<float> _max;
+    //the class of the last clouds and for how many in a row
+    std::vector<uint8_t> _candidate;
+    std::vector<uint8_t> _hits;
+    std::vector<uint8_t> _class;
+    std::vector<int8_t> _view;
+
+    //one block of the binning kernel, as arrays of x, y, z instead of points
+    std::vector<float> _block_x;
+    std::vector<float> _block_y;
+    std::vector<float> _block_z;
+    std::vector<float> _block_height;
+    std::vector<int> _block_cell;
+};
+
+}
+
+#endif // ROBOT_CORE_HEIGHT_GRID_H
@@ -0,0 +1,104 @@
+#ifndef ROBOT_CORE_RAYCAST_H
+#define ROBOT_CORE_RAYCAST_H
+
+#include <robot_core/grid.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace robot_core {
+
+/**
+  * Visits the cells of the line from p0 to p1, both included, until visit
+  * returns false. visit is called as bool visit(Cell cell, bool first).
+  *
+  * Adapted from
+  * https://github.com/clearpathrobotics/occupancy_grid_utils/blob/hydro-devel/include/occupancy_grid_utils/impl/ray_trace_iterator.h
+  */
+template<class Visitor>
+void traverse(Cell p0, Cell p1, Visitor& visit)
+{
+    const int dx = p1.x-p0.x;
+    const int dy = p1.y-p0.y;
+    const int abs_dx = abs(dx);
+    const int abs_dy = abs(dy);
+    const int offset_dx = (dx>0) ? 1 : -1;
+    const int offset_dy = (dy>0) ? 1 : -1;
+
+    int x_inc, y_inc;
+    int x_correction, y_correction;
+    int error, error_inc, error_threshold;
+
+    if (abs_dx > abs_dy) {
+        x_inc = offset_dx;
+        y_inc = 0;
+        x_correction = 0;
+        y_correction = offset_dy;
+        error = abs_dx/2;
+        error_inc = abs_dy;
+        error_threshold = abs_dx;
+    }
+    else {
+        x_inc = 0;
+        y_inc = offset_dy;
+        x_correction = offset_dx;
+        y_correction = 0;
+        error = abs_dy/2;
+        error_inc = abs_dx;
+        error_threshold = abs_dy;
+    }
+
+    Cell cell(p0.x,p0.y);
+    if (!visit(cell, true))
+        return;
+
+    while (cell.x != p1.x || cell.y != p1.y)
+    {
+        cell.x += x_inc;
+        cell.y += y_inc;
+        error += error_inc;
+        if (error >= error_threshold) {
+            cell.x += x_correction;
+            cell.y += y_correction;
+            error -= error_threshold;
+        }
+
+        if (!visit(cell, false))
+            return;
+    }
+}
+
+/**
+  * Adds log_prob to every cell from p0 to p1. Like the other marking
+  * functions it returns the number of cells outside of the grid, which the
+  * caller may report.
+  */
+int mark_ray(Grid& grid, Cell p0, Cell p1, double log_prob);
+
+/**
+  * Marks the cells from p0 to p1 as seen with flag. The ray stops in front
+  * of the first obstacle after p0, in either grid.
+  */
+int mark_seen_ray(Grid& grid, Cell p0, Cell p1, uint8_t flag);
+
+/**
+  * Marks the seen rays from origin to end, with end rotated about origin
+  * from -fov/2 to fov/2 in steps of step (both in radians), like the
+  * frustum of the camera.
+  */
+int mark_seen_fan(Grid& grid, Cell origin, Cell end, double fov, double step, uint8_t flag);
+
+/**
+  * Adds log_prob to the cells from center - neighborhood (included) to
+  * center + neighborhood (excluded) in both directions.
+  */
+int mark_block(Grid& grid, Cell center, int neighborhood, double log_prob);
+
+/**
+  * Collects the obstacles from p0 to p1 into hits, until there are
+  * max_hits of them. Returns the number of hits.
+  */
+int find_obstacles(const Grid& grid, Cell p0, Cell p1, int max_hits, std::vector<Cell>& hits);
+
+}
+
+#endif // ROBOT_CORE_RAYCAST_H
@@ -0,0 +1,33 @@
+#ifndef ROBOT_CORE_REGION_H
+#define ROBOT_CORE_REGION_H
+
+#include <robot_core/grid.h>
+#include <robot_core/height_grid.h>
+
+namespace robot_core {
+
+struct RegionCount
+{
+    int cells;
+    int occupied;
+    int unexplored;
+
+    RegionCount() :cells(0), occupied(0), unexplored(0) {}
+};
+
+/**
+  * Counts the cells within radius of center, and how many of them are
+  * obstacles or unexplored. Cells outside of the grid count as free and
+  * explored.
+  */
+RegionCount count_disc(const Grid& grid, Cell center, int radius);
+
+/**
+  * The same, with the obstacles of the height layer counted as occupied as
+  * well.
+  */
+RegionCount count_disc(const Grid& grid, const HeightGrid& heights, Cell center, int radius);
+
+}
+
+#endif // ROBOT_CORE_REGION_H
@@ -0,0 +1,25 @@
+#ifndef ROBOT_CORE_TRANSFORM_H
+#define ROBOT_CORE_TRANSFORM_H
+
+namespace robot_core {
+
+/**
+  * Rigid transform p' = rotation*p + translation, rotation row by row.
+  */
+struct Transform
+{
+    double rotation[9];
+    double translation[3];
+
+    Transform()
+    {
+        for(int i = 0; i < 9; ++i)
+            rotation[i] = (i%4 == 0) ? 1.0 : 0.0;
+        for(int i = 0; i < 3; ++i)
+            translation[i] = 0.0;
+    }
+};
+
+}
+
+#endif // ROBOT_CORE_TRANSFORM_H
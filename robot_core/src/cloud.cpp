@@ -0,0 +1,294 @@
+#include <robot_core/cloud.h>
+#include <robot_core/raycast.h>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <math.h>
+
+namespace robot_core {
+
+namespace {
+
+//sectors per thread, so a thread with the longer rays does not hold up the others
+const int SECTORS_PER_THREAD = 8;
+
+struct FreeVisitor {
+    const Grid& grid;
+    const Bitmap& occupied;
+    Bitmap& free;
+    Cell end;
+    bool end_free;
+    CloudInserter::Stats& stats;
+
+    FreeVisitor(const Grid& grid, const Bitmap& occupied, Bitmap& free, Cell end, bool end_free,
+                CloudInserter::Stats& stats)
+        :grid(grid), occupied(occupied), free(free), end(end), end_free(end_free), stats(stats) {}
+
+    bool operator()(Cell cell, bool)
+    {
+        bool last = cell.x == end.x && cell.y == end.y;
+        if (last && !end_free)
+            return false;
+
+        if (!grid.contains(cell)) {
+            ++stats.outside;
+            return !last;
+        }
+
+        size_t i = (size_t)cell.y*grid.width() + cell.x;
+        if (!occupied.test(i) && !free.test_and_set(i))
+            ++stats.free_cells;
+        return !last;
+    }
+};
+
+/**
+  * Adds log_prob to the cells of the set bits.
+  */
+void update_cells(Grid& grid, const Bitmap& cells, double log_prob)
+{
+    for(size_t w = 0; w < cells.num_words(); ++w)
+    {
+        uint64_t bits = cells.word(w);
+        while (bits != 0)
+        {
+            int b = __builtin_ctzll(bits);
+            bits &= bits - 1;
+
+            size_t i = w*64 + b;
+            grid.update(Cell(i % grid.width(), i / grid.width()), log_prob);
+        }
+    }
+}
+
+template<class Function>
+void run_parallel(int threads, Function function)
+{
+    boost::thread_group group;
+    for(int t = 1; t < threads; ++t)
+        group.create_thread(boost::bind(function, t));
+    function(0);
+    group.join_all();
+}
+
+}
+
+CloudInserter::CloudInserter()
+    :_grid(0), _xyz(0), _count(0), _step(0), _threads(1)
+    ,_columns_x(0), _columns_y(0), _next_sector(0)
+{
+}
+
+int CloudInserter::num_threads() const
+{
+    if (_config.threads > 0)
+        return _config.threads;
+    return std::max(1, (int)boost::thread::hardware_concurrency());
+}
+
+/**
+  * Sizes the bitmaps for grid and clears them. They are only reallocated
+  * when the grid or the voxel size changes.
+  */
+void CloudInserter::prepare(const Grid& grid)
+{
+    size_t cells = (size_t)grid.width()*grid.height();
+    if (_occupied.size() != cells) {
+        _occupied.resize(cells);
+        _free.resize(cells);
+    }
+    else {
+        _occupied.clear();
+        _free.clear();
+    }
+
+    int columns_x = ceil(grid.width()*grid.resolution()/_config.voxel_size);
+    int columns_y = ceil(grid.height()*grid.resolution()/_config.voxel_size);
+    if (columns_x != _columns_x || columns_y != _columns_y) {
+        _columns_x = columns_x;
+        _columns_y = columns_y;
+        _column_seen.resize((size_t)columns_x*columns_y);
+        _column_obstacle.resize((size_t)columns_x*columns_y);
+    }
+    else {
+        _column_seen.clear();
+        _column_obstacle.clear();
+    }
+
+    _thread_stats.assign(_threads, Stats());
+}
+
+/**
+  * Transforms the points of one slice of the cloud and marks their columns.
+  */
+void CloudInserter::collect_columns(int thread)
+{
+    const Grid& grid = *_grid;
+    const double* r = _transform.rotation;
+    const double* t = _transform.translation;
+
+    //the cells are centered on their coordinates, the columns start at the corner of cell (0, 0)
+    double corner_x, corner_y;
+    grid.to_point(Cell(0,0), corner_x, corner_y);
+    corner_x -= grid.resolution()/2.0;
+    corner_y -= grid.resolution()/2.0;
+
+    const double min_range_sq = _config.min_range*_config.min_range;
+    const double max_range_sq = _config.max_range*_config.max_range;
+    const double scale = 1.0/_config.voxel_size;
+
+    Stats& stats = _thread_stats[thread];
+    size_t begin = _count*thread/_threads;
+    size_t end = _count*(thread+1)/_threads;
+
+    for(size_t i = begin; i < end; ++i)
+    {
+        const float* p = (const float*)(_xyz + i*_step);
+        float x = p[0], y = p[1], z = p[2];
+        if (isnan(x) || isnan(y) || isnan(z))
+            continue;
+
+        double range_sq = x*x + y*y + z*z;
+        if (range_sq < min_range_sq || range_sq > max_range_sq)
+            continue;
+
+        double map_z = r[6]*x + r[7]*y + r[8]*z + t[2];
+        if (map_z > _config.max_z)
+            continue;
+
+        double map_x = r[0]*x + r[1]*y + r[2]*z + t[0];
+        double map_y = r[3]*x + r[4]*y + r[5]*z + t[1];
+
+        ++stats.points;
+
+        int cx = floor((map_x - corner_x)*scale);
+        int cy = floor((map_y - corner_y)*scale);
+        if (cx < 0 || cx >= _columns_x || cy < 0 || cy >= _columns_y) {
+            ++stats.outside;
+            continue;
+        }
+
+        size_t column = (size_t)cy*_columns_x + cx;
+        _column_seen.set(column);
+        if (map_z >= _config.min_z)
+            _column_obstacle.set(column);
+    }
+}
+
+/**
+  * Takes the next untraced sector until there is none left.
+  */
+void CloudInserter::trace_sectors(int thread)
+{
+    Stats& stats = _thread_stats[thread];
+    const int sectors = _sector_begin.size() - 1;
+
+    for(;;)
+    {
+        int sector = __sync_fetch_and_add(&_next_sector, 1);
+        if (sector >= sectors)
+            return;
+
+        for(size_t i = _sector_begin[sector]; i < _sector_begin[sector+1]; ++i)
+        {
+            const Column& column = _columns[i];
+            FreeVisitor visitor(*_grid, _occupied, _free, column.cell, !column.obstacle, stats);
+            traverse(_origin, column.cell, visitor);
+        }
+    }
+}
+
+CloudInserter::Stats CloudInserter::insert(Grid& grid, const uint8_t* xyz, size_t count, size_t step,
+                                           const Transform& sensor_to_grid)
+{
+    Stats stats = trace(grid, xyz, count, step, sensor_to_grid);
+    apply(grid);
+    return stats;
+}
+
+CloudInserter::Stats CloudInserter::trace(const Grid& grid, const uint8_t* xyz, size_t count, size_t step,
+                                          const Transform& sensor_to_grid)
+{
+    _grid = &grid;
+    _xyz = xyz;
+    _count = count;
+    _step = step;
+    _transform = sensor_to_grid;
+    _origin = grid.to_cell(sensor_to_grid.translation[0], sensor_to_grid.translation[1]);
+    _threads = num_threads();
+
+    prepare(grid);
+
+    run_parallel(_threads, boost::bind(&CloudInserter::collect_columns, this, _1));
+
+    Stats stats;
+    for(int t = 0; t < _threads; ++t) {
+        stats.points += _thread_stats[t].points;
+        stats.outside += _thread_stats[t].outside;
+        _thread_stats[t] = Stats();
+    }
+
+    //the columns back to cells, the obstacles are collected right away
+    double corner_x, corner_y;
+    grid.to_point(Cell(0,0), corner_x, corner_y);
+    corner_x -= grid.resolution()/2.0;
+    corner_y -= grid.resolution()/2.0;
+
+    _columns.clear();
+    for(size_t w = 0; w < _column_seen.num_words(); ++w)
+    {
+        uint64_t bits = _column_seen.word(w);
+        while (bits != 0)
+        {
+            int b = __builtin_ctzll(bits);
+            bits &= bits - 1;
+
+            size_t index = w*64 + b;
+            Column column;
+            column.cell = grid.to_cell(corner_x + ((index % _columns_x) + 0.5)*_config.voxel_size,
+                                       corner_y + ((index / _columns_x) + 0.5)*_config.voxel_size);
+            //the last columns may reach over the border of the grid
+            if (!grid.contains(column.cell)) {
+                ++stats.outside;
+                continue;
+            }
+            column.angle = atan2(column.cell.y - _origin.y, column.cell.x - _origin.x);
+            column.obstacle = _column_obstacle.test(index);
+            _columns.push_back(column);
+
+            if (column.obstacle) {
+                size_t i = (size_t)column.cell.y*grid.width() + column.cell.x;
+                if (!_occupied.test_and_set(i))
+                    ++stats.occupied_cells;
+            }
+        }
+    }
+    stats.columns = _columns.size();
+
+    //sectors of equally many rays, not equal angles, as the camera covers only a part of the circle
+    std::sort(_columns.begin(), _columns.end());
+    int sectors = std::max(1, std::min(_threads*SECTORS_PER_THREAD, (int)_columns.size()));
+    _sector_begin.resize(sectors+1);
+    for(int s = 0; s <= sectors; ++s)
+        _sector_begin[s] = _columns.size()*s/sectors;
+    _next_sector = 0;
+
+    run_parallel(_threads, boost::bind(&CloudInserter::trace_sectors, this, _1));
+
+    for(int t = 0; t < _threads; ++t) {
+        stats.free_cells += _thread_stats[t].free_cells;
+        stats.outside += _thread_stats[t].outside;
+    }
+
+    _grid = 0;
+    _xyz = 0;
+    return stats;
+}
+
+void CloudInserter::apply(Grid& grid) const
+{
+    update_cells(grid, _occupied, Grid::P_OCC);
+    update_cells(grid, _free, Grid::P_FREE);
+}
+
+}
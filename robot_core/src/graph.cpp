@@ -0,0 +1,358 @@
+#include <robot_core/graph.h>
+#include <algorithm>
+#include <limits>
+#include <queue>
+
+namespace robot_core {
+
+namespace {
+
+double sq_dist(double x0, double y0, double x1, double y1)
+{
+    return (x1-x0)*(x1-x0) + (y1-y0)*(y1-y0);
+}
+
+bool update_dijkstra(int id,
+                     int id_next,
+                     const std::vector<GraphNode>& nodes,
+                     std::vector<int>& previous,
+                     std::vector<float>& distances)
+{
+    const GraphNode& node = nodes[id];
+    const GraphNode& next = nodes[id_next];
+    float d = distances[id] + sq_dist(node.x,node.y, next.x, next.y);
+
+    if (d < distances[id_next]) {
+        distances[id_next] = d;
+        previous[id_next] = id;
+        return true;
+    }
+    return false;
+}
+
+}
+
+void Graph::init_node(GraphNode& node,
+                      bool blocked_north, bool blocked_east,
+                      bool blocked_south, bool blocked_west)
+{
+    node.edges.resize(5);
+    node.edges[North] = blocked_north ? BLOCKED : UNKNOWN;
+    node.edges[East] = blocked_east ? BLOCKED : UNKNOWN;
+    node.edges[South] = blocked_south ? BLOCKED : UNKNOWN;
+    node.edges[West] = blocked_west ? BLOCKED : UNKNOWN;
+    node.edges[Object] = BLOCKED;
+
+    node.object_here = false;
+}
+
+bool Graph::is_free_connection(int id, int dir) const
+{
+    return _nodes[id].edges[dir] < 0;
+}
+
+bool Graph::is_connected(int id, int id_next) const
+{
+    const GraphNode& node = _nodes[id];
+
+    for(size_t i = 0; i < node.edges.size(); ++i)
+        if (node.edges[i] == id_next)
+            return true;
+
+    return false;
+}
+
+bool Graph::is_connectable(int id, int dir, int id_next) const
+{
+    if (id < 0 || id_next < 0 || id == id_next)
+        return false;
+
+    const GraphNode& node = _nodes[id];
+    const GraphNode& next = _nodes[id_next];
+
+    if (node.edges[dir] >= 0)
+        return false;
+    if (next.edges[invert_direction(dir)] >= 0)
+        return false;
+
+    return true;
+}
+
+void Graph::set_connected(int id, int dir, int id_next)
+{
+    if (!is_connectable(id, dir, id_next))
+        return;
+
+    _nodes[id].edges[dir] = id_next;
+    _nodes[id_next].edges[invert_direction(dir)] = id;
+}
+
+void Graph::update_position(float& x, float& y, float new_x, float new_y)
+{
+    if (_config.update_positions) {
+        x = 0.3*x + 0.7*new_x;
+        y = 0.3*y + 0.7*new_y;
+    }
+}
+
+bool Graph::on_node_auto_recover(float x, float y, Placement& placement, GraphNode& node) const
+{
+    if (placement.id_previous == -1) return false;
+
+    if (on_node(x,y, _config.merge_thresh, node))
+        return true;
+
+    //check if there is a free edge at the previous id
+    if (is_free_connection(placement.id_previous, placement.direction))
+        return false;
+
+    //otherwise continue from the closest node
+    double dist;
+    int closest = get_closest_node(x,y, false, dist);
+
+    placement.id_previous = closest;
+    node = _nodes[closest];
+    return true;
+}
+
+void Graph::update_blocked_edges(GraphNode& node, const Placement& placement)
+{
+    if (node.edges[North] == UNKNOWN) node.edges[North] = placement.north_blocked ? BLOCKED : UNKNOWN;
+    if (node.edges[East] == UNKNOWN) node.edges[East] = placement.east_blocked ? BLOCKED : UNKNOWN;
+    if (node.edges[South] == UNKNOWN) node.edges[South] = placement.south_blocked ? BLOCKED : UNKNOWN;
+    if (node.edges[West] == UNKNOWN) node.edges[West] = placement.west_blocked ? BLOCKED : UNKNOWN;
+}
+
+const GraphNode& Graph::place_node(float x, float y, Placement& placement)
+{
+    GraphNode node;
+
+    //only place node, if there is no other node close nearby
+    if (!on_node_auto_recover(x,y,placement,node)) {
+
+        init_node(node, placement.north_blocked, placement.east_blocked, placement.south_blocked, placement.west_blocked);
+
+        node.x = x;
+        node.y = y;
+
+        node.id_this = _nodes.size();
+
+        _nodes.push_back(node);
+    }
+    else {
+        update_blocked_edges(_nodes[node.id_this], placement);
+        update_position(_nodes[node.id_this].x, _nodes[node.id_this].y, x, y);
+    }
+
+    if (is_connectable(placement.id_previous, placement.direction, node.id_this))
+        set_connected(placement.id_previous, placement.direction, node.id_this);
+
+    return _nodes[node.id_this];
+}
+
+const GraphNode& Graph::place_object(int id_origin, const Placement& placement)
+{
+    GraphNode neighbor;
+    bool has_neighbor = on_object_node(placement.object_x,placement.object_y, neighbor);
+
+    GraphNode node;
+
+    //only place object node, if there is no other object node close nearby,
+    if (!has_neighbor) {
+
+        init_node(node, true, true, true, true);
+
+        node.object_here = true;
+        node.x = placement.object_x;
+        node.y = placement.object_y;
+
+        node.id_this = _nodes.size();
+
+        _nodes.push_back(node);
+    }
+    else {
+        node = neighbor;
+        update_position(_nodes[node.id_this].x, _nodes[node.id_this].y, placement.object_x, placement.object_y);
+    }
+
+    set_connected(id_origin, Object, node.id_this);
+
+    return _nodes[node.id_this];
+}
+
+bool Graph::on_node(float x, float y, GraphNode& node) const
+{
+    return on_node(x,y, _config.dist_thresh, node);
+}
+
+int Graph::get_closest_node(float x, float y, bool consider_obj, double& min_dist) const
+{
+    int closest = -1;
+    min_dist = std::numeric_limits<double>::infinity();
+
+    for(size_t i = 0; i < _nodes.size(); ++i)
+    {
+        const GraphNode& node = _nodes[i];
+        if (consider_obj != node.object_here)
+            continue;
+
+        double sq_d = sq_dist(x,y, node.x, node.y);
+        if (sq_d < min_dist) {
+            min_dist = sq_d;
+            closest = i;
+        }
+    }
+
+    return closest;
+}
+
+bool Graph::on_object_node(float x, float y, GraphNode& node) const
+{
+    double sq_dist_thresh = _config.dist_thresh;
+    sq_dist_thresh *= sq_dist_thresh;
+
+    double min_dist;
+    int closest = get_closest_node(x,y,true,min_dist);
+    if (closest == -1) return false;
+
+    if (min_dist < sq_dist_thresh) {
+        node = _nodes[closest];
+        return true;
+    }
+
+    return false;
+}
+
+bool Graph::on_node(float x, float y, float max_dist, GraphNode& node) const
+{
+    double sq_dist_thresh = max_dist;
+    sq_dist_thresh *= sq_dist_thresh;
+
+    double min_dist;
+    int closest = get_closest_node(x,y,false,min_dist);
+    if (closest == -1) return false;
+
+    if (min_dist < sq_dist_thresh) {
+        node = _nodes[closest];
+        return true;
+    }
+
+    return false;
+}
+
+bool Graph::has_unknown_directions(int id) const
+{
+    const GraphNode& n = _nodes[id];
+    for (int i = 0; i < 4; ++i) //only consider N,E,S,W
+    {
+        if (n.edges[i] == UNKNOWN)
+            return true;
+    }
+    return false;
+}
+
+void Graph::path_to_next_unknown(int id_from, std::vector<int>& path) const
+{
+    std::vector<bool> has_unknown(_nodes.size());
+    for (size_t i = 0; i < _nodes.size(); ++i)
+        has_unknown[i] = has_unknown_directions(i);
+
+    double dummy;
+    path_to_poi(id_from, has_unknown, path, dummy);
+}
+
+void Graph::path_to_next_object(int id_from, std::vector<int>& path) const
+{
+    std::vector<bool> is_object(_nodes.size());
+    for (size_t i = 0; i < _nodes.size(); ++i)
+        is_object[i] = _nodes[i].object_here;
+
+    double dummy;
+    path_to_poi(id_from, is_object, path, dummy);
+}
+
+void Graph::path_to_node(int id_from, int id_to, std::vector<int>& path, double& dist) const
+{
+    std::vector<bool> is_target_node(_nodes.size());
+    is_target_node[id_to] = true;
+
+    path_to_poi(id_from, is_target_node, path, dist);
+}
+
+/**
+  * Shortest paths from id_from over the known edges, then the path to the
+  * closest node that passes filter. Without one the path is only id_from.
+  */
+void Graph::path_to_poi(int id_from, const std::vector<bool>& filter, std::vector<int>& path, double& dist) const
+{
+    if (_nodes.size() == 0)
+        return;
+
+    path.clear();
+    std::queue<int> queue;
+
+    std::vector<int> previous(_nodes.size(), -1);
+    std::vector<float> distances(_nodes.size(), std::numeric_limits<float>::infinity());
+    std::vector<bool> visited(_nodes.size(), false);
+
+    distances[id_from] = 0;
+
+    queue.push(id_from);
+
+    while(!queue.empty()) {
+        int id = queue.front();
+        queue.pop();
+
+        //check if node already visited
+        if (visited[id] == true)
+            continue;
+
+        visited[id] = true;
+
+        const GraphNode& node = _nodes[id];
+        for(size_t i = 0; i < node.edges.size(); ++i)
+        {
+            if (node.edges[i] >= 0) {
+                if(update_dijkstra(id, node.edges[i], _nodes, previous, distances))
+                    queue.push(node.edges[i]);
+            }
+        }
+    }
+
+    //find closest node where condition is true
+    int i_min_dist = -1;
+    float min_dist = std::numeric_limits<float>::infinity();
+
+    for (size_t i = 0; i < _nodes.size(); ++i) {
+        if (filter[i] && distances[i] < min_dist) {
+            min_dist = distances[i];
+            i_min_dist = i;
+        }
+    }
+
+    //no node to reach
+    if (i_min_dist == -1) {
+        path.push_back(id_from);
+        return;
+    }
+
+    dist = min_dist;
+
+    //determine shortest path
+    int cur = i_min_dist;
+    path.push_back(cur);
+    while(cur != id_from) {
+        cur = previous[cur];
+        path.push_back(cur);
+    }
+
+    std::reverse(path.begin(), path.end());
+}
+
+void Graph::assign(const std::vector<GraphNode>& nodes)
+{
+    _nodes = nodes;
+    _next_node_id = nodes.size();
+}
+
+}
@@ -0,0 +1,105 @@
+#include <robot_core/grid.h>
+#include <math.h>
+
+namespace robot_core {
+
+const double Grid::P_PRIOR = log(0.5/(1.0-0.5));
+const double Grid::P_OCC = log(0.7/(1.0-0.7));
+const double Grid::P_FREE = log(0.35/(1.0-0.35));
+
+const double Grid::FREE_OCCUPIED_THRESHOLD = log(0.5);
+
+const int8_t Grid::UNKNOWN = 50;
+const int8_t Grid::FREE = 0;
+const int8_t Grid::OCCUPIED = 100;
+
+Grid::Grid(int width, int height, double resolution, double origin_x, double origin_y)
+    :_width(width)
+    ,_height(height)
+    ,_scale(1.0/resolution)
+    ,_origin_x(origin_x)
+    ,_origin_y(origin_y)
+{
+    reset();
+}
+
+Cell Grid::to_cell(double x, double y) const
+{
+    return Cell(round((x - _origin_x)*_scale), round((y - _origin_y)*_scale));
+}
+
+void Grid::to_point(Cell cell, double& x, double& y) const
+{
+    x = cell.x/_scale + _origin_x;
+    y = cell.y/_scale + _origin_y;
+}
+
+bool Grid::update(Cell cell, double log_prob)
+{
+    if (!contains(cell))
+        return false;
+
+    _log_odds[cell.y*_width + cell.x] += log_prob - P_PRIOR;
+    update_occupancy_view(cell.x, cell.y);
+    return true;
+}
+
+bool Grid::mark_seen(Cell cell, uint8_t flag)
+{
+    if (!contains(cell))
+        return false;
+
+    _seen[cell.y*_width + cell.x] = flag;
+    update_seen_view(cell.x, cell.y);
+    return true;
+}
+
+void Grid::reset()
+{
+    _log_odds.assign(_width*_height, P_PRIOR);
+    _seen.assign(_width*_height, NOT_SEEN);
+    _occupancy_view.assign(_width*_height, UNKNOWN);
+    _seen_view.assign(_width*_height, UNKNOWN);
+}
+
+bool Grid::assign(const std::vector<double>& log_odds, const std::vector<uint8_t>& seen)
+{
+    if (log_odds.size() != _log_odds.size() || seen.size() != _seen.size())
+        return false;
+
+    _log_odds = log_odds;
+    _seen = seen;
+    for(int y = 0; y < _height; ++y) {
+        for(int x = 0; x < _width; ++x) {
+            update_occupancy_view(x, y);
+            update_seen_view(x, y);
+        }
+    }
+    return true;
+}
+
+void Grid::update_occupancy_view(int x, int y)
+{
+    double log_odds = _log_odds[y*_width + x];
+    int8_t& view = _occupancy_view[x*_height + y];
+    if (log_odds > FREE_OCCUPIED_THRESHOLD)
+        view = OCCUPIED;
+    else if (log_odds < FREE_OCCUPIED_THRESHOLD)
+        view = FREE;
+    else
+        view = UNKNOWN;
+}
+
+void Grid::update_seen_view(int x, int y)
+{
+    uint8_t flag = _seen[y*_width + x];
+    int8_t& view = _seen_view[x*_height + y];
+    if (flag == SEEN)
+        view = FREE;
+    else if (flag == SEEN_OBSTACLE)
+        view = OCCUPIED;
+    else
+        view = UNKNOWN;
+}
+
+}
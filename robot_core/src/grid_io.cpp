@@ -0,0 +1,28 @@
+#include <robot_core/grid_io.h>
+
+namespace robot_core {
+
+bool write_log_odds(const Grid& grid, std::ostream& out)
+{
+    const std::vector<double>& log_odds = grid.log_odds();
+    for(size_t i = 0; i < log_odds.size(); ++i)
+        out << log_odds[i] << "\n";
+    return out.good();
+}
+
+bool read_log_odds(Grid& grid, std::istream& in)
+{
+    std::vector<double> log_odds(grid.log_odds().size(), Grid::P_PRIOR);
+    for(size_t i = 0; i < log_odds.size(); ++i) {
+        if (!(in >> log_odds[i]))
+            return false;
+
+        //written with 6 digits, cells at the threshold would come back occupied
+        if (log_odds[i] == -0.693147)
+            log_odds[i] = Grid::FREE_OCCUPIED_THRESHOLD;
+    }
+
+    return grid.assign(log_odds, grid.seen());
+}
+
+}
@@ -0,0 +1,213 @@
+#include <robot_core/height_grid.h>
+#include <algorithm>
+#include <limits>
+#include <math.h>
+
+namespace robot_core {
+
+namespace {
+
+//points per block of the binning kernel, the block arrays stay in the L1 cache
+const size_t BLOCK = 256;
+
+const int8_t VIEW[] = {-1, 0, 50, 100};
+
+}
+
+HeightGrid::HeightGrid(int width, int height, double resolution, double origin_x, double origin_y)
+    :_width(width)
+    ,_height(height)
+    ,_resolution(resolution)
+    ,_origin_x(origin_x)
+    ,_origin_y(origin_y)
+    ,_cloud(0)
+    ,_block_x(BLOCK)
+    ,_block_y(BLOCK)
+    ,_block_z(BLOCK)
+    ,_block_height(BLOCK)
+    ,_block_cell(BLOCK)
+{
+    _ground[0] = 0;
+    _ground[1] = 0;
+    _ground[2] = 1;
+    _ground[3] = 0;
+    reset();
+}
+
+void HeightGrid::set_ground(double a, double b, double c, double d)
+{
+    //normalized and facing up, so the distance to the plane is the height
+    double norm = sqrt(a*a + b*b + c*c);
+    if (c < 0)
+        norm = -norm;
+
+    double ground[4] = {a/norm, b/norm, c/norm, d/norm};
+
+    //the heights are measured from the old plane, a tilt moves them most at max_range
+    double cos_angle = std::min(1.0, ground[0]*_ground[0] + ground[1]*_ground[1] + ground[2]*_ground[2]);
+    double change = fabs(ground[3] - _ground[3]) + acos(cos_angle)*_config.max_range;
+    bool changed = change > _config.floor_tolerance/2.0;
+
+    std::copy(ground, ground + 4, _ground);
+    if (changed)
+        reset();
+}
+
+void HeightGrid::reset()
+{
+    size_t cells = (size_t)_width*_height;
+    _cloud = 0;
+    _cell_cloud.assign(cells, 0);
+    _min.assign(cells, std::numeric_limits<float>::infinity());
+    _max.assign(cells, -std::numeric_limits<float>::infinity());
+    _candidate.assign(cells, UNKNOWN);
+    _hits.assign(cells, 0);
+    _class.assign(cells, UNKNOWN);
+    _view.assign(cells, VIEW[UNKNOWN]);
+}
+
+/**
+  * The transform into the grid, the ground plane and the cell size are
+  * folded into three dot products per point: the height and the cell
+  * coordinates. The points are copied block by block into arrays of x, y
+  * and z, so that the compiler vectorizes the loop over a block. Only the
+  * update of the cells is scalar, and the classes are updated once for the
+  * whole cloud.
+  */
+int HeightGrid::insert(const uint8_t* xyz, size_t count, size_t step, const Transform& sensor_to_grid)
+{
+    const double* r = sensor_to_grid.rotation;
+    const double* t = sensor_to_grid.translation;
+    const double* g = _ground;
+    const double scale = 1.0/_resolution;
+
+    //cell (0, 0) is centered on the origin, so its corner is half a cell off
+    const double corner_x = _origin_x - _resolution/2.0;
+    const double corner_y = _origin_y - _resolution/2.0;
+
+    const float hx = g[0]*r[0] + g[1]*r[3] + g[2]*r[6];
+    const float hy = g[0]*r[1] + g[1]*r[4] + g[2]*r[7];
+    const float hz = g[0]*r[2] + g[1]*r[5] + g[2]*r[8];
+    const float hw = g[0]*t[0] + g[1]*t[1] + g[2]*t[2] + g[3];
+
+    const float cxx = r[0]*scale, cxy = r[1]*scale, cxz = r[2]*scale, cxw = (t[0] - corner_x)*scale;
+    const float cyx = r[3]*scale, cyy = r[4]*scale, cyz = r[5]*scale, cyw = (t[1] - corner_y)*scale;
+
+    const float min_range_sq = _config.min_range*_config.min_range;
+    const float max_range_sq = _config.max_range*_config.max_range;
+    const float max_height = _config.max_height;
+    const float width = _width;
+    const float height = _height;
+    const int stride = _width;
+
+    float* bx = &_block_x[0];
+    float* by = &_block_y[0];
+    float* bz = &_block_z[0];
+    float* bh = &_block_height[0];
+    int* bc = &_block_cell[0];
+
+    ++_cloud;
+    _touched.clear();
+
+    int outside = 0;
+    for(size_t begin = 0; begin < count; begin += BLOCK)
+    {
+        size_t n = std::min(BLOCK, count - begin);
+
+        for(size_t j = 0; j < n; ++j) {
+            const float* p = (const float*)(xyz + (begin + j)*step);
+            bx[j] = p[0];
+            by[j] = p[1];
+            bz[j] = p[2];
+        }
+
+        //branch free, NaN points fail the range test
+        for(size_t j = 0; j < n; ++j) {
+            float x = bx[j], y = by[j], z = bz[j];
+
+            float range_sq = x*x + y*y + z*z;
+            float h = hx*x + hy*y + hz*z + hw;
+            float fx = cxx*x + cxy*y + cxz*z + cxw;
+            float fy = cyx*x + cyy*y + cyz*z + cyw;
+
+            bool valid = (range_sq >= min_range_sq) & (range_sq <= max_range_sq) & (h <= max_height);
+            bool inside = (fx >= 0) & (fx < width) & (fy >= 0) & (fy < height);
+
+            //the conversion is only defined for finite values in range, NaN fails inside as well
+            int cell_x = (int)(inside ? fx : 0.0f);
+            int cell_y = (int)(inside ? fy : 0.0f);
+
+            bh[j] = h;
+            bc[j] = (valid & inside) ? cell_y*stride + cell_x : -1;
+            outside += valid & !inside;
+        }
+
+        bin(n);
+    }
+
+    classify();
+    return outside;
+}
+
+/**
+  * Updates the heights of the cells of the current block. The first point
+  * of the cloud in a cell replaces the heights of the earlier clouds.
+  */
+void HeightGrid::bin(size_t count)
+{
+    for(size_t j = 0; j < count; ++j)
+    {
+        int cell = _block_cell[j];
+        if (cell < 0)
+            continue;
+
+        float h = _block_height[j];
+        if (_cell_cloud[cell] != _cloud) {
+            _cell_cloud[cell] = _cloud;
+            _min[cell] = h;
+            _max[cell] = h;
+            _touched.push_back(cell);
+            continue;
+        }
+
+        float& min = _min[cell];
+        float& max = _max[cell];
+        if (h < min) min = h;
+        if (h > max) max = h;
+    }
+}
+
+/**
+  * Counts the clouds in a row with the same class for the cells of the
+  * current cloud, and changes the class once there are min_hits of them.
+  */
+void HeightGrid::classify()
+{
+    const int min_hits = std::max(1, std::min(_config.min_hits, 255));
+
+    for(size_t i = 0; i < _touched.size(); ++i)
+    {
+        int cell = _touched[i];
+
+        //a drop below the floor is as impassable as a wall
+        uint8_t type = FLOOR;
+        if (_max[cell] > _config.max_step || _min[cell] < -_config.max_step)
+            type = OBSTACLE;
+        else if (_max[cell] > _config.floor_tolerance)
+            type = STEP;
+
+        if (type != _candidate[cell]) {
+            _candidate[cell] = type;
+            _hits[cell] = 0;
+        }
+        if (_hits[cell] < 255)
+            ++_hits[cell];
+
+        if (_hits[cell] >= min_hits && type != _class[cell]) {
+            _class[cell] = type;
+            _view[(size_t)(cell % _width)*_height + cell/_width] = VIEW[type];
+        }
+    }
+}
+
+}
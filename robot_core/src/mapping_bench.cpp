@@ -0,0 +1,701 @@
+#include <robot_core/grid.h>
+#include <robot_core/cloud.h>
+#include <robot_core/height_grid.h>
+#include <robot_core/grid_io.h>
+#include <robot_core/raycast.h>
+#include <robot_core/region.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <math.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+  * Microbenchmarks of the mapping kernels in robot_core, on the grid size of
+  * the mapping node and at several fill levels:
+  *
+  *   mapping_bench [--filter <substring>] [--min-time <s>] [--repetitions <n>]
+  *                 [--no-perf] [--commit <id>]
+  *
+  * Prints JSON to stdout. With perf counters available (see
+  * /proc/sys/kernel/perf_event_paranoid) every result also holds cycles,
+  * cache misses and branch misses per operation.
+  */
+
+using namespace robot_core;
+
+const int GRID_SIZE = 1000;
+const double RESOLUTION = 0.01;
+
+//written once at the end, so that the compiler keeps the results
+volatile long _sink = 0;
+
+//------------------------------------------------------------------------------
+// Perf counters
+
+class PerfCounters {
+public:
+
+    enum Counter {
+        CYCLES = 0,
+        CACHE_MISSES,
+        BRANCH_MISSES,
+        NUM_COUNTERS
+    };
+
+    PerfCounters() :_leader(-1) {}
+    ~PerfCounters() { close(); }
+
+    bool open()
+    {
+        const uint64_t configs[NUM_COUNTERS] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES
+        };
+
+        for(int i = 0; i < NUM_COUNTERS; ++i) {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[i];
+            attr.disabled = (i == 0);
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            int fd = syscall(__NR_perf_event_open, &attr, 0, -1, _leader, 0);
+            if (fd < 0) {
+                fprintf(stderr, "[mapping_bench] perf_event_open: %s, running without counters\n", strerror(errno));
+                close();
+                return false;
+            }
+            _fds.push_back(fd);
+            if (i == 0)
+                _leader = fd;
+        }
+        return true;
+    }
+
+    bool available() const { return _leader >= 0; }
+
+    void start()
+    {
+        ioctl(_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    /**
+      * Stops the counters and reads them, scaled up if the kernel had to
+      * multiplex them.
+      */
+    bool stop(double values[NUM_COUNTERS])
+    {
+        ioctl(_leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+        uint64_t data[3 + NUM_COUNTERS];
+        if (read(_leader, data, sizeof(data)) != (ssize_t)sizeof(data) || data[0] != NUM_COUNTERS)
+            return false;
+
+        uint64_t enabled = data[1];
+        uint64_t running = data[2];
+        if (running == 0)
+            return false;
+
+        for(int i = 0; i < NUM_COUNTERS; ++i)
+            values[i] = data[3+i]*((double)enabled/running);
+        return true;
+    }
+
+private:
+
+    void close()
+    {
+        for(size_t i = 0; i < _fds.size(); ++i)
+            ::close(_fds[i]);
+        _fds.clear();
+        _leader = -1;
+    }
+
+    int _leader;
+    std::vector<int> _fds;
+};
+
+//------------------------------------------------------------------------------
+// Fixtures
+
+/**
+  * Deterministic, so that runs on different commits see the same grid.
+  */
+class Random {
+public:
+    Random(uint32_t seed) :_state(seed) {}
+
+    uint32_t next()
+    {
+        _state = _state*1664525u + 1013904223u;
+        return _state >> 8;
+    }
+
+private:
+    uint32_t _state;
+};
+
+/**
+  * A maze explored to fill (0 to 1 of the map area): a square in the middle
+  * of free cells with walls every 0.6 m that have a door in each maze cell,
+  * and everything of it seen. The rest stays at the prior.
+  */
+void fill_grid(Grid& grid, double fill)
+{
+    grid.reset();
+
+    int side = sqrt(fill)*grid.width();
+    int begin = (grid.width() - side)/2;
+    int end = begin + side;
+    const int maze_cell = 60;
+    const int door = 20;
+
+    Random random(42);
+    for(int y = begin; y < end; ++y) {
+        for(int x = begin; x < end; ++x) {
+            bool wall_x = (x - begin) % maze_cell < 2;
+            bool wall_y = (y - begin) % maze_cell < 2;
+            bool door_x = (y - begin) % maze_cell >= (maze_cell - door)/2 && (y - begin) % maze_cell < (maze_cell + door)/2;
+            bool door_y = (x - begin) % maze_cell >= (maze_cell - door)/2 && (x - begin) % maze_cell < (maze_cell + door)/2;
+            bool wall = (wall_x && !door_x) || (wall_y && !door_y);
+
+            //a few updates per cell, as after driving past it
+            int updates = 1 + random.next() % 4;
+            for(int i = 0; i < updates; ++i)
+                grid.update(Cell(x, y), wall ? Grid::P_OCC : Grid::P_FREE);
+            grid.mark_seen(Cell(x, y), wall ? Grid::SEEN_OBSTACLE : Grid::SEEN);
+        }
+    }
+}
+
+/**
+  * Ray end points at length cells around the center, in 64 directions.
+  */
+void ray_fan(int length, std::vector<Cell>& origins, std::vector<Cell>& ends)
+{
+    Random random(7);
+    const int center = GRID_SIZE/2;
+    for(int i = 0; i < 64; ++i) {
+        Cell origin(center + random.next() % 100 - 50, center + random.next() % 100 - 50);
+        double angle = 2.0*M_PI*i/64.0;
+        origins.push_back(origin);
+        ends.push_back(Cell(origin.x + round(length*cos(angle)), origin.y + round(length*sin(angle))));
+    }
+}
+
+//------------------------------------------------------------------------------
+// Kernels
+
+/**
+  * One benchmark: setup is not timed, run executes the kernel iterations
+  * times. Results go into sink so that nothing is optimized away. The grid
+  * is only allocated by setup, so that the kernels waiting for their turn
+  * stay small.
+  */
+class Kernel {
+public:
+
+    Kernel(const std::string& name, double fill)
+        :name(name)
+        ,grid(0, 0, RESOLUTION, 0, 0)
+        ,sink(0)
+    {
+        add_param("fill", fill);
+        _fill = fill;
+    }
+
+    virtual ~Kernel() {}
+
+    virtual void setup()
+    {
+        grid = Grid(GRID_SIZE, GRID_SIZE, RESOLUTION, -GRID_SIZE*RESOLUTION/2.0, -GRID_SIZE*RESOLUTION/2.0);
+        fill_grid(grid, _fill);
+    }
+    virtual void run(long iterations) = 0;
+
+    void add_param(const std::string& key, double value) { params.push_back(std::make_pair(key, value)); }
+
+    std::string name;
+    std::vector<std::pair<std::string, double> > params;
+    Grid grid;
+    long sink;
+
+private:
+    double _fill;
+};
+
+/**
+  * Mapping::markPointsBetween of a free ray, e.g. of an ir reading.
+  */
+class MarkRay : public Kernel {
+public:
+    MarkRay(double fill, int length) :Kernel("mark_ray", fill), _length(length) { add_param("length", length); }
+
+    virtual void setup()
+    {
+        Kernel::setup();
+        ray_fan(_length, _origins, _ends);
+    }
+
+    virtual void run(long iterations)
+    {
+        for(long i = 0; i < iterations; ++i)
+            sink += mark_ray(grid, _origins[i & 63], _ends[i & 63], Grid::P_FREE);
+    }
+
+private:
+    int _length;
+    std::vector<Cell> _origins, _ends;
+};
+
+/**
+  * Mapping::updateHaveSeen with the default frustum of 45 degrees and 0.4 m.
+  */
+class HaveSeen : public Kernel {
+public:
+    HaveSeen(double fill) :Kernel("have_seen", fill) {}
+
+    virtual void setup()
+    {
+        Kernel::setup();
+        ray_fan(40, _origins, _ends);
+    }
+
+    virtual void run(long iterations)
+    {
+        for(long i = 0; i < iterations; ++i)
+            sink += mark_seen_fan(grid, _origins[i & 63], _ends[i & 63], 45.0*M_PI/180.0, M_PI/180.0, Grid::SEEN);
+    }
+
+private:
+    std::vector<Cell> _origins, _ends;
+};
+
+/**
+  * Mapping::performRaycast, which stops at the second obstacle.
+  */
+class Raycast : public Kernel {
+public:
+    Raycast(double fill, int length) :Kernel("raycast", fill), _length(length) { add_param("length", length); }
+
+    virtual void setup()
+    {
+        Kernel::setup();
+        ray_fan(_length, _origins, _ends);
+        _hits.reserve(2);
+    }
+
+    virtual void run(long iterations)
+    {
+        for(long i = 0; i < iterations; ++i)
+            sink += find_obstacles(grid, _origins[i & 63], _ends[i & 63], 2, _hits);
+    }
+
+private:
+    int _length;
+    std::vector<Cell> _origins, _ends;
+    std::vector<Cell> _hits;
+};
+
+/**
+  * Mapping::serviceFitRequest and serviceHasUnexploredRegion.
+  */
+class FitRegion : public Kernel {
+public:
+    FitRegion(double fill, int radius) :Kernel("fit_region", fill), _radius(radius) { add_param("radius", radius); }
+
+    virtual void setup()
+    {
+        Kernel::setup();
+        ray_fan(_radius, _origins, _ends);
+    }
+
+    virtual void run(long iterations)
+    {
+        for(long i = 0; i < iterations; ++i) {
+            RegionCount count = count_disc(grid, _ends[i & 63], _radius);
+            sink += count.occupied + count.unexplored;
+        }
+    }
+
+private:
+    int _radius;
+    std::vector<Cell> _origins, _ends;
+};
+
+/**
+  * Mapping::saveToFile, into memory.
+  */
+class SaveText : public Kernel {
+public:
+    SaveText(double fill) :Kernel("save_text", fill) {}
+
+    virtual void run(long iterations)
+    {
+        for(long i = 0; i < iterations; ++i) {
+            std::ostringstream out;
+            write_log_odds(grid, out);
+            sink += out.str().size();
+        }
+    }
+};
+
+/**
+  * Mapping::recoverFromFile, from memory.
+  */
+class LoadText : public Kernel {
+public:
+    LoadText(double fill) :Kernel("load_text", fill) {}
+
+    virtual void setup()
+    {
+        Kernel::setup();
+        std::ostringstream out;
+        write_log_odds(grid, out);
+        _text = out.str();
+    }
+
+    virtual void run(long iterations)
+    {
+        for(long i = 0; i < iterations; ++i) {
+            std::istringstream in(_text);
+            sink += read_log_odds(grid, in);
+        }
+    }
+
+private:
+    std::string _text;
+};
+
+/**
+  * Mapping::restoreCheckpoint without the file: replacing the grids and
+  * rebuilding the views.
+  */
+class Restore : public Kernel {
+public:
+    Restore(double fill) :Kernel("restore", fill) {}
+
+    virtual void setup()
+    {
+        Kernel::setup();
+        _log_odds = grid.log_odds();
+        _seen = grid.seen();
+    }
+
+    virtual void run(long iterations)
+    {
+        for(long i = 0; i < iterations; ++i)
+            sink += grid.assign(_log_odds, _seen);
+    }
+
+private:
+    std::vector<double> _log_odds;
+    std::vector<uint8_t> _seen;
+};
+
+/**
+  * A 640x480 cloud of the depth camera 0.2 m over the floor, looking at a
+  * wall 1.8 m ahead, as x, y, z and padding like pcl::PointXYZ. Every tenth
+  * point is NaN as around edges.
+  */
+void depth_cloud(std::vector<float>& points, Transform& camera_to_grid)
+{
+    const int width = 640, height = 480;
+    const double focal = 525.0, camera_z = 0.2, wall_x = 1.8;
+
+    points.assign(width*height*4, 0.0f);
+    Random random(3);
+    for(int v = 0; v < height; ++v) {
+        for(int u = 0; u < width; ++u) {
+            float* p = &points[(v*width + u)*4];
+            if (random.next() % 10 == 0) {
+                p[0] = p[1] = p[2] = NAN;
+                continue;
+            }
+            //optical frame: x right, y down, z forward
+            double dx = (u - width/2.0)/focal;
+            double dy = (v - height/2.0)/focal;
+            double t = wall_x;
+            if (dy > 0)
+                t = std::min(t, camera_z/dy);
+            t += (random.next() % 100)*1e-4;
+            p[0] = t*dx;
+            p[1] = t*dy;
+            p[2] = t;
+        }
+    }
+
+    //optical frame to the grid
+    const double rotation[9] = {0, 0, 1,  -1, 0, 0,  0, -1, 0};
+    std::copy(rotation, rotation + 9, camera_to_grid.rotation);
+    camera_to_grid.translation[2] = camera_z;
+}
+
+/**
+  * Mapping::integrateCloud of depth_cloud. At camera rate one operation has
+  * to take less than 33 ms.
+  */
+class InsertCloud : public Kernel {
+public:
+    InsertCloud(double fill, int threads) :Kernel("insert_cloud", fill), _threads(threads) { add_param("threads", threads); }
+
+    virtual void setup()
+    {
+        Kernel::setup();
+        depth_cloud(_points, _transform);
+
+        CloudInserter::Config config;
+        config.threads = _threads;
+        _inserter.set_config(config);
+    }
+
+    virtual void run(long iterations)
+    {
+        for(long i = 0; i < iterations; ++i) {
+            CloudInserter::Stats stats = _inserter.insert(grid, (const uint8_t*)&_points[0], _points.size()/4,
+                                                          4*sizeof(float), _transform);
+            sink += stats.occupied_cells + stats.free_cells;
+        }
+    }
+
+private:
+    int _threads;
+    std::vector<float> _points;
+    Transform _transform;
+    CloudInserter _inserter;
+};
+
+/**
+  * The height layer of Mapping::integrateCloud, binning depth_cloud. Does
+  * not depend on the fill of the occupancy grid.
+  */
+class BinHeights : public Kernel {
+public:
+    BinHeights() :Kernel("bin_heights", 0.0), _heights(0, 0, RESOLUTION, 0, 0) {}
+
+    virtual void setup()
+    {
+        _heights = HeightGrid(GRID_SIZE, GRID_SIZE, RESOLUTION, -GRID_SIZE*RESOLUTION/2.0, -GRID_SIZE*RESOLUTION/2.0);
+        depth_cloud(_points, _transform);
+    }
+
+    virtual void run(long iterations)
+    {
+        for(long i = 0; i < iterations; ++i)
+            sink += _heights.insert((const uint8_t*)&_points[0], _points.size()/4, 4*sizeof(float), _transform);
+    }
+
+private:
+    HeightGrid _heights;
+    std::vector<float> _points;
+    Transform _transform;
+};
+
+//------------------------------------------------------------------------------
+// Measurement
+
+struct Result {
+    long iterations;
+    double ns_per_op;
+    bool has_counters;
+    double counters_per_op[PerfCounters::NUM_COUNTERS];
+};
+
+double now_sec()
+{
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec*1e-9;
+}
+
+bool by_time(const Result& a, const Result& b)
+{
+    return a.ns_per_op < b.ns_per_op;
+}
+
+/**
+  * Grows the iterations until a run takes min_time, then reports the
+  * median of the repetitions.
+  */
+Result measure(Kernel& kernel, PerfCounters& perf, double min_time, int repetitions)
+{
+    kernel.run(1);
+
+    long iterations = 1;
+    for(;;) {
+        double start = now_sec();
+        kernel.run(iterations);
+        double elapsed = now_sec() - start;
+        if (elapsed >= min_time || iterations >= (1L << 30))
+            break;
+        long scale = elapsed > 0 ? (long)(1.4*min_time/elapsed) : 10;
+        iterations *= std::max(2L, std::min(scale, 10L));
+    }
+
+    std::vector<Result> results;
+    for(int r = 0; r < repetitions; ++r) {
+        Result result;
+        result.iterations = iterations;
+        result.has_counters = false;
+
+        double values[PerfCounters::NUM_COUNTERS];
+        if (perf.available())
+            perf.start();
+        double start = now_sec();
+        kernel.run(iterations);
+        double elapsed = now_sec() - start;
+        if (perf.available() && perf.stop(values)) {
+            result.has_counters = true;
+            for(int i = 0; i < PerfCounters::NUM_COUNTERS; ++i)
+                result.counters_per_op[i] = values[i]/iterations;
+        }
+
+        result.ns_per_op = elapsed*1e9/iterations;
+        results.push_back(result);
+    }
+
+    std::sort(results.begin(), results.end(), by_time);
+    return results[results.size()/2];
+}
+
+//------------------------------------------------------------------------------
+// Output
+
+std::string json_string(const std::string& value)
+{
+    std::string out = "\"";
+    for(size_t i = 0; i < value.size(); ++i) {
+        if (value[i] == '"' || value[i] == '\\')
+            out += '\\';
+        out += value[i];
+    }
+    return out + "\"";
+}
+
+void print_result(const Kernel& kernel, const Result& result, bool first)
+{
+    printf("%s    {\"name\": %s, \"params\": {", first ? "" : ",\n", json_string(kernel.name).c_str());
+    for(size_t i = 0; i < kernel.params.size(); ++i)
+        printf("%s%s: %g", i == 0 ? "" : ", ", json_string(kernel.params[i].first).c_str(), kernel.params[i].second);
+    printf("}, \"iterations\": %ld, \"ns_per_op\": %.3f", result.iterations, result.ns_per_op);
+    if (result.has_counters)
+        printf(", \"cycles_per_op\": %.3f, \"cache_misses_per_op\": %.5f, \"branch_misses_per_op\": %.5f",
+               result.counters_per_op[PerfCounters::CYCLES],
+               result.counters_per_op[PerfCounters::CACHE_MISSES],
+               result.counters_per_op[PerfCounters::BRANCH_MISSES]);
+    printf("}");
+    fflush(stdout);
+}
+
+//------------------------------------------------------------------------------
+// Entry point
+
+void add_kernels(std::vector<Kernel*>& kernels)
+{
+    const double fills[] = {0.0, 0.3, 0.8};
+    const int lengths[] = {10, 40, 100, 300};
+    const int radii[] = {10, 25};
+
+    for(int f = 0; f < 3; ++f) {
+        double fill = fills[f];
+        for(int l = 0; l < 4; ++l)
+            kernels.push_back(new MarkRay(fill, lengths[l]));
+        kernels.push_back(new HaveSeen(fill));
+        for(int l = 0; l < 4; ++l)
+            kernels.push_back(new Raycast(fill, lengths[l]));
+        for(int r = 0; r < 2; ++r)
+            kernels.push_back(new FitRegion(fill, radii[r]));
+        kernels.push_back(new SaveText(fill));
+        kernels.push_back(new LoadText(fill));
+        kernels.push_back(new Restore(fill));
+        //one thread and one per core
+        kernels.push_back(new InsertCloud(fill, 1));
+        kernels.push_back(new InsertCloud(fill, 0));
+    }
+    kernels.push_back(new BinHeights());
+}
+
+int main(int argc, char** argv)
+{
+    std::string filter;
+    std::string commit;
+    double min_time = 0.2;
+    int repetitions = 5;
+    bool use_perf = true;
+
+    for(int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i+1 < argc)
+            filter = argv[++i];
+        else if (arg == "--min-time" && i+1 < argc)
+            min_time = atof(argv[++i]);
+        else if (arg == "--repetitions" && i+1 < argc)
+            repetitions = std::max(1, atoi(argv[++i]));
+        else if (arg == "--commit" && i+1 < argc)
+            commit = argv[++i];
+        else if (arg == "--no-perf")
+            use_perf = false;
+        else {
+            fprintf(stderr, "usage: %s [--filter <substring>] [--min-time <s>] [--repetitions <n>] [--no-perf] [--commit <id>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    PerfCounters perf;
+    if (use_perf)
+        perf.open();
+
+    std::vector<Kernel*> kernels;
+    add_kernels(kernels);
+
+    char date[32];
+    time_t t = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&t));
+    char host[256] = "";
+    gethostname(host, sizeof(host)-1);
+
+    printf("{\n  \"context\": {\"date\": %s, \"host\": %s, \"commit\": %s, \"grid\": %d, "
+           "\"min_time\": %g, \"repetitions\": %d, \"perf\": %s},\n  \"benchmarks\": [\n",
+           json_string(date).c_str(), json_string(host).c_str(), json_string(commit).c_str(),
+           GRID_SIZE, min_time, repetitions, perf.available() ? "true" : "false");
+
+    bool first = true;
+    for(size_t i = 0; i < kernels.size(); ++i) {
+        Kernel& kernel = *kernels[i];
+        if (kernel.name.find(filter) == std::string::npos) {
+            delete kernels[i];
+            continue;
+        }
+
+        fprintf(stderr, "[mapping_bench] %s", kernel.name.c_str());
+        for(size_t p = 0; p < kernel.params.size(); ++p)
+            fprintf(stderr, " %s=%g", kernel.params[p].first.c_str(), kernel.params[p].second);
+        fprintf(stderr, "\n");
+        kernel.setup();
+        Result result = measure(kernel, perf, min_time, repetitions);
+        print_result(kernel, result, first);
+        first = false;
+
+        _sink += kernel.sink;
+        delete kernels[i];
+    }
+
+    printf("\n  ]\n}\n");
+    return 0;
+}
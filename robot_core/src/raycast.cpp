@@ -0,0 +1,112 @@
+#include <robot_core/raycast.h>
+#include <math.h>
+
+namespace robot_core {
+
+namespace {
+
+struct MarkVisitor {
+    Grid& grid;
+    double log_prob;
+    int outside;
+
+    MarkVisitor(Grid& grid, double log_prob) :grid(grid), log_prob(log_prob), outside(0) {}
+
+    bool operator()(Cell cell, bool)
+    {
+        if (!grid.update(cell, log_prob))
+            ++outside;
+        return true;
+    }
+};
+
+struct SeenVisitor {
+    Grid& grid;
+    uint8_t flag;
+    int outside;
+
+    SeenVisitor(Grid& grid, uint8_t flag) :grid(grid), flag(flag), outside(0) {}
+
+    bool operator()(Cell cell, bool first)
+    {
+        if (!first && (grid.is_obstacle(cell.x, cell.y) || grid.is_seen_obstacle(cell.x, cell.y)))
+            return false;
+        if (!grid.mark_seen(cell, flag))
+            ++outside;
+        return true;
+    }
+};
+
+struct ObstacleVisitor {
+    const Grid& grid;
+    int max_hits;
+    std::vector<Cell>& hits;
+
+    ObstacleVisitor(const Grid& grid, int max_hits, std::vector<Cell>& hits)
+        :grid(grid), max_hits(max_hits), hits(hits) {}
+
+    bool operator()(Cell cell, bool)
+    {
+        if (grid.is_obstacle(cell.x, cell.y))
+            hits.push_back(cell);
+        return (int)hits.size() < max_hits;
+    }
+};
+
+Cell rotate(Cell p, Cell origin, double angle)
+{
+    double c = cos(angle);
+    double s = sin(angle);
+
+    double x = origin.x + c*(p.x-origin.x) - s*(p.y-origin.y);
+    double y = origin.y + s*(p.x-origin.x) + c*(p.y-origin.y);
+
+    return Cell(round(x), round(y));
+}
+
+}
+
+int mark_ray(Grid& grid, Cell p0, Cell p1, double log_prob)
+{
+    MarkVisitor visitor(grid, log_prob);
+    traverse(p0, p1, visitor);
+    return visitor.outside;
+}
+
+int mark_seen_ray(Grid& grid, Cell p0, Cell p1, uint8_t flag)
+{
+    SeenVisitor visitor(grid, flag);
+    traverse(p0, p1, visitor);
+    return visitor.outside;
+}
+
+int mark_seen_fan(Grid& grid, Cell origin, Cell end, double fov, double step, uint8_t flag)
+{
+    int outside = 0;
+    for(double angle = -fov/2.0; angle < fov/2.0; angle += step)
+        outside += mark_seen_ray(grid, origin, rotate(end, origin, angle), flag);
+    return outside;
+}
+
+int mark_block(Grid& grid, Cell center, int neighborhood, double log_prob)
+{
+    int outside = 0;
+    Cell cell;
+    for(cell.x = center.x-neighborhood; cell.x < center.x+neighborhood; ++cell.x) {
+        for(cell.y = center.y-neighborhood; cell.y < center.y+neighborhood; ++cell.y) {
+            if (!grid.update(cell, log_prob))
+                ++outside;
+        }
+    }
+    return outside;
+}
+
+int find_obstacles(const Grid& grid, Cell p0, Cell p1, int max_hits, std::vector<Cell>& hits)
+{
+    hits.clear();
+    ObstacleVisitor visitor(grid, max_hits, hits);
+    traverse(p0, p1, visitor);
+    return hits.size();
+}
+
+}
@@ -0,0 +1,62 @@
+#include <robot_core/region.h>
+
+namespace robot_core {
+
+namespace {
+
+struct GridObstacle {
+    const Grid& grid;
+
+    GridObstacle(const Grid& grid) :grid(grid) {}
+
+    bool operator()(int x, int y) const { return grid.is_obstacle(x,y); }
+};
+
+struct LayerObstacle {
+    const Grid& grid;
+    const HeightGrid& heights;
+
+    LayerObstacle(const Grid& grid, const HeightGrid& heights) :grid(grid), heights(heights) {}
+
+    bool operator()(int x, int y) const { return grid.is_obstacle(x,y) || heights.is_obstacle(x,y); }
+};
+
+template<class Obstacle>
+RegionCount count_disc(const Grid& grid, const Obstacle& is_obstacle, Cell center, int radius)
+{
+    RegionCount count;
+    Cell top_left(center.x - radius, center.y - radius);
+    int width = radius*2;
+
+    for(int y = top_left.y; y < top_left.y+width; ++y) {
+        for(int x = top_left.x; x < top_left.x+width; ++x) {
+
+            int dx = center.x - x;
+            int dy = center.y - y;
+            if (dx*dx + dy*dy > radius*radius)
+                continue;
+
+            if (is_obstacle(x,y))
+                count.occupied++;
+            if (grid.is_unexplored(x,y))
+                count.unexplored++;
+            count.cells++;
+        }
+    }
+
+    return count;
+}
+
+}
+
+RegionCount count_disc(const Grid& grid, Cell center, int radius)
+{
+    return count_disc(grid, GridObstacle(grid), center, radius);
+}
+
+RegionCount count_disc(const Grid& grid, const HeightGrid& heights, Cell center, int radius)
+{
+    return count_disc(grid, LayerObstacle(grid, heights), center, radius);
+}
+
+}
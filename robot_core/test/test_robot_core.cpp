@@ -0,0 +1,215 @@
+#include <robot_core/cloud.h>
+#include <robot_core/grid.h>
+#include <robot_core/raycast.h>
+#include <robot_core/region.h>
+#include <gtest/gtest.h>
+
+using namespace robot_core;
+
+namespace {
+
+const double RESOLUTION = 0.01;
+
+/**
+  * A 100 x 100 grid with cell (0, 0) at (-0.5, -0.5). The prior counts as
+  * an obstacle, so the cells are made free first.
+  */
+Grid free_grid()
+{
+    Grid grid(100, 100, RESOLUTION, -0.5, -0.5);
+    for(int y = 0; y < grid.height(); ++y) {
+        for(int x = 0; x < grid.width(); ++x) {
+            grid.update(Cell(x, y), Grid::P_FREE);
+            grid.update(Cell(x, y), Grid::P_FREE);
+        }
+    }
+    return grid;
+}
+
+void set_obstacle(Grid& grid, int x, int y)
+{
+    for(int i = 0; i < 4; ++i)
+        grid.update(Cell(x, y), Grid::P_OCC);
+}
+
+}
+
+//------------------------------------------------------------------------------
+// Grid
+
+TEST(Grid, ToCellRoundsToTheNearestCenter)
+{
+    Grid grid(100, 100, RESOLUTION, -0.5, -0.5);
+
+    Cell cell = grid.to_cell(-0.5, -0.5);
+    EXPECT_EQ(0, cell.x);
+    EXPECT_EQ(0, cell.y);
+
+    //the cells are centered on their coordinates, the border is half a cell off
+    cell = grid.to_cell(-0.5 + 0.004, -0.5 + 0.006);
+    EXPECT_EQ(0, cell.x);
+    EXPECT_EQ(1, cell.y);
+
+    cell = grid.to_cell(0.0, 0.0149);
+    EXPECT_EQ(50, cell.x);
+    EXPECT_EQ(51, cell.y);
+
+    //below the origin the rounding goes away from zero as well
+    cell = grid.to_cell(-0.5 - 0.004, -0.5 - 0.006);
+    EXPECT_EQ(0, cell.x);
+    EXPECT_EQ(-1, cell.y);
+    EXPECT_FALSE(grid.contains(cell));
+}
+
+TEST(Grid, ToPointIsTheInverseOfToCell)
+{
+    Grid grid(100, 100, RESOLUTION, -0.5, -0.5);
+
+    double x, y;
+    grid.to_point(Cell(10, 75), x, y);
+    EXPECT_NEAR(-0.4, x, 1e-9);
+    EXPECT_NEAR(0.25, y, 1e-9);
+
+    Cell cell = grid.to_cell(x, y);
+    EXPECT_EQ(10, cell.x);
+    EXPECT_EQ(75, cell.y);
+}
+
+//------------------------------------------------------------------------------
+// Raycast
+
+/**
+  * The raycast service reports a hit only for two obstacles on the ray, so
+  * find_obstacles stops at the second.
+  */
+TEST(Raycast, StopsAtTheSecondHit)
+{
+    Grid grid = free_grid();
+    set_obstacle(grid, 30, 10);
+    set_obstacle(grid, 40, 10);
+    set_obstacle(grid, 50, 10);
+
+    std::vector<Cell> hits;
+    ASSERT_EQ(2, find_obstacles(grid, Cell(10, 10), Cell(90, 10), 2, hits));
+    ASSERT_EQ(2u, hits.size());
+    EXPECT_EQ(30, hits[0].x);
+    EXPECT_EQ(40, hits[1].x);
+    EXPECT_EQ(10, hits[1].y);
+}
+
+TEST(Raycast, SingleObstacleIsOneHit)
+{
+    Grid grid = free_grid();
+    set_obstacle(grid, 50, 50);
+
+    std::vector<Cell> hits;
+    EXPECT_EQ(1, find_obstacles(grid, Cell(10, 10), Cell(90, 90), 2, hits));
+    EXPECT_EQ(0, find_obstacles(grid, Cell(10, 20), Cell(90, 20), 2, hits));
+    EXPECT_TRUE(hits.empty());
+}
+
+TEST(Raycast, ReversedRayFindsTheNearObstacleFirst)
+{
+    Grid grid = free_grid();
+    set_obstacle(grid, 30, 10);
+    set_obstacle(grid, 40, 10);
+    set_obstacle(grid, 50, 10);
+
+    std::vector<Cell> hits;
+    ASSERT_EQ(2, find_obstacles(grid, Cell(90, 10), Cell(10, 10), 2, hits));
+    EXPECT_EQ(50, hits[0].x);
+    EXPECT_EQ(40, hits[1].x);
+}
+
+//------------------------------------------------------------------------------
+// Region
+
+TEST(Region, CountDiscCellsWithinRadius)
+{
+    Grid grid = free_grid();
+
+    //dx and dy run from radius down to 1 - radius
+    RegionCount count = count_disc(grid, Cell(50, 50), 2);
+    EXPECT_EQ(11, count.cells);
+    EXPECT_EQ(0, count.occupied);
+    EXPECT_EQ(11, count.unexplored);
+
+    set_obstacle(grid, 50, 50);
+    set_obstacle(grid, 51, 51);
+    set_obstacle(grid, 52, 52);
+    grid.mark_seen(Cell(50, 49), Grid::SEEN);
+
+    count = count_disc(grid, Cell(50, 50), 2);
+    EXPECT_EQ(11, count.cells);
+    EXPECT_EQ(2, count.occupied);
+    EXPECT_EQ(10, count.unexplored);
+}
+
+TEST(Region, CountDiscOutsideIsFreeAndExplored)
+{
+    Grid grid = free_grid();
+
+    RegionCount count = count_disc(grid, Cell(0, 0), 2);
+    EXPECT_EQ(11, count.cells);
+    EXPECT_EQ(0, count.occupied);
+    EXPECT_EQ(4, count.unexplored);
+}
+
+TEST(Region, CountDiscWithHeightObstacles)
+{
+    Grid grid = free_grid();
+    HeightGrid heights(grid.width(), grid.height(), RESOLUTION, -0.5, -0.5);
+
+    HeightGrid::Config config;
+    config.min_hits = 1;
+    heights.set_config(config);
+
+    //a point 10 cm over the floor in cell (50, 50), seen from 0.5 m
+    float point[3] = {0.5f, 0.0f, 0.1f};
+    Transform sensor_to_grid;
+    sensor_to_grid.translation[0] = -0.5;
+    heights.insert((const uint8_t*)point, 1, sizeof(point), sensor_to_grid);
+    ASSERT_TRUE(heights.is_obstacle(50, 50));
+
+    EXPECT_EQ(0, count_disc(grid, Cell(50, 50), 2).occupied);
+    EXPECT_EQ(1, count_disc(grid, heights, Cell(50, 50), 2).occupied);
+}
+
+//------------------------------------------------------------------------------
+// Cloud
+
+/**
+  * A wall 0.4 m in front of the sensor, 10 cm high, seen from cell (10, 50).
+  */
+TEST(Cloud, TraceLeavesTheGridToApply)
+{
+    Grid grid(100, 100, RESOLUTION, -0.5, -0.5);
+    Transform sensor_to_grid;
+    sensor_to_grid.translation[0] = -0.4;
+
+    std::vector<float> points;
+    for(int i = -5; i <= 5; ++i) {
+        points.push_back(0.4f);
+        points.push_back(i*0.01f);
+        points.push_back(0.1f);
+    }
+
+    CloudInserter::Config config;
+    config.voxel_size = RESOLUTION;
+    config.threads = 2;
+    CloudInserter inserter;
+    inserter.set_config(config);
+
+    Grid before = grid;
+    CloudInserter::Stats stats = inserter.trace(grid, (const uint8_t*)&points[0], points.size()/3,
+                                                3*sizeof(float), sensor_to_grid);
+    EXPECT_EQ(11, stats.points);
+    EXPECT_GT(stats.occupied_cells, 0);
+    EXPECT_GT(stats.free_cells, 0);
+    EXPECT_TRUE(grid.log_odds() == before.log_odds());
+
+    inserter.apply(grid);
+    EXPECT_NEAR(Grid::P_OCC, grid.log_odds(50, 50), 1e-9);
+    EXPECT_NEAR(Grid::P_FREE, grid.log_odds(30, 50), 1e-9);
+    EXPECT_NEAR(Grid::P_PRIOR, grid.log_odds(30, 80), 1e-9);
+}